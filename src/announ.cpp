@@ -1,16 +1,27 @@
 #include <limits>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
 #include <sstream>
 
 #define LOG_MODULE_NAME		"[ ANN ]"
 #include "logger.hpp"
 
+#include "utils/fs.hpp"
 #include "app.hpp"
 #include "announ.hpp"
 
 namespace avi{
 
-void Navigator::init(const std::string &log_file_name)
+void Navigator::init(const std::string &log_file_name, int confidence_fixes)
 {
+	{
+		std::lock_guard<std::mutex> lock(filter_mutex_);
+		GPS_filter::params p;
+		p.confidence_fixes = (confidence_fixes > 0) ? confidence_fixes : 1;
+		filter_.set_params(p);
+	}
+
 	int route = NSIDatabase::get_current_route();
 
 	// перед расширением добавляем идентификатор маршрута
@@ -23,15 +34,153 @@ void Navigator::init(const std::string &log_file_name)
 		path = name + std::to_string(route) + "." + extension;
 	}
 
-	track_logger_.init(MSG_TO_FILE, path, 0, MB_to_B(50));
+	// Текстовый формат сохранен для совместимости, по умолчанию - двоичный журнал
+	if(utils::file_extension(path) == ".track"){
+		track_log_.close();
+		track_logger_.init(MSG_TO_FILE, path, 0, MB_to_B(50));
+		return;
+	}
+
+	try{
+		track_log_.open(path, MB_to_B(50));
+	}
+	catch(const std::exception &e){
+		log_err("Could not open GPS track log: %s\n", e.what());
+	}
+}
+
+Navigator::fix Navigator::make_fix(const platform::GPS_data &data)
+{
+	fix f;
+	f.coord = data.coord;
+	f.speed_kmh = data.speed_kmh;
+	f.course = data.course;
+	f.valid = data.valid;
+	strncpy(f.date_time, data.date_time.c_str(), sizeof(f.date_time) - 1);
+	return f;
+}
+
+platform::GPS_data Navigator::to_gps_data(const fix &f)
+{
+	platform::GPS_data res;
+	res.date_time = f.date_time;
+	res.coord = f.coord;
+	res.speed_kmh = f.speed_kmh;
+	res.course = f.course;
+	res.valid = f.valid;
+	return res;
 }
 
-void Navigator::log_position(const platform::GPS_data &data) const
-{	
+void Navigator::log_position(const fix &f)
+{
+	using namespace std::chrono;
+
+	const platform::GPS_data data = to_gps_data(f);
+
+	if(track_log_.is_open()){
+		track_log_.append(data, duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count());
+		return;
+	}
+
 	track_logger_.msg(MSG_TO_FILE, "%s\n", data.to_string());
 }
 
+void Navigator::flush_track()
+{
+	track_log_.flush();
+}
 
+void Navigator::set_dead_reckoning(double max_sec, double max_m)
+{
+	std::lock_guard<std::mutex> lock(filter_mutex_);
+	dr_max_sec_ = std::max(max_sec, 0.0);
+	dr_max_m_ = std::max(max_m, 0.0);
+	dr_has_base_ = false;
+}
+
+void Navigator::set_route_geometry(const std::vector<utils::Coord> &points, double max_offset_m)
+{
+	std::lock_guard<std::mutex> lock(filter_mutex_);
+
+	Map_matcher::params p;
+	p.max_offset_m = max_offset_m;
+	matcher_.set_params(p);
+	matcher_.set_polyline((max_offset_m > 0.0) ? points : std::vector<utils::Coord>());
+
+	if( !matcher_.empty() ){
+		log_msg(MSG_DEBUG, "Route line: %zu points, %.1lf km\n", points.size(), matcher_.length_cm() / 100000.0);
+	}
+}
+
+platform::GPS_data Navigator::set_gps_data(const platform::GPS_data &data, bool *estimated)
+{
+	using namespace std::chrono;
+	std::lock_guard<std::mutex> lock(filter_mutex_);
+
+	const double t = duration<double>(platform::monotonic_now().time_since_epoch()).count();
+	platform::GPS_data res = filter_.update(data, t);
+
+	fix f = make_fix(data);
+	f.confident = filter_.confident();
+
+	if(f.confident){
+		// Решение вблизи линии маршрута заменяется проекцией на нее
+		const Map_matcher::result m = matcher_.match(res.coord, (res.speed_kmh > 0.0) ? res.course : -1.0);
+		if(m.matched){
+			res.coord = m.coord;
+			f.route_pos_cm = static_cast<int32_t>(m.along_cm);
+		}
+
+		dr_has_base_ = (dr_max_sec_ > 0.0) && (dr_max_m_ > 0.0);
+		dr_base_ = res;
+		dr_base_route_pos_cm_ = f.route_pos_cm;
+		dr_base_t_ = t;
+	}
+	else if(dr_has_base_ && !data.valid){
+		// Положение продолжается от последнего устойчивого решения по прямой
+		// с его скоростью и курсом
+		const double dt = t - dr_base_t_;
+		const double dist_m = dr_base_.speed_kmh / 3.6 * dt;
+
+		if((dt <= dr_max_sec_) && (dist_m <= dr_max_m_)){
+			res = dr_base_;
+			res.date_time = data.date_time;
+
+			// Вдоль линии маршрута, если последнее решение было к ней привязано,
+			// иначе - по прямой с последним курсом
+			if(dr_base_route_pos_cm_ >= 0){
+				f.route_pos_cm = dr_base_route_pos_cm_ + static_cast<int32_t>(dist_m * 100.0);
+				matcher_.point_at(static_cast<uint32_t>(f.route_pos_cm), &res.coord, &res.course);
+			}
+			else{
+				const double PI = 3.14159265358979;
+				const double course = dr_base_.course * PI / 180.0;
+				const utils::LocalMetric metric(dr_base_.coord.lat);
+
+				res.coord = metric.shift(dr_base_.coord, static_cast<int64_t>(dist_m * 100.0 * std::sin(course)),
+					static_cast<int64_t>(dist_m * 100.0 * std::cos(course)));
+			}
+
+			f.coord = res.coord;
+			f.speed_kmh = res.speed_kmh;
+			f.course = res.course;
+			f.estimated = true;
+		}
+		else{
+			log_msg(MSG_DEBUG, "Dead reckoning stopped after %.1lf sec, %.0lf m\n", dt, dist_m);
+			dr_has_base_ = false;
+		}
+	}
+
+	last_.store(f);
+	history_.push(f);
+
+	if(estimated){
+		*estimated = f.estimated;
+	}
+
+	return res;
+}
 
 void MediaPlayer::enqueue_child_media(info parent_media)
 {
@@ -48,9 +197,12 @@ void MediaPlayer::enqueue_child_media(info parent_media)
 	}
 }
 
-void MediaPlayer::init(const std::string *media_dir)
+void MediaPlayer::init(const std::string *media_dir, const MediaChainCache *chains, const TTSCache *tts, Event_bus *bus)
 {
 	media_dir_ = media_dir;
+	chains_ = chains;
+	tts_ = tts;
+	bus_ = bus;
 	platform::audio_setup_stop_callback([this](){ this->after_play_finished(); });
 }
 
@@ -59,6 +211,7 @@ void MediaPlayer::deinit()
 	{
 		std::lock_guard<std::recursive_mutex> lock(mutex_);
 		this->clear_media_queue();
+		pending_.clear();
 		playing_media_ = nullptr;
 	}
 
@@ -86,65 +239,243 @@ const char* MediaPlayer::mode_as_str(uint8_t play_mode)
 
 void MediaPlayer::start_playing(info media, bool after_stop)
 {
-	// Добавляем медиа-данные потомка если есть
-	this->enqueue_child_media(media);
+	std::string filepath = *media_dir_ + "/" + media->filename;
+	uint32_t duration_ms = media->duration_ms;
+	info tail = nullptr;
+
+	// Фраза синтеза речи воспроизводится из кеша TTS. Если она еще не готова -
+	// пропускаем ее, не задерживая очередь
+	if( !media->text.empty() ){
+		if( !tts_ || !tts_->find(media->text, &filepath, &duration_ms) ){
+			log_warn("TTS phrase is not ready yet: '%s'. Skipping\n", media->text);
+			this->enqueue_child_media(media);
+			this->play_next();
+			return;
+		}
+	}
+
+	// Если цепочка родитель -> потомки уже склеена в один файл - воспроизводим его 
+	// без пауз между частями. В очередь ставится потомок последней части цепочки
+	if(chains_ && chains_->find(media, &filepath, &tail)){
+		log_msg(MSG_DEBUG, "Using joined media chain for '%s'\n", media->filename);
+		duration_ms = this->chain_duration_ms(media, tail);
+		this->enqueue_child_media(tail);
+	}
+	else{
+		// Добавляем медиа-данные потомка если есть
+		this->enqueue_child_media(media);
+	}
 
 	// Воспроизвести аудио-файл
-	auto play = [this, media, after_stop](){
+	// wait - ожидание паузы и окончания текущего воспроизведения в потоке запуска
+	auto play = [this, media, tail, filepath, duration_ms, after_stop](bool wait){
 
 		try{
-			std::string filepath = *media_dir_ + "/" + media->filename;
 
 			// Если задано делаем паузу
-			if(media->pause){
+			if(media->pause && wait){
 				log_msg(MSG_VERBOSE, "Waiting %d sec pause before playing\n", media->pause);
 				std::this_thread::sleep_for(std::chrono::seconds(media->pause));
 			}
 
 			// Ждем окончательной готовности к новому проигрыванию
-			while(platform::audio_is_playing()){
+			while(wait && platform::audio_is_playing()){
 				std::this_thread::sleep_for(std::chrono::milliseconds(10));
 			}
 
 			log_msg(MSG_DEBUG | MSG_TO_FILE, "Playing audio %s '%s' (mode: %s)\n", 
 				after_stop ? "from media_queue" : "", filepath, mode_as_str(media->play_mode));
-			platform::audio_play(filepath);
+			platform::audio_play(filepath, duration_ms);
 
 			// Обновить данные о текущем воспроизведении
 			std::lock_guard<std::recursive_mutex> lock(mutex_);
 			playing_media_ = media;
+			playing_started_ = platform::monotonic_now();
+			playing_duration_ms_ = duration_ms;
+
+			this->publish(Event_bus::PLAYBACK_START, media);
+			this->hand_off_children(tail ? tail : media);
 		}
 		catch(const std::exception &e){
 			log_excp("%s\n", e.what());
 		}
 	};
 
+	// При воспроизведении трека ожидание идет по виртуальным часам: запуск
+	// откладывается и выполняется в потоке, задающем время
+	if(platform::virtual_time()){
+		pending_.emplace_back(platform::monotonic_now() + std::chrono::seconds(media->pause), std::bind(play, false));
+		this->start_pending();
+		return;
+	}
+
 	// Колбек after_play_finished() должен отработать прежде чем произойдет очередной
 	// вызов platform::audio_play() т.к. SIMCOM API не позволяет вызывать audio_play() из 
 	// обработчика audio_stop(). Поэтому отсоединяем поток запуска аудио-файла.
-	std::thread tplay(play);
+	std::thread tplay(play, true);
 	tplay.detach();
 }
 
-void MediaPlayer::after_play_finished()
+void MediaPlayer::start_pending()
 {
-	try{
-		log_msg(MSG_DEBUG | MSG_TO_FILE, "Audio stopped\n");
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
 
-		std::lock_guard<std::recursive_mutex> lock(mutex_);
-		playing_media_ = nullptr;
+	// Запуск может поставить в ожидание следующий файл - ищем заново после каждого
+	for(;;){
+		if(pending_.empty() || platform::audio_is_playing()){
+			return;
+		}
+
+		const auto now = platform::monotonic_now();
+		auto it = pending_.begin();
+		while((it != pending_.end()) && (it->first > now)){
+			++it;
+		}
+
+		if(it == pending_.end()){
+			return;
+		}
+
+		const std::function<void()> launch = it->second;
+		pending_.erase(it);
+		launch();
+	}
+}
+
+void MediaPlayer::hand_off_children(info media)
+{
+	auto uninterrupted = [](info m){
+		return (static_cast<mode>(m->play_mode) == mode::UNINTERRUPTED) ||
+			(static_cast<mode>(m->play_mode) == mode::UNINTERRUPTED_PARENT);
+	};
+
+	if( !playing_media_ ){
+		return;
+	}
+
+	// Потомки, которые запускались бы сразу по окончании текущей части, передаются
+	// в очередь аудио-бэкенда заранее: без колбека остановки и нового потока между
+	// частями. Как и у склеенных цепочек, режим воспроизведения определяет родитель
+	for(size_t i = 0; i < MediaChainCache::max_chain_len; ++i){
+
+		// В очереди только потомок текущей части
+		if((media_queue_.size() != 1) || (media->id_next < 0) ||
+			(media_queue_.front() != NSIDatabase::get_media_info_of_child(media->id_next))){
+			return;
+		}
+
+		info child = media_queue_.front();
+		std::string filepath = *media_dir_ + "/" + child->filename;
+		uint32_t duration_ms = child->duration_ms;
+
+		if(child->pause || (static_cast<mode>(child->play_mode) == mode::QUEUED) ||
+			(uninterrupted(child) != uninterrupted(playing_media_))){
+			return;
+		}
 
-		if(media_queue_.empty()){
-			// Больше нет активных воспроизведений
-			log_msg(MSG_DEBUG, "Media queue is empty\n");
+		if( !child->text.empty() && (!tts_ || !tts_->find(child->text, &filepath, &duration_ms)) ){
 			return;
 		}
 
-		// Достаем медиа-данные из начала очереди (порядок FIFO)
-		info media = media_queue_.front();
+		if( !platform::audio_enqueue(filepath) ){
+			return;
+		}
+
+		log_msg(MSG_DEBUG | MSG_TO_FILE, "Enqueued audio '%s' (gapless after current)\n", filepath);
+
 		media_queue_.pop();
+		playing_duration_ms_ += duration_ms;
+
+		this->enqueue_child_media(child);
+		media = child;
+	}
+}
+
+uint32_t MediaPlayer::chain_duration_ms(info media, info tail) const
+{
+	uint32_t res = media->duration_ms;
+
+	for(size_t i = 0; (media != tail) && (i < MediaChainCache::max_chain_len); ++i){
+		media = NSIDatabase::get_media_info_of_child(media->id_next);
+		if( !media ){
+			break;
+		}
+		res += media->duration_ms;
+	}
+
+	return res;
+}
+
+uint32_t MediaPlayer::drain_time_estimate_ms() const
+{
+	using namespace std::chrono;
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	uint32_t res = 0;
+
+	if(playing_media_){
+		const auto end = playing_started_ + milliseconds(playing_duration_ms_);
+		const auto now = platform::monotonic_now();
+
+		if(end > now){
+			res += duration_cast<milliseconds>(end - now).count();
+		}
+	}
 
-		this->start_playing(media, true);
+	// Очередь небольшая - обходим копию
+	std::queue<info> queue = media_queue_;
+
+	while( !queue.empty() ){
+		res += queue.front()->pause * 1000 + queue.front()->duration_ms;
+		queue.pop();
+	}
+
+	return res;
+}
+
+void MediaPlayer::play_next()
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+	playing_media_ = nullptr;
+
+	if(media_queue_.empty()){
+		// Больше нет активных воспроизведений
+		log_msg(MSG_DEBUG, "Media queue is empty\n");
+		return;
+	}
+
+	// Достаем медиа-данные из начала очереди (порядок FIFO)
+	info media = media_queue_.front();
+	media_queue_.pop();
+
+	this->start_playing(media, true);
+}
+
+void MediaPlayer::publish(Event_bus::type t, info media)
+{
+	if( !bus_ ){
+		return;
+	}
+
+	Event_bus::event ev;
+	ev.t = t;
+	ev.minfo = media;
+	bus_->publish(ev);
+}
+
+void MediaPlayer::after_play_finished()
+{
+	try{
+		log_msg(MSG_DEBUG | MSG_TO_FILE, "Audio stopped\n");
+
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex_);
+			if(playing_media_){
+				this->publish(Event_bus::PLAYBACK_END, playing_media_);
+			}
+		}
+
+		this->play_next();
 	}
 	catch(const std::exception &e){
 		log_excp("%s\n", e.what());
@@ -173,7 +504,8 @@ void MediaPlayer::play(info media)
 				case mode::QUEUED:
 					// Добавляем в очередь на воспроизведение
 					media_queue_.push(media);
-					log_msg(MSG_DEBUG | MSG_TO_FILE, "Queued media is playing. Enqueuing '%s'\n", media->filename);
+					log_msg(MSG_DEBUG | MSG_TO_FILE, "Queued media is playing. Enqueuing '%s' (starts in ~%u ms)\n", 
+						media->filename, this->drain_time_estimate_ms() - media->duration_ms);
 					return;
 
 				case mode::INTERRUPTED:
@@ -216,31 +548,235 @@ void Announcement_task::init(const std::string *media_dir)
 		throw std::runtime_error(excp_method("platform not ready"));
 	}
 
-	navi_.init(app_->dirs.gps_track_path);
-	mplayer_.init(&(app_->dirs.media_dir));
+	{
+		// Журнал трека пишется в основной функции задачи
+		std::lock_guard<std::mutex> track_lock(track_mutex_);
+		std::lock_guard<std::mutex> lock(process_mutex_);
+		navi_.init(app_->dirs.gps_track_path, app_->settings.gps_valid_threshold);
+		navi_.set_dead_reckoning(app_->settings.gps_dr_max_sec, app_->settings.gps_dr_max_m);
+		navi_.set_route_geometry(NSIDatabase::get_route_geometry(app_->settings.gps_map_match_frames),
+			app_->settings.gps_map_match_max_m);
+	}
+
+	mplayer_.init(&(app_->dirs.media_dir), &(app_->media_chains), &(app_->tts_cache), &bus_);
+
+	// Потребители шины событий: журнал трека - основная функция задачи,
+	// проигрыватель и дисплей (он же ведет состояние воспроизведения для
+	// статуса устройства) - свои потоки
+	if(track_sub_id_ < 0){
+		track_sub_id_ = bus_.subscribe(Event_bus::FIX, 256);
+	}
+
+	player_task_.init(&bus_, Event_bus::ZONE_ENTER, 64, [this](const std::vector<Event_bus::event> &events){
+		for(const auto &ev : events){
+			if(ev.minfo){
+				mplayer_.play(ev.minfo);
+			}
+		}
+	});
+
+	const uint32_t lcd_events = Event_bus::ZONE_ENTER | Event_bus::ZONE_EXIT | Event_bus::PLAYBACK_START | Event_bus::PLAYBACK_END;
+
+	lcd_task_.init(&bus_, lcd_events, 64, [this](const std::vector<Event_bus::event> &events){
+		// Дисплей перерисовывается один раз - по итоговому состоянию за период
+		int frame_id = lcd_frame_id_;
+		bool playing = lcd_playing_;
+		const NSIDatabase::kFrames_table::MediaInfo *minfo = nullptr;
+
+		for(const auto &ev : events){
+			switch(ev.t){
+				case Event_bus::ZONE_ENTER:
+					frame_id = ev.frame_id;
+					break;
+
+				case Event_bus::ZONE_EXIT:
+					if( !ev.inside ){
+						frame_id = -1;
+					}
+					break;
+
+				case Event_bus::PLAYBACK_START:
+					playing = true;
+					minfo = ev.minfo;
+					break;
+
+				case Event_bus::PLAYBACK_END:
+					playing = false;
+					minfo = nullptr;
+					break;
+
+				default:
+					break;
+			}
+		}
+
+		if( !playing ){
+			std::lock_guard<std::mutex> lock(playing_mutex_);
+			playing_media_.clear();
+		}
+		else if(minfo){
+			std::lock_guard<std::mutex> lock(playing_mutex_);
+			playing_media_ = minfo->text.empty() ? minfo->filename : minfo->text;
+		}
+
+		if((frame_id != lcd_frame_id_) || (playing != lcd_playing_)){
+			lcd_frame_id_ = frame_id;
+			lcd_playing_ = playing;
+			this->update_interface(frame_id, playing);
+		}
+	});
+
+	bus_.clear();
+	lcd_frame_id_ = std::numeric_limits<int>::min();
+	lcd_playing_ = false;
+	{
+		std::lock_guard<std::mutex> lock(playing_mutex_);
+		playing_media_.clear();
+	}
+
+	player_task_.set_period(std::chrono::milliseconds(50), std::chrono::milliseconds(50));
+	lcd_task_.set_period(std::chrono::milliseconds(250));
+	player_task_.start();
+	lcd_task_.start();
+
+	{
+		std::lock_guard<std::mutex> lock(process_mutex_);
+		last_data_time_ = platform::monotonic_now();
+		last_rx_time_ = last_data_time_;
+		rx_valid_ = false;
+		stats_time_ = last_data_time_;
+		gps_period_ms_ = 0;
+		has_prev_coord_ = false;
+		prev_route_pos_cm_ = -1;
+		frame_tracker_.reset();
+	}
+
+	platform::set_GPS_period(0);
+	processing_ = true;
+
+	if(gps_sub_id_ < 0){
+		gps_sub_id_ = platform::subscribe_GPS([this](const platform::GPS_data &data){ 
+			if(processing_){
+				this->process_gps_data(data);
+			}
+		});
+	}
 }
 
-bool Announcement_task::gps_data_ready_for_processing(const platform::GPS_data &data) noexcept
+void Announcement_task::unsubscribe()
 {
-	if( !data.valid || (data.speed_kmh < app_->settings.gps_min_valid_speed) ){
-		gps_validity_counter_ = 0;
-		return false;
+	processing_ = false;
+
+	if(gps_sub_id_ > -1){
+		platform::unsubscribe_GPS(gps_sub_id_);
+		gps_sub_id_ = -1;
 	}
 
-	++gps_validity_counter_;
+	// Другим подписчикам - собственная частота источника
+	platform::set_GPS_period(0);
+
+	this->write_track();
+
+	std::lock_guard<std::mutex> lock(track_mutex_);
+	navi_.flush_track();
+}
+
+void Announcement_task::write_track()
+{
+	std::lock_guard<std::mutex> lock(track_mutex_);
 
-	if(gps_validity_counter_ >= app_->settings.gps_valid_threshold){
-		gps_validity_counter_ = 0;
-		return true;
+	Event_bus::event ev;
+	while(bus_.poll(track_sub_id_, &ev)){
+		navi_.log_position(ev.gps);
 	}
+}
 
-	return false;
+bool Announcement_task::gps_data_ready_for_processing(const platform::GPS_data &data, bool estimated) noexcept
+{
+	// Решение проверяется после сглаживания: одиночное медленное или невалидное
+	// решение снижает уверенность фильтра, но не обнуляет ее, как это делал
+	// счетчик подряд идущих валидных решений. Счисленное положение продолжает
+	// последнее устойчивое решение
+	return (estimated || (data.valid && navi_.position_is_confident())) && (data.speed_kmh >= app_->settings.gps_min_valid_speed);
 }
 
-void Announcement_task::update_interface(int frame_id) const
+void Announcement_task::adapt_gps_period(const platform::GPS_data &data)
+{
+	// Ускорение, с которым транспорт может приблизиться к зоне между решениями (м/с^2),
+	// и запас на погрешность координат и размеры зоны (м)
+	const double max_accel = 2.0;
+	const double margin_m = 30.0;
+
+	const int base = app_->settings.gps_poll_period_ms;
+	// Фильтр координат перезапускается после перерыва в данных 3 сек
+	const int max = std::min(app_->settings.gps_max_poll_period_ms, 2000);
+
+	int period = 0;
+
+	if((max > base) && data.valid && navi_.position_is_confident()){
+		const double v = data.speed_kmh / 3.6;
+		auto reach_m = [v, max_accel, margin_m](int period_ms){
+			const double t = period_ms / 1000.0;
+			return v * t + max_accel * t * t / 2.0 + margin_m;
+		};
+
+		const uint32_t dist_cm = NSIDatabase::nearest_zone_distance_cm(data.coord, static_cast<uint32_t>(reach_m(max) * 100.0));
+
+		// Наибольший период (max, max/2, max/4 ...), за который транспорт не
+		// успеет доехать до ближайшей зоны. Вблизи зон - собственная частота
+		for(int candidate = max; candidate > base; candidate /= 2){
+			if(reach_m(candidate) * 100.0 < dist_cm){
+				period = candidate;
+				break;
+			}
+		}
+
+		// Период увеличивается постепенно, уменьшается сразу
+		const int current = (gps_period_ms_ > 0) ? gps_period_ms_ : base;
+		if(period > current * 2){
+			period = current * 2;
+		}
+	}
+
+	if(period != gps_period_ms_){
+		log_msg(MSG_TRACE, "GPS period: %d -> %d ms\n", gps_period_ms_, period);
+		gps_period_ms_ = period;
+		platform::set_GPS_period(period);
+	}
+}
+
+void Announcement_task::log_gps_stats()
+{
+	using namespace std::chrono;
+	const auto now = platform::monotonic_now();
+
+	if(now - stats_time_ < seconds(60)){
+		return;
+	}
+
+	const platform::GPS_stats stats = platform::get_GPS_stats();
+	log_msg(MSG_DEBUG, "GPS stats: source reads %llu, published %llu, skipped %llu, processed %llu, period %d ms\n",
+		static_cast<unsigned long long>(stats.reads), static_cast<unsigned long long>(stats.published),
+		static_cast<unsigned long long>(stats.skipped), static_cast<unsigned long long>(processed_), gps_period_ms_);
+
+	const uint64_t dropped = bus_.dropped(track_sub_id_) + bus_.dropped(player_task_.get_subscriber_id()) +
+		bus_.dropped(lcd_task_.get_subscriber_id());
+	if(dropped){
+		log_warn("Event bus: %llu events dropped (slow consumers)\n", static_cast<unsigned long long>(dropped));
+	}
+
+	stats_time_ = now;
+}
+
+void Announcement_task::update_interface(int frame_id, bool playing) const
 {
 	std::string value = (frame_id > -1) ? std::to_string(frame_id) : "XXXX";
 
+	// Идет воспроизведение
+	if(playing){
+		value += " >";
+	}
+
 	// LCD_Interface::main_menu.update_content(1, "ФРЕЙМ: " + value);
 	LCD_Interface::main_menu.update_ticker_content(1, value);
 
@@ -250,52 +786,159 @@ void Announcement_task::update_interface(int frame_id) const
 	}
 }
 
-Background_task::signal Announcement_task::main_func(void)
+void Announcement_task::process_gps_data(const platform::GPS_data &gps_data, bool receiver)
 {
-	// Признак валидности предыдущих GPS координат
-	static bool was_valid = false;
-
-	// Проверка состояния задачи
-	if(this->get_current_state() == Background_task::signal::STOP){
-		return Background_task::signal::STOP;
-	}
-
 	// Задача получает текущие координаты местоположения,
 	// обновляет внутреннюю структуру и следит за порядком
 	// воспроизведения медиа-файлов				
 
+	std::lock_guard<std::mutex> lock(process_mutex_);
+
 	try{
+		last_data_time_ = platform::monotonic_now();
+		if(receiver){
+			last_rx_time_ = last_data_time_;
+			rx_valid_ = gps_data.valid;
+		}
 
-		platform::GPS_data gps_data = navi_.update_gps_data();
+		++processed_;
+		bool estimated = false;
+		const platform::GPS_data smoothed = navi_.set_gps_data(gps_data, &estimated);
+		this->adapt_gps_period(smoothed);
 
-		if( !gps_data.valid && was_valid ){
+		// Решения для журнала трека (записываются в основной функции задачи)
+		Event_bus::event fix;
+		fix.t = Event_bus::FIX;
+		fix.gps = Navigator::make_fix(gps_data);
+
+		if( !gps_data.valid && was_valid_ ){
 			// Логируем пропадание валидных координат один раз
-			navi_.log_position(gps_data);
-			was_valid = false;
+			bus_.publish(fix);
+			was_valid_ = false;
 		}
 
 		// Проверка готовности данных к обработке 
-		if( !gps_data_ready_for_processing(gps_data) ){
-			return Background_task::signal::SLEEP;
+		if( !gps_data_ready_for_processing(smoothed, estimated) ){
+			// Путь между решениями через пропуск не восстанавливается
+			has_prev_coord_ = false;
+			prev_route_pos_cm_ = -1;
+			return;
+		}
+
+		was_valid_ = !estimated;
+
+		// Решение привязано к линии маршрута - фреймы с отметкой вдоль маршрута
+		// проверяются по пройденному расстоянию, а не по зонам
+		const int32_t route_pos_cm = navi_.route_position_cm();
+
+		// Вход в зону: воспроизведение и дисплей - через шину событий, в своих потоках
+		auto on_enter = [this](int frame_id, const NSIDatabase::kFrames_table::MediaInfo *minfo){
+			Event_bus::event ev;
+			ev.t = Event_bus::ZONE_ENTER;
+			ev.frame_id = frame_id;
+			ev.minfo = minfo;
+			bus_.publish(ev);
+
+			if(frame_cb_){
+				frame_cb_(frame_id, minfo);
+			}
+		};
+
+		const auto &events = frame_tracker_.update(smoothed.coord, smoothed.course,
+			has_prev_coord_ ? &prev_coord_ : nullptr, route_pos_cm >= 0);
+
+		// Перекрывающиеся зоны срабатывают каждая, по порядку фреймов
+		bool entered = false;
+		for(const auto &ev : events){
+			if(ev.enter){
+				entered = true;
+				on_enter(ev.frame_id, ev.minfo);
+			}
+			else{
+				Event_bus::event exit;
+				exit.t = Event_bus::ZONE_EXIT;
+				exit.frame_id = ev.frame_id;
+				exit.inside = frame_tracker_.inside();
+				bus_.publish(exit);
+			}
 		}
 
-		was_valid = true;
-		int frame_id = std::numeric_limits<int>::min();
-		const NSIDatabase::kFrames_table::MediaInfo *minfo = NSIDatabase::find_media_info(gps_data.lat_lon, gps_data.course, &frame_id);
+		// Отметки вдоль маршрута проверяются на каждом решении: отметка, пройденная
+		// на одном решении со входом в зону, иначе была бы потеряна
+		// (все пройденные за шаг - по порядку, как и зоны)
+		if((prev_route_pos_cm_ >= 0) && (route_pos_cm >= 0)){
+			NSIDatabase::find_route_triggers(prev_route_pos_cm_, route_pos_cm, &route_events_);
 
-		if(frame_id != std::numeric_limits<int>::min()){
-			this->update_interface(frame_id);
+			for(const auto &ev : route_events_){
+				entered = true;
+				on_enter(ev.frame_id, ev.minfo);
+			}
 		}
 
-		if(minfo){
-			mplayer_.play(minfo);
+		// Выход из всех зон
+		if( !entered && !events.empty() && !frame_tracker_.inside() && frame_cb_ ){
+			frame_cb_(-1, nullptr);
 		}
 
-		navi_.log_position(gps_data);
+		prev_coord_ = smoothed.coord;
+		has_prev_coord_ = true;
+		prev_route_pos_cm_ = route_pos_cm;
+
+		// В журнал трека пишутся только решения приемника
+		if( !estimated ){
+			bus_.publish(fix);
+		}
 	}
 	catch(const std::exception &e){
 		log_err("%s\n", e.what());
 	}
+}
+
+Background_task::signal Announcement_task::main_func(void)
+{
+	using namespace std::chrono;
+
+	// Данные от источника не поступают дольше этого времени - считаем координаты невалидными
+	const milliseconds no_data_timeout(3000);
+
+	// Проверка состояния задачи
+	if(this->get_current_state() == Background_task::signal::STOP){
+		return Background_task::signal::STOP;
+	}
+
+	bool timeout = false;
+	bool reckoning = false;
+	{
+		std::lock_guard<std::mutex> lock(process_mutex_);
+		const auto now = platform::monotonic_now();
+		const auto no_data = now - last_data_time_;
+
+		// Пропадание отмечается один раз - до следующего валидного решения приемника
+		timeout = rx_valid_ && (now - last_rx_time_ > no_data_timeout);
+		if(timeout){
+			rx_valid_ = false;
+		}
+
+		// При счислении пути положение обновляется и без данных от источника -
+		// после пропуска двух ожидаемых решений
+		const milliseconds reckoning_period(std::max(500, 2 * std::max(gps_period_ms_, app_->settings.gps_poll_period_ms)));
+		reckoning = !timeout && (app_->settings.gps_dr_max_sec > 0.0) && (was_valid_ || navi_.is_dead_reckoning()) &&
+			(no_data > reckoning_period);
+
+		this->log_gps_stats();
+	}
+
+	// Журнал трека пишется здесь, а не в потоке источника GPS данных
+	// (запись блока на носитель с fsync)
+	this->write_track();
+
+	if(timeout && processing_){
+		log_warn("No GPS data for %lld ms\n", static_cast<long long>(no_data_timeout.count()));
+		this->process_gps_data(platform::GPS_data(), false);
+	}
+	else if(reckoning && processing_){
+		this->process_gps_data(platform::GPS_data(), false);
+	}
 
 	return Background_task::signal::SLEEP;
 }
@@ -17,10 +17,21 @@
 #include <mutex>
 #include <utility>
 #include <queue>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <functional>
 
 #include "bg_task.hpp"
 #include "platform.hpp"
+#include "gps_filter.hpp"
+#include "map_match.hpp"
+#include "event_bus.hpp"
+#include "utils/seqlock.hpp"
+#include "track_log.hpp"
 #include "app_db.hpp"
+#include "media_cache.hpp"
+#include "tts_cache.hpp"
 #include "logger.hpp"
 
 namespace avi{
@@ -34,43 +45,86 @@ class Navigator
 public:
 
 	struct position{
-		position(bool vld = false, double lat = 0.0, double lon = 0.0): 
-			valid(vld), latitude(lat), longitude(lon) {}
+		position(bool vld = false, const utils::Coord &crd = utils::Coord()): 
+			valid(vld), coord(crd) {}
 
 		bool valid = false;
-		double latitude = 0.0;
-		double longitude = 0.0;
+		utils::Coord coord;
 	};
 
-	void init(const std::string &log_file_name = "");
+	// Решение приемника в виде, допускающем побайтовое копирование (для публикации без блокировок)
+	using fix = Nav_fix;
 
+	// Решение приемника без результатов фильтра и привязки к линии маршрута
+	static fix make_fix(const platform::GPS_data &data);
+	static platform::GPS_data to_gps_data(const fix &f);
+
+	// Количество последних решений, доступных в истории
+	static const size_t history_size = 64;
+
+	// confidence_fixes - количество согласованных решений до полной уверенности фильтра
+	void init(const std::string &log_file_name = "", int confidence_fixes = 4);
+
+	// Счисление пути при пропадании решений: положение продолжается от последнего
+	// устойчивого решения с его скоростью и курсом не дольше max_sec и не дальше max_m.
+	// 0 - счисление отключено
+	void set_dead_reckoning(double max_sec, double max_m);
+
+	// Чтение из любого потока - без блокировок и выделения памяти
 	position get_position() const {
-		std::lock_guard<std::mutex> lock(mutex_);
-		return position(data_.valid, data_.lat_lon.first, data_.lat_lon.second);
+		const fix last = last_.load();
+		return position(last.valid, last.coord);
 	}
 
-	platform::GPS_data get_gps_data() const {
-		std::lock_guard<std::mutex> lock(mutex_);
-		return data_;
-	}
+	fix get_fix() const { return last_.load(); }
 
-	platform::GPS_data update_gps_data(){
-		std::lock_guard<std::mutex> lock(mutex_);
-		data_ = platform::get_GPS_data();
-		return data_;
-	}
+	platform::GPS_data get_gps_data() const { return to_gps_data(last_.load()); }
 
-	bool position_is_valid() const {
-		std::lock_guard<std::mutex> lock(mutex_);
-		return data_.valid;
-	}
+	// Последние решения (out[0] - самое новое), возвращает их количество
+	size_t get_history(fix *out, size_t max) const { return history_.last(out, max); }
+
+	// Обновить координаты. Возвращает сглаженное фильтром решение, а при отсутствии
+	// решения приемника - счисленное положение (estimated = true, пониженная достоверность).
+	// Вызывается только из потока источника GPS данных (один писатель)
+	platform::GPS_data set_gps_data(const platform::GPS_data &data, bool *estimated = nullptr);
+
+	// Положение счисляется (приемник без решения, пределы счисления не исчерпаны)
+	bool is_dead_reckoning() const { return last_.load().estimated; }
+
+	// Привязка решений к линии маршрута: сглаженное решение заменяется проекцией
+	// на линию, если удалено от нее не более max_offset_m. 0 - привязка отключена
+	void set_route_geometry(const std::vector<utils::Coord> &points, double max_offset_m);
+
+	// Расстояние вдоль линии маршрута (см), -1 - решение не привязано к линии
+	int32_t route_position_cm() const { return last_.load().route_pos_cm; }
+
+	// Сглаженное решение достаточно устойчиво для сопоставления с зонами
+	bool position_is_confident() const { return last_.load().confident; }
+
+	bool position_is_valid() const { return last_.load().valid; }
 
-	void log_position(const platform::GPS_data &data) const;
+	void log_position(const fix &f);
+
+	// Записать накопленные решения журнала трека на носитель
+	void flush_track();
 
 private:
-	mutable std::mutex mutex_;
-	platform::GPS_data data_; 
-	Logging track_logger_{MSG_TO_FILE, ""};		// Лог текущих координат
+	std::mutex filter_mutex_;					// Настройка фильтра (init) и обновление данных
+	GPS_filter filter_;							// Сглаживание и оценка достоверности координат
+	utils::Seqlock<fix> last_;					// Последнее решение
+	utils::SeqRing<fix, history_size> history_;	// История последних решений
+
+	// Счисление пути (под filter_mutex_)
+	double dr_max_sec_ = 0.0;
+	double dr_max_m_ = 0.0;
+	bool dr_has_base_ = false;					// Есть устойчивое решение - начало счисления
+	platform::GPS_data dr_base_;
+	int32_t dr_base_route_pos_cm_ = -1;
+	double dr_base_t_ = 0.0;
+
+	Map_matcher matcher_;						// Привязка к линии маршрута (под filter_mutex_)
+	Logging track_logger_{MSG_TO_FILE, ""};		// Лог текущих координат (текстовый формат .track)
+	Track_log track_log_;						// Журнал трека (двоичный формат)
 };
 
 // Проигрыватель медиа-контента
@@ -80,7 +134,9 @@ class MediaPlayer
 
 public:
 
-	void init(const std::string *media_dir);
+	// bus - шина для событий начала и окончания воспроизведения (может быть nullptr)
+	void init(const std::string *media_dir, const MediaChainCache *chains = nullptr, const TTSCache *tts = nullptr,
+		Event_bus *bus = nullptr);
 	void deinit();
 
 	// Режимы проигрывания
@@ -118,22 +174,41 @@ public:
 
 	void after_play_finished();
 
+	// Оценка времени до окончания воспроизведения текущего файла и всей очереди (мс)
+	uint32_t drain_time_estimate_ms() const;
+
+	// Запуск медиа, ожидающих паузы или окончания текущего воспроизведения, в
+	// виртуальном времени (воспроизведение трека). Вызывается по виртуальным часам
+	void start_pending();
+
 private:
 	mutable std::recursive_mutex mutex_;
 	const std::string *media_dir_ = nullptr;
+	const MediaChainCache *chains_ = nullptr;	// Кеш склеенных цепочек родитель -> потомки
+	const TTSCache *tts_ = nullptr;				// Кеш синтезированных фраз
+	Event_bus *bus_ = nullptr;
 
 	// Данные о текущем воспроизведении
 	info playing_media_ = nullptr;
+	std::chrono::steady_clock::time_point playing_started_;
+	uint32_t playing_duration_ms_ = 0;
 
 	// Медиа-данные обновляются только при старте приложения. Во время выполнения задачи
 	// считаем, что таблица медиа-данных уже загружена в память и не изменяется - храним 
 	// указатели на активные меда-фрагменты
 	std::queue<info> media_queue_;
 
+	// Запуски в виртуальном времени: время окончания паузы и запуск файла
+	std::vector<std::pair<std::chrono::steady_clock::time_point, std::function<void()>>> pending_;
+
 	// Проверить потомка: если есть и задан режим - добавить в очередь
 	void enqueue_child_media(info parent_media);
 	void clear_media_queue();
+	void play_next();
 	void start_playing(info media, bool after_stop = false);
+	void hand_off_children(info media);
+	void publish(Event_bus::type t, info media);
+	uint32_t chain_duration_ms(info media, info tail) const;
 };
 
 
@@ -146,30 +221,102 @@ public:
 
 	void init(const std::string *media_dir);
 
+	void stop() override {
+		processing_ = false;
+		player_task_.stop();
+		lcd_task_.stop();
+		Background_task::stop();
+	}
+
 	void wait() override { 
+		this->unsubscribe();
+		player_task_.wait();
+		lcd_task_.wait();
 		mplayer_.deinit();
 		Background_task::wait();
 	}
 
 	void cancel() override{
+		this->unsubscribe();
+		player_task_.cancel();
+		lcd_task_.cancel();
 		mplayer_.deinit();
 		Background_task::cancel();
 	}
 
 	Navigator::position get_position() const { return navi_.get_position(); }
 
+	// Воспроизводимый файл или фраза ("" - воспроизведения нет)
+	std::string get_playing_media() const {
+		std::lock_guard<std::mutex> lock(playing_mutex_);
+		return playing_media_;
+	}
+
+	// Обработчик смены текущего фрейма (frame_id = -1 - выход из всех зон,
+	// minfo = nullptr - зона без воспроизведения). Вызывается из потока источника GPS данных
+	using frame_callback = std::function<void(int frame_id, const NSIDatabase::kFrames_table::MediaInfo *minfo)>;
+	void set_frame_callback(frame_callback cb){
+		std::lock_guard<std::mutex> lock(process_mutex_);
+		frame_cb_ = cb;
+	}
+
 private:
+	// Воспроизведение трека вызывает основную функцию задачи в виртуальном времени
+	friend class Replay_engine;
+
 	const AVI *const app_ = nullptr;
 	Navigator navi_;
 	MediaPlayer mplayer_;
 
-	int gps_validity_counter_ = 0;
+	// Координаты поступают из потока источника GPS данных (platform::subscribe_GPS),
+	// основная функция задачи следит только за их отсутствием
+	std::mutex process_mutex_;
+	std::atomic<bool> processing_{false};
+	int gps_sub_id_ = -1;
+	bool was_valid_ = false;	// Признак валидности предыдущих GPS координат
+	std::chrono::steady_clock::time_point last_data_time_;	// Последнее обработанное решение (в т.ч. счисленное)
+
+	// Пропадание данных приемника отслеживается отдельно: такты счисления
+	// пути не должны скрывать его
+	std::chrono::steady_clock::time_point last_rx_time_;
+	bool rx_valid_ = false;		// Последнее решение приемника валидно, пропадание еще не отмечено
+
+	// Предыдущее обработанное решение - для проверки зон, пройденных между решениями
+	bool has_prev_coord_ = false;
+	utils::Coord prev_coord_;
+	int32_t prev_route_pos_cm_ = -1;	// Положение вдоль маршрута (-1 - решение не привязано к линии)
+	NSIDatabase::FrameTracker frame_tracker_;	// Фреймы, в зонах которых находится решение
+	std::vector<NSIDatabase::FrameTracker::event> route_events_;	// Пройденные отметки вдоль маршрута (буфер)
+
+	// Шина событий: поток источника GPS данных только публикует события,
+	// проигрыватель, дисплей и журнал трека разбирают их со своей периодичностью
+	Event_bus bus_;
+	Event_consumer_task player_task_{"Player_events"};
+	Event_consumer_task lcd_task_{"LCD_events"};
+	int lcd_frame_id_ = 0;		// Отображаемый фрейм (только в потоке lcd_task_)
+	bool lcd_playing_ = false;	// Отображаемый признак воспроизведения (только в потоке lcd_task_)
+	mutable std::mutex playing_mutex_;
+	std::string playing_media_;	// Обновляется в потоке lcd_task_ по событиям воспроизведения
+	int track_sub_id_ = -1;
+	std::mutex track_mutex_;	// Журнал трека
+
+	// Адаптивная частота GPS данных: вдали от зон период увеличивается
+	int gps_period_ms_ = 0;		// Запрошенный у источника период (0 - собственная частота)
+	uint64_t processed_ = 0;	// Обработанных решений
+	frame_callback frame_cb_;
+	std::chrono::steady_clock::time_point stats_time_;
 
 	Background_task::signal main_func(void) override;
-	bool gps_data_ready_for_processing(const platform::GPS_data &data) noexcept;
+	// receiver - данные от источника (false - такт счисления пути из основной функции)
+	void process_gps_data(const platform::GPS_data &data, bool receiver = true);
+	bool gps_data_ready_for_processing(const platform::GPS_data &data, bool estimated) noexcept;
+	void adapt_gps_period(const platform::GPS_data &data);
+	void log_gps_stats();
+	void unsubscribe();
+	void write_track();		// Запись решений из шины событий в журнал трека
 
 	// Обновить отображение текущего фрейма
-	void update_interface(int frame_id) const;
+	void update_interface(int frame_id, bool playing) const;
 };
 
 } // namespace avi
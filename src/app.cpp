@@ -6,6 +6,7 @@
 #include <cinttypes>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 #define LOG_MODULE_NAME		"[ APP ]"
 #include "logger.hpp"
@@ -15,6 +16,7 @@
 #include "utils/fs.hpp"
 #include "utils/datetime.hpp"
 #include "utils/crypto.hpp"
+#include "utils/mp3.hpp"
 #include "lc_trans.hpp"
 #include "lc_sys_ev.hpp"
 #include "lc_client.hpp"
@@ -38,6 +40,8 @@ void AVI::Directories::create() const
 	utils::make_new_dir(updates_dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 	utils::make_new_dir(tmp_dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 	utils::make_new_dir(media_dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+	utils::make_new_dir(media_cache_dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+	utils::make_new_dir(tts_cache_dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 
 	utils::make_new_dir(log_backup_dir, S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 	utils::make_new_dir(utils::get_dir_name(main_db_path), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
@@ -49,8 +53,10 @@ void AVI::Directories::reset_data_subdirs()
 	updates_dir = data_dir + "/updates";
 	nsi_db_path = data_dir + "/nsi.db";
 	media_dir = data_dir + "/media";
+	media_cache_dir = data_dir + "/media_cache";
+	tts_cache_dir = data_dir + "/tts_cache";
 	tmp_dir = data_dir + "/tmp";
-	gps_track_path = data_dir + "/gps.track";
+	gps_track_path = data_dir + "/gps.trk";
 }
 
 void AVI::DeviceId::generate_from(const std::string &in)
@@ -82,8 +88,8 @@ void AVI::create_sys_event(const std::string &ev_name, const std::string &ev_dat
 		const Navigator::position pos = announ_task.get_position();
 					
 		sev.gps_valid = static_cast<uint32_t>(pos.valid);
-		sev.gps_latitude = std::to_string(pos.latitude);
-		sev.gps_longitude = std::to_string(pos.longitude);
+		sev.gps_latitude = utils::microdegrees_to_string(pos.coord.lat);
+		sev.gps_longitude = utils::microdegrees_to_string(pos.coord.lon);
 
 		// Нумерация системных событий сквозная. Для синхронизации доступа из разных частей
 		// приложения - инкремент, получение и сохранение счетчика в БД - одна целостная операция
@@ -170,7 +176,16 @@ void AVI::preinit(bool conf_trace, bool first_time_called)
 
 		if(first_time_called) log_msg(MSG_DEBUG | MSG_TO_FILE, _BOLD "~ %s log started (version: '%s', build-time: %s %s) ~\n" _RESET, APP_NAME, APP_VERSION, __DATE__, __TIME__);
 
-		platform::init(this->settings.gps_poll_period_ms, dirs.gps_gen_path);
+		platform::set_GPS_generator_rate(this->settings.gps_gen_rate_hz, this->settings.gps_gen_time_scale);
+
+		try{
+			platform::set_GPS_faults(this->settings.gps_fault_profile);
+		}
+		catch(const std::exception &e){
+			log_err("%s\n", e.what());
+		}
+
+		platform::init(this->settings.gps_poll_period_ms, dirs.gps_gen_path, this->settings.gps_nmea_port);
 		std::string imei = platform::get_IMEI();
 
 		if( !dirs.config_path.empty() ){ log_msg(MSG_DEBUG | MSG_TO_FILE, _GREEN "Config file path:\t\t" _BOLD "'%s'\n" _RESET, dirs.config_path); } 
@@ -185,6 +200,8 @@ void AVI::preinit(bool conf_trace, bool first_time_called)
 
 		// Создание рабочих директорий
 		this->dirs.create();
+		this->media_chains.init(this->dirs.media_dir, this->dirs.media_cache_dir);
+		this->tts_cache.init(this->dirs.tts_cache_dir, this->settings.tts_command);
 
 		// Создание (открытие) баз данных
 		this->mdb.init(this->dirs.main_db_path, DB_RW | DB_FMTX | DB_CREATE);
@@ -204,6 +221,7 @@ void AVI::preinit(bool conf_trace, bool first_time_called)
 		}
 
 		NSIDatabase::set_path(this->dirs.nsi_db_path);
+		NSIDatabase::set_hilbert_layout(this->settings.nsi_hilbert_layout);
 		if(this->nsi_reload()){
 			log_msg(MSG_DEBUG | MSG_TO_FILE, _GREEN "NSI version:\t\t" _BOLD "'%s'\n" _RESET, NSIDatabase::get_version());
 		}
@@ -329,6 +347,33 @@ void AVI::init(bool conf_trace)
 }
 
 
+// Длительность медиа-файла из метаданных (при отсутствии - разбор файла)
+uint32_t AVI::media_duration(const std::string &filename)
+{
+	media_meta meta;
+
+	if(this->mdb.media_data.get(filename, &meta)){
+		return meta.duration_ms;
+	}
+
+	try{
+		const std::string path = dirs.media_dir + "/" + filename;
+		utils::MP3_info info = utils::mp3_file_info(path);
+
+		meta.md5 = utils::file_md5(path);
+		meta.duration_ms = info.duration_ms;
+		meta.bitrate = info.bitrate;
+		meta.sample_rate = info.sample_rate;
+
+		this->mdb.media_data.set(filename, meta);
+	}
+	catch(const std::exception &e){
+		log_warn("Could not get duration of media '%s': %s\n", filename, e.what());
+	}
+
+	return meta.duration_ms;
+}
+
 // Определение готовности устройства к работе
 void AVI::data_check()
 {	
@@ -362,6 +407,10 @@ void AVI::data_check()
 	this->announ_task.stop();
 	this->announ_task.wait();
 
+	// Склеенные цепочки и синтезированные фразы относятся к фреймам текущего маршрута
+	this->media_chains.clear();
+	this->tts_cache.clear();
+
 	NSIDatabase::open();
 	NSIDatabase::reload_route_frames();
 	NSIDatabase::close();
@@ -375,6 +424,15 @@ void AVI::data_check()
 		this->wait_for_data("медиа");
 		return;
 	}
+
+	// Длительности нужны проигрывателю для оценки времени освобождения очереди
+	NSIDatabase::set_media_durations([this](const std::string &filename){ return this->media_duration(filename); });
+
+	// Фоновая склейка цепочек родитель -> потомки для воспроизведения без пауз
+	this->media_chains.build_async();
+
+	// Фоновый синтез фраз маршрута - к моменту входа в зону фраза уже будет файлом
+	this->tts_cache.prepare_async(NSIDatabase::get_media_texts());
 	
 	// Переход в штатный режим работы
 	this->regular_mode();
@@ -402,13 +460,55 @@ void AVI::wait_for_route_selection()
 	// Ожидаем выбора через push-сообщение
 	this->lc_task.enter_regular_mode();
 
+	// Ожидаем определения маршрута по траектории
+	if(this->settings.route_autoselect > 0){
+		this->route_task.stop();
+		this->route_task.wait();
+
+		const auto mode = (this->settings.route_autoselect >= RouteDetect_task::SELECT) ? RouteDetect_task::SELECT : RouteDetect_task::PROPOSE;
+
+		this->route_task.set_period(std::chrono::milliseconds(1000));
+		this->route_task.init(mode, [this](int route_id, RouteDetect_task::mode m){ this->on_route_detected(route_id, m); });
+		this->route_task.start();
+	}
+
 	this->dev_state.set("Ожидание выбора маршрута");
 }
 
+void AVI::on_route_detected(int route_id, RouteDetect_task::mode mode)
+{
+	const std::string name = NSIDatabase::get_route_name(route_id);
+
+	if(name.empty()){
+		return;
+	}
+
+	if(mode == RouteDetect_task::SELECT){
+		log_info("Route '%s' selected by trajectory\n", name);
+		// Так же, как выбор водителем через меню
+		LCD_Interface::route_selection_menu.on_select(name);
+		return;
+	}
+
+	// Предлагаем: определенный маршрут первым (выбранным по умолчанию) в меню выбора
+	std::vector<std::string> route_names = NSIDatabase::get_available_route_names();
+	auto it = std::find(route_names.begin(), route_names.end(), name);
+	if(it != route_names.end()){
+		std::rotate(route_names.begin(), it, it + 1);
+	}
+
+	LCD_Interface::route_selection_menu.update_content(std::move(route_names));
+	this->iface.display(&LCD_Interface::route_selection_menu);
+}
+
 void AVI::regular_mode()
 {
 	log_msg(MSG_DEBUG | MSG_TO_FILE, _BOLD "~ %s entering regular mode ~\n" _RESET, APP_NAME);
 
+	// Маршрут выбран - определение по траектории не нужно (задача может
+	// вызвать этот переход сама, поэтому без ожидания завершения)
+	this->route_task.stop();
+
 	this->iface.display(&LCD_Interface::main_menu);
 	LCD_Interface::route_selection_menu.setup_timeout(LCD_Interface::menu_timeout, [this](){ iface.display(&LCD_Interface::main_menu); });
 
@@ -420,13 +520,9 @@ void AVI::regular_mode()
 	} 
 	else{
 
-		if(this->settings.gps_poll_period_ms < 250){
-			this->announ_task.set_period(std::chrono::milliseconds(this->settings.gps_poll_period_ms), 
-				std::chrono::milliseconds(this->settings.gps_poll_period_ms / 2));
-		}
-		else{
-			this->announ_task.set_period(std::chrono::milliseconds(this->settings.gps_poll_period_ms));
-		}
+		// Координаты обрабатываются по мере поступления от источника GPS данных,
+		// периодически задача только проверяет их наличие
+		this->announ_task.set_period(std::chrono::milliseconds(1000));
 		
 		this->announ_task.init(&this->dirs.media_dir);
 		this->announ_task.start(true);
@@ -445,11 +541,17 @@ void AVI::deinit()
 
 	this->lc_task.stop();
 	this->announ_task.stop();
+	this->route_task.stop();
 
 	std::this_thread::sleep_for(std::chrono::milliseconds(250));
 	lc::ProtoTransactions::deinit();
 	this->lc_task.cancel();
 	this->announ_task.cancel();
+	this->route_task.cancel();
+
+	// Фоновые склейка цепочек и синтез фраз
+	this->media_chains.stop();
+	this->tts_cache.stop();
 
 	platform::deinit();
 	this->mdb.deinit();
@@ -22,6 +22,7 @@
 #include "app_lc.hpp"
 #include "app_menu.hpp"
 #include "announ.hpp"
+#include "route_detect.hpp"
 
 #ifndef APP_VERSION
 #define APP_VERSION					"1.0"
@@ -40,6 +41,9 @@ public:
 	struct Settings{	
 		std::string update_command;				// Команда вызова скрипта обновления ПО
 		std::string i2c_dev;					// Название устройства I2C
+		std::string gps_nmea_port;				// Порт потока NMEA GPS приемника (пусто - опрос AT+CGPSINFO)
+		std::string gps_fault_profile;			// Профиль неисправностей GPS данных для тестирования (пусто - отключено)
+		std::string tts_command;				// Команда синтеза фраз в MP3 ({text_file} - файл с текстом, {out} - результат)
 		
 		uint64_t log_max_size = utils::KB_to_B(512);	// Максимальный размер лог-файла в Kбайтах
 		uint64_t log_backup_max_size = utils::KB_to_B(1024);	// Максимальный размер директории для хранения логов в Kбайтах
@@ -49,11 +53,20 @@ public:
 		int sys_ev_level = 0;					// Уровень подробности системных событий
 		int lc_poll_period = 60;				// Период запуска клиента ЛЦ (сек)
 		int lc_download_period = 60;			// Период запроса обновлений файлов из ЛЦ (сек)
-		int gps_poll_period_ms = 1000; 			// Период обновления GPS координат (мс)
-		int gps_valid_threshold = 4;			// Порог валидности GPS координат
+		int gps_poll_period_ms = 1000; 			// Период опроса GPS координат (мс), если не задан gps_nmea_port
+		int gps_max_poll_period_ms = 1000;		// Наибольший период GPS данных вдали от зон (мс), <= gps_poll_period_ms - адаптация отключена
+		int gps_valid_threshold = 4;			// Количество согласованных решений до полной уверенности фильтра GPS координат
+		int route_autoselect = 0;				// Определение маршрута по траектории, пока он не выбран: 0 - откл., 1 - предложить, 2 - выбрать
 		int lcd_backlight_timeout = 10;			// Таймаут выключения подстветки дисплея (сек)
 		double btn_long_press_sec = 2.0;		// Порог длительного нажатия на кнопку (сек)
 		double gps_min_valid_speed = 6.0;		// Минимальная валидная скорость по GPS (км\ч) (курс может быть неустановившимся)
+		double gps_map_match_max_m = 30.0;		// Наибольшее удаление решения от линии маршрута для привязки к ней (м), 0 - отключено
+		double gps_dr_max_sec = 10.0;			// Наибольшее время счисления пути при пропадании GPS решений (сек), 0 - отключено
+		double gps_dr_max_m = 300.0;			// Наибольшее расстояние счисления пути (м)
+		double gps_gen_rate_hz = 0.0;			// Частота решений генератора .rmc с интерполяцией маршрута (Гц), 0 - без интерполяции
+		double gps_gen_time_scale = 1.0;		// Ускорение времени маршрута генератора .rmc при интерполяции
+		bool nsi_hilbert_layout = false;		// Расположение фреймов маршрута в памяти вдоль кривой Гильберта
+		bool gps_map_match_frames = false;		// Привязка к линии центров зон фреймов, если в НСИ нет kGeometry маршрута
 	};
 
 	// Рабочие директории приложения
@@ -70,8 +83,10 @@ public:
 		std::string tmp_dir = data_dir + "/tmp";					// Поддиректория временных файлов в директории данных СУВ
 		std::string nsi_db_path = data_dir + "/nsi.db";				// Путь к базе НСИ
 		std::string media_dir = data_dir + "/media"; 				// Путь к директории медиа-файлов
+		std::string media_cache_dir = data_dir + "/media_cache";	// Директория склеенных медиа-цепочек
+		std::string tts_cache_dir = data_dir + "/tts_cache";		// Директория синтезированных фраз
 		std::string gps_gen_path; 									// Путь к файлу симуляции GPS
-		std::string gps_track_path = data_dir + "/gps.track";		//
+		std::string gps_track_path = data_dir + "/gps.trk";			// Журнал GPS трека (.track - текстовый формат)
 
 		void create() const;
 		void reset_data_subdirs();
@@ -107,6 +122,7 @@ public:
 	void create_sys_event(const std::string &ev_name, const std::string &ev_data = "") const;
 
 	Navigator::position get_current_position() const { return this->announ_task.get_position(); }
+	std::string get_playing_media() const { return this->announ_task.get_playing_media(); }
 
 	Settings settings;				// Настройки приложения
 	Directories dirs;				// Рабочие директории
@@ -114,10 +130,13 @@ public:
 	DeviceState dev_state;			// Состояние устройства
 	mutable MainDatabase mdb; 		// Основная БД приложения
 	mutable LCD_Interface iface{this};	// Интерфейс (ЖК дисплей + кнопки)
+	MediaChainCache media_chains;		// Склеенные цепочки родитель -> потомки
+	TTSCache tts_cache;					// Синтезированные фразы маршрута
 
 private:
 	LC_client_task lc_task{this};			// Фоновая задачи связи с сервером ЛЦ
 	Announcement_task announ_task{this};	// Фоновая задача оповещения
+	RouteDetect_task route_task;			// Фоновая задача определения маршрута по траектории
 
 	mutable std::mutex init_phase_mutex;
 
@@ -129,12 +148,16 @@ private:
 
 	void data_check();
 	bool nsi_reload() const;
+	uint32_t media_duration(const std::string &filename);
 
 	void regular_mode();		// Штатный режим работы
 	void wait_for_data(const std::string &data_type);
 
 	// RouteSelection route_selection_task{ [this](){ data_check(); } };
 	void wait_for_route_selection();
+
+	// Маршрут определен по траектории (из потока route_task)
+	void on_route_detected(int route_id, RouteDetect_task::mode mode);
 };
 
 
@@ -176,6 +176,7 @@ std::string Config::read_app_settings(AVI::Settings &out, AVI::Directories &dirs
 	// LOOKUP_AND_SET_STR("update_command", out.update_command, "");
 
 	// LOOKUP_AND_SET_STR("i2c_dev", out.i2c_dev, "");
+	LOOKUP_AND_SET_STR("tts_command", out.tts_command, "");
 	// LOOKUP_AND_SET_STR("net_iface_name", out.net_iface_name, "");
 
 	// Настройки директорий
@@ -190,10 +191,21 @@ std::string Config::read_app_settings(AVI::Settings &out, AVI::Directories &dirs
 	LOOKUP_AND_SET_INT("lc_poll_period", out.lc_poll_period, "[sec]");
 	LOOKUP_AND_SET_INT("lc_download_period", out.lc_download_period, "[sec]");
 	LOOKUP_AND_SET_INT("gps_poll_period_ms", out.gps_poll_period_ms, "[millisec]");
+	LOOKUP_AND_SET_INT("gps_max_poll_period_ms", out.gps_max_poll_period_ms, "[millisec]");
 	LOOKUP_AND_SET_INT("gps_valid_threshold", out.gps_valid_threshold, "");
 	LOOKUP_AND_SET_DOUBLE("gps_min_valid_speed", out.gps_min_valid_speed, "[km/h]");
+	LOOKUP_AND_SET_DOUBLE("gps_map_match_max_m", out.gps_map_match_max_m, "[m]");
+	LOOKUP_AND_SET_BOOL("gps_map_match_frames", out.gps_map_match_frames, "");
+	LOOKUP_AND_SET_DOUBLE("gps_dr_max_sec", out.gps_dr_max_sec, "[sec]");
+	LOOKUP_AND_SET_DOUBLE("gps_dr_max_m", out.gps_dr_max_m, "[m]");
+	LOOKUP_AND_SET_STR("gps_nmea_port", out.gps_nmea_port, "");
 	LOOKUP_AND_SET_STR("gps_gen_path", dirs.gps_gen_path, "");
+	LOOKUP_AND_SET_DOUBLE("gps_gen_rate_hz", out.gps_gen_rate_hz, "[Hz]");
+	LOOKUP_AND_SET_DOUBLE("gps_gen_time_scale", out.gps_gen_time_scale, "");
+	LOOKUP_AND_SET_STR("gps_fault_profile", out.gps_fault_profile, "");
 	LOOKUP_AND_SET_STR("gps_track_path", dirs.gps_track_path, "");
+	LOOKUP_AND_SET_INT("route_autoselect", out.route_autoselect, "");
+	LOOKUP_AND_SET_BOOL("nsi_hilbert_layout", out.nsi_hilbert_layout, "");
 
 	LOOKUP_AND_SET_INT("lcd_backlight_timeout", out.lcd_backlight_timeout, "[sec]");
 	LOOKUP_AND_SET_DOUBLE("btn_long_press_sec", out.btn_long_press_sec, "[sec]");
@@ -49,10 +49,7 @@ void Base_table::clear()
 	send_sql(sql, excp_method(""));
 }
 
-bool Base_table::add_column_if_not_exists(
-	const std::string &col_name, 
-	const std::string &col_type, 
-	const std::string &col_value)
+bool Base_table::column_exists(const std::string &col_name) const
 {
 	struct column_info{
 		std::string name;
@@ -79,12 +76,20 @@ bool Base_table::add_column_if_not_exists(
 
 	send_sql(sql, excp_method(""), callback, &ci);
 
-	if(ci.exists){
+	return ci.exists;
+}
+
+bool Base_table::add_column_if_not_exists(
+	const std::string &col_name, 
+	const std::string &col_type, 
+	const std::string &col_value)
+{
+	if(this->column_exists(col_name)){
 		log_msg(MSG_VERBOSE | MSG_TO_FILE, "Column '%s' already exists in '%s' table\n", col_name, this->name);
 		return true;
 	}
 
-	sql = "ALTER TABLE " + this->name + " ADD COLUMN " + col_name + " " + col_type;
+	std::string sql = "ALTER TABLE " + this->name + " ADD COLUMN " + col_name + " " + col_type;
 	
 	if(!col_value.empty()){
 		sql += " DEFAULT " + col_value;
@@ -309,6 +314,89 @@ std::string FilesMetadata_table::get_fdate(const std::string &prot_ft)
 
 
 
+// --- Таблица метаданных медиа-файлов ---
+
+void MediaMetadata_table::create()
+{
+	std::string sql = "CREATE TABLE IF NOT EXISTS " + name + "( \
+name TEXT UNIQUE, \
+md5 TEXT, \
+duration_ms INTEGER, \
+bitrate INTEGER, \
+sample_rate INTEGER); ";
+
+	send_sql(sql, excp_method(""));
+}
+
+void MediaMetadata_table::set(const std::string &file_name, const media_meta &meta)
+{
+	std::string sql = "INSERT OR REPLACE INTO " + name + " VALUES('" + file_name + "', '" + meta.md5 + "', " + 
+		to_s(meta.duration_ms) + ", " + to_s(meta.bitrate) + ", " + to_s(meta.sample_rate) + ");";
+	send_sql(sql, excp_method(""));
+
+	std::lock_guard<std::recursive_mutex> lck(this->cache_mtx);
+	this->cache[file_name] = meta;
+}
+
+void MediaMetadata_table::remove(const std::string &file_name)
+{
+	std::string sql = "DELETE FROM " + name + " WHERE name='" + file_name + "';";
+	send_sql(sql, excp_method(""));
+
+	std::lock_guard<std::recursive_mutex> lck(this->cache_mtx);
+	this->cache.erase(file_name);
+}
+
+media_metas MediaMetadata_table::get_all()
+{
+	std::lock_guard<std::recursive_mutex> lck(this->cache_mtx);
+	if(this->cache_loaded){
+		return this->cache;
+	}
+
+	std::string sql = "SELECT name, md5, duration_ms, bitrate, sample_rate FROM " + name + ";";
+
+	// Вызывается для каждой строки отдельно
+	auto callback = [](void *param, int argc, char **argv, char **col_name) -> int { 
+		media_metas *tmp = static_cast<media_metas*>(param);
+
+		media_meta meta;
+		meta.md5 = argv[1] ? argv[1] : "";
+		meta.duration_ms = argv[2] ? strtoul(argv[2], nullptr, 10) : 0;
+		meta.bitrate = argv[3] ? strtoul(argv[3], nullptr, 10) : 0;
+		meta.sample_rate = argv[4] ? strtoul(argv[4], nullptr, 10) : 0;
+
+		tmp->insert( {argv[0], meta} );
+		return 0;
+	};
+
+	send_sql(sql, excp_method(""), callback, &this->cache);
+	this->cache_loaded = true;
+
+	return this->cache;
+}
+
+bool MediaMetadata_table::get(const std::string &file_name, media_meta *meta)
+{
+	std::lock_guard<std::recursive_mutex> lck(this->cache_mtx);
+	if( !this->cache_loaded ){
+		this->get_all();
+	}
+
+	auto it = this->cache.find(file_name);
+	if(it == this->cache.end()){
+		return false;
+	}
+
+	if(meta){
+		*meta = it->second;
+	}
+
+	return true;
+}
+
+
+
 // --- Таблица системных флагов ---
 void DeviceInfo_table::create()
 {
@@ -419,6 +507,9 @@ void MainDatabase::init(const std::string &path, int flags)
 	dev_info.set_fd_ptr(&this->fd);
 	dev_info.create();
 
+	media_data.set_fd_ptr(&this->fd);
+	media_data.create();
+
 	this->path = path;
 }
 
@@ -452,6 +543,7 @@ void MainDatabase::deinit()
 using kRoute = NSIDatabase::kRoute_table;
 using kFrames = NSIDatabase::kFrames_table;
 using kCfg = NSIDatabase::kCfg_table;
+using kGeometry = NSIDatabase::kGeometry_table;
 
 std::recursive_mutex NSIDatabase::db_file_mutex_;
 sqlite3 *NSIDatabase::fd_ = nullptr;
@@ -459,9 +551,16 @@ std::string NSIDatabase::path_;
 kRoute NSIDatabase::kroute_;
 kCfg NSIDatabase::kcfg_;
 kFrames NSIDatabase::kframe_;
+kGeometry NSIDatabase::kgeometry_;
 kRoute::routes NSIDatabase::routes_;
 kCfg::params NSIDatabase::cfg_params_;
 std::pair<kFrames::main_frames, kFrames::child_frames> NSIDatabase::frames_;
+ZoneGrid NSIDatabase::zone_grid_;
+std::vector<utils::Coord> NSIDatabase::geometry_;
+std::vector<std::pair<int32_t, uint32_t>> NSIDatabase::route_triggers_;
+uint64_t NSIDatabase::frames_generation_ = 1;
+bool NSIDatabase::hilbert_layout_ = false;
+std::vector<std::pair<int, uint32_t>> NSIDatabase::frame_slots_;
 std::mutex NSIDatabase::curr_route_mutex_;
 int NSIDatabase::curr_route_id_ = -1;
 
@@ -482,6 +581,7 @@ bool NSIDatabase::open(int modes)
 	kroute_.set_fd_ptr(&fd_);
 	kcfg_.set_fd_ptr(&fd_);
 	kframe_.set_fd_ptr(&fd_);
+	kgeometry_.set_fd_ptr(&fd_);
 
 	return true;
 }
@@ -610,51 +710,24 @@ kCfg::params kCfg::read()
 // Zones
 uint8_t kFrames::Zone::course_to_bitmask(double course_degrees) noexcept
 {
-	if((course_degrees < 0.0) || (course_degrees > 360.0)){
+	// Сектор i: [45 * i .. 45 * (i + 1)), 360 градусов - 0-й сектор
+	static const uint8_t sector_bits[9] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x01};
+
+	if( !((course_degrees >= 0.0) && (course_degrees <= 360.0)) ){
 		return 0x00;
 	}
 
-	if((course_degrees == 360.0) || (course_degrees < 45.0)){
-		return 0x01;	// 0-й сектор
-	}
-	else if(course_degrees < 90.0){
-		return 0x02;	// 1-й сектор
-	}
-	else if(course_degrees < 135.0){
-		return 0x04;	// 2-й сектор
-	}
-	else if(course_degrees < 180.0){
-		return 0x08;	// 3-й сектор
-	}
-	else if(course_degrees < 225.0){
-		return 0x10;	// 4-й сектор
-	}
-	else if(course_degrees < 270.0){
-		return 0x20;	// 5-й сектор
-	}
-	else if(course_degrees < 315.0){
-		return 0x40;	// 6-й сектор
-	}
-	else if(course_degrees < 360.0){
-		return 0x80;	// 7-й сектор
-	}
+	return sector_bits[static_cast<uint32_t>(course_degrees * (1.0 / 45.0))];
 }
 
-// Проверка курса на соответствие текущей битовой карте направлений
+// Проверка курса на соответствие текущей битовой карте направлений.
+// Вызывается на каждую зону-кандидат - без журналирования несовпадений
 bool kFrames::Zone::course_check(double course) const noexcept
 {
-	const uint8_t course_bitmask = course_to_bitmask(course);
-
-	if((course_bitmap_ & course_bitmask) == 0){
-		// Такой сектор не выставлен
-		log_msg(MSG_TRACE, "course mismatch (current: 0x%02X vs bitmap: 0x%02X)\n", course_bitmask, course_bitmap_);
-		return false;
-	}
-
-	return true;
+	return (course_bitmap_ & course_to_bitmask(course)) != 0;
 }
 
-bool kFrames::RectangleZone::contains(const std::pair<double, double> &lat_lon, double course) const
+bool kFrames::RectangleZone::contains(const utils::Coord &point, double course) const
 {
 	// Признак вхождения точки в прямоугольник заданным 
 	// Левым Нижним углом (start) и Правым верхним (end):
@@ -663,12 +736,9 @@ bool kFrames::RectangleZone::contains(const std::pair<double, double> &lat_lon,
 	// 				&&
 	// end.lat > point.lat  > start.lat 
 	//
-	const double &lat = lat_lon.first;
-	const double &lon = lat_lon.second;
-
-	if((lon < lon_end_) && (lon > lon_start_) && (lat < lat_end_) && (lat > lat_start_)){
+	if((point.lon < end_.lon) && (point.lon > start_.lon) && (point.lat < end_.lat) && (point.lat > start_.lat)){
 
-		log_msg(MSG_TRACE, "inside RectangleZone S(%lf, %lf), E(%lf, %lf)\n", lat_start_, lon_start_, lat_end_, lon_end_);
+		log_msg(MSG_TRACE, "inside RectangleZone S(%d, %d), E(%d, %d) [udeg]\n", start_.lat, start_.lon, end_.lat, end_.lon);
 
 		if(course >= 0.0){
 			return course_check(course);
@@ -682,86 +752,101 @@ bool kFrames::RectangleZone::contains(const std::pair<double, double> &lat_lon,
 
 std::string kFrames::RectangleZone::show() const
 { 
-	return "S(" + std::to_string(lat_start_) + ", " + std::to_string(lon_start_) + "), E(" +
-		std::to_string(lat_end_) + ", " + std::to_string(lon_end_) + "), C:" + std::to_string(course_bitmap_);
+	return "S(" + utils::microdegrees_to_string(start_.lat) + ", " + utils::microdegrees_to_string(start_.lon) + "), E(" +
+		utils::microdegrees_to_string(end_.lat) + ", " + utils::microdegrees_to_string(end_.lon) + "), C:" + std::to_string(course_bitmap_);
 }
 
-#define PI			3.14159265
-#define EARTH_R 	6372795		// Радиус Земли в метрах
-
-// Сферическая теорема косинусов (d - угловое расстояние между точками А и С)
-static double spherical_cosinus_distance(double latA, double longA, double latC, double longC)
+bool kFrames::CircleZone::contains(const utils::Coord &point, double course) const
 {
-	const double long_delta = longC - longA;
+	// Проверяем вначале курс
+	if((course >= 0) && !course_check(course)){
+		return false;
+	}
 
-	// cos(d) = sin(latА)·sin(latC) + cos(latА)·cos(latC)·cos(longА − longC)
-	const double d = acos( sin(latA) * sin(latC) + cos(latA) * cos(latC) * cos(long_delta) );
+	// Сравнение квадратов расстояний в сантиметрах - без тригонометрии и извлечения корня
+	const uint64_t radius2 = static_cast<uint64_t>(radius_cm_) * radius_cm_;
 
-	// Перевод углового расстояния в метрическое 
-	// L = d * EARTH_R (meters)
-	return d * static_cast<double>(EARTH_R);
+	return metric_.distance2_cm(start_, point) < radius2;
 }
 
-// Модифицированный гаверсинус (решает проблему точек-антиподов и небольших расстояний)
-static double modified_hoversine_distance(double latA, double longA, double latC, double longC)
+bool kFrames::RectangleZone::intersects(const utils::Coord &from, const utils::Coord &to, double course) const
 {
-	const double long_delta = longC - longA;
-	const double clat1 = cos(latA);
-	const double clat2 = cos(latC);
-	const double slat1 = sin(latA);
-	const double slat2 = sin(latC);
-	const double sldelta = sin(long_delta);
-	const double cldelta = cos(long_delta);
+	if((course >= 0.0) && !course_check(course)){
+		return false;
+	}
+
+	// Отсечение отрезка прямоугольником (Лианг-Барски) в микроградусах:
+	// на расстояниях между решениями искажения проекции несущественны
+	const double dlat = static_cast<double>(to.lat) - from.lat;
+	const double dlon = static_cast<double>(to.lon) - from.lon;
+	double t0 = 0.0;
+	double t1 = 1.0;
+
+	auto clip = [&t0, &t1](double p, double q){
+		if(p == 0.0){
+			return q >= 0.0;
+		}
 
-	const double top = sqrt( pow(clat2 * sldelta, 2) + pow(clat1 * slat2 - slat1 * clat2 * cldelta, 2) );
-	const double bot = slat1 * slat2 + clat1 * clat2 * cldelta;
+		const double t = q / p;
+		if(p < 0.0){
+			if(t > t1){
+				return false;
+			}
+			if(t > t0){
+				t0 = t;
+			}
+		}
+		else{
+			if(t < t0){
+				return false;
+			}
+			if(t < t1){
+				t1 = t;
+			}
+		}
 
-	const double d = atan(top / bot);
+		return true;
+	};
 
-	return d * static_cast<double>(EARTH_R);
+	return clip(-dlon, static_cast<double>(from.lon) - start_.lon) && clip(dlon, static_cast<double>(end_.lon) - from.lon) &&
+		clip(-dlat, static_cast<double>(from.lat) - start_.lat) && clip(dlat, static_cast<double>(end_.lat) - from.lat);
 }
 
-bool kFrames::CircleZone::contains(const std::pair<double, double> &lat_lon, double course) const
+bool kFrames::CircleZone::intersects(const utils::Coord &from, const utils::Coord &to, double course) const
 {
-	// Проверяем вначале курс
-	if((course >= 0) && !course_check(course)){
+	if((course >= 0.0) && !course_check(course)){
 		return false;
 	}
 
-	// Преобразование lat, long в радианы
-	const double latA = lat_lon.first * PI / 180.0;
-	const double longA = lat_lon.second * PI / 180.0;
-	const double latC = lat_start_ * PI / 180.0;	// координаты центра 
-	const double longC = lon_start_ * PI / 180.0;	// окружности
-	
-	double distance = 0.0;
-	double sec = 0.0;
+	// Ближайшая к центру точка отрезка (см относительно центра)
+	int64_t ax = 0, ay = 0, bx = 0, by = 0;
+	metric_.offset_cm(start_, from, &ax, &ay);
+	metric_.offset_cm(start_, to, &bx, &by);
 
-	// sec = utils::calc_exec_time([&distance, latA, longA, latC, longC](){ 
-	// 	distance = spherical_cosinus_distance(latA, longA, latC, longC); 
-	// });
+	const double dx = static_cast<double>(bx - ax);
+	const double dy = static_cast<double>(by - ay);
+	const double len2 = dx * dx + dy * dy;
 
-	// printf("spherical_cosinus_distance between points (%lf, %lf) and (%lf, %lf) : %lf meters (took: %lf sec)\n",
-	// 	lat_lon.first, lat_lon.second, lat_start_, lon_start_, distance, sec);
-	
-	sec = utils::calc_exec_time([&distance, latA, longA, latC, longC](){ 
-		distance = modified_hoversine_distance(latA, longA, latC, longC); 
-	});
+	double t = (len2 > 0.0) ? -(ax * dx + ay * dy) / len2 : 0.0;
+	t = (t < 0.0) ? 0.0 : ((t > 1.0) ? 1.0 : t);
 
-	// printf("distance_modified_hoversine between points (%lf, %lf) and (%lf, %lf) : %lf meters (took: %lf sec)\n",
-	// 	lat_lon.first, lat_lon.second, lat_start_, lon_start_, distance, sec);
+	const double px = ax + t * dx;
+	const double py = ay + t * dy;
+	const double radius = static_cast<double>(radius_cm_);
 
-	if(distance < radius_){
-		return true;
-	}
+	return px * px + py * py < radius * radius;
+}
 
-	return false;
+void kFrames::CircleZone::bounds(utils::Coord *min, utils::Coord *max) const
+{
+	*min = metric_.shift(start_, -static_cast<int64_t>(radius_cm_), -static_cast<int64_t>(radius_cm_));
+	*max = metric_.shift(start_, radius_cm_, radius_cm_);
 }
 
 std::string kFrames::CircleZone::show() const
 { 
-	return "S(" + std::to_string(lat_start_) + ", " + std::to_string(lon_start_) + "), R:" +
-		std::to_string(radius_) + ", C:" + std::to_string(course_bitmap_);
+	return "S(" + utils::microdegrees_to_string(start_.lat) + ", " + utils::microdegrees_to_string(start_.lon) + "), R:" +
+		std::to_string(radius_cm_ / 100.0) + ", C:" + std::to_string(course_bitmap_);
 }
 
 
@@ -800,8 +885,13 @@ std::pair<kFrames::main_frames, kFrames::child_frames> kFrames::read(int route_i
 {
 	std::pair<main_frames, child_frames> res;
 
+	// Столбцы текста фразы для синтеза речи и отметки срабатывания вдоль маршрута
+	// есть только в новых версиях НСИ - столбцы запроса находятся по имени
+	const std::string text_col = this->column_exists("text") ? ", text" : "";
+	const std::string offset_col = this->column_exists("route_offset") ? ", route_offset" : "";
+
 	const std::string sql = "SELECT id, lon_start, lat_start, lon_end, lat_end, radius, course, \
-play_mode, id_next, is_child, filename, pause FROM kFrames WHERE id_route=" + to_s(route_id) + ";";
+play_mode, id_next, is_child, filename, pause" + text_col + offset_col + " FROM kFrames WHERE id_route=" + to_s(route_id) + ";";
 
 	auto callback = [](void *param, int argc, char **argv, char **col_name) -> int { 
 		std::pair<main_frames, child_frames> *res = static_cast<std::pair<main_frames, child_frames> *>(param);
@@ -811,33 +901,24 @@ play_mode, id_next, is_child, filename, pause FROM kFrames WHERE id_route=" + to
 		}
 
 		Frame frm_data;
-		const double NOT_SET = std::numeric_limits<double>::max();
-		double lon_start = NOT_SET;
-		double lat_start = NOT_SET;
-		double lon_end = NOT_SET;
-		double lat_end = NOT_SET;
+		utils::Coord start;
+		utils::Coord end;
+		bool start_set = false;
+		bool end_set = false;
 		double radius = 0.0;
 		uint8_t course = 0;
 		uint8_t is_child = 0;	// 0 не дочерний, 1 - дочерний
 
-		sscanf(argv[0], "%d", &frm_data.id);
+		// Координата задана, если столбец не NULL и содержит число
+		auto read_coord = [](const char *str, int32_t *out) -> bool {
+			return str && utils::parse_microdegrees(str, strlen(str), out);
+		};
 
-		// Считываем описание зоны 
-		if(argv[1]){
-			sscanf(argv[1], "%lf", &lon_start);
-		}
-			
-		if(argv[2]){
-			sscanf(argv[2], "%lf", &lat_start);
-		}
+		sscanf(argv[0], "%d", &frm_data.id);
 
-		if(argv[3]){
-			sscanf(argv[3], "%lf", &lon_end);
-		}
-		
-		if(argv[4]){
-			sscanf(argv[4], "%lf", &lat_end);
-		}	
+		// Считываем описание зоны (координаты - сразу в микроградусы)
+		start_set = read_coord(argv[1], &start.lon) && read_coord(argv[2], &start.lat);
+		end_set = read_coord(argv[3], &end.lon) && read_coord(argv[4], &end.lat);
 		
 		if(argv[5]){
 			sscanf(argv[5], "%lf", &radius);
@@ -853,19 +934,43 @@ play_mode, id_next, is_child, filename, pause FROM kFrames WHERE id_route=" + to
 		}
 
 		sscanf(argv[9], "%" SCNu8 "", &is_child);	
-		frm_data.minfo.filename = argv[10];
+
+		if(argv[10]){
+			frm_data.minfo.filename = argv[10];
+		}
 
 		sscanf(argv[11], "%d", &frm_data.minfo.pause);
 
+		for(int i = 12; i < argc; ++i){
+			if( !argv[i] ){
+				continue;
+			}
+
+			if( !strcmp(col_name[i], "text") ){
+				frm_data.minfo.text = argv[i];
+			}
+			else if( !strcmp(col_name[i], "route_offset") ){
+				// Отметка задается в метрах
+				double offset_m = -1.0;
+				if((sscanf(argv[i], "%lf", &offset_m) == 1) && (offset_m >= 0.0)){
+					frm_data.route_offset_cm = static_cast<int32_t>(std::lround(offset_m * 100.0));
+				}
+			}
+		}
+
 		// Определяем что это за фрейма - основной или дочерний 
-		if( !is_child && (lon_start != NOT_SET) && (lat_start != NOT_SET) ){
+		if( !is_child && !start_set && (frm_data.route_offset_cm >= 0) ){
+			// Фрейм основной, срабатывает только по отметке вдоль маршрута
+			res->first.push_back(std::move(frm_data));
+		}
+		else if( !is_child && start_set ){
 			// Фрейм оснвной => Распределяем зоны 
-			if((lon_end == NOT_SET) || (lat_end == NOT_SET) || (radius > 0.0)){
-				std::unique_ptr<Zone> zptr{new CircleZone(lat_start, lon_start, course, radius)};
+			if( !end_set || (radius > 0.0) ){
+				std::unique_ptr<Zone> zptr{new CircleZone(start, course, radius)};
 				frm_data.zone = std::move(zptr);
 			}
 			else{
-				std::unique_ptr<Zone> zptr{new RectangleZone(lat_start, lon_start, course, lat_end, lon_end)};
+				std::unique_ptr<Zone> zptr{new RectangleZone(start, course, end)};
 				frm_data.zone = std::move(zptr);
 			}
 
@@ -887,6 +992,35 @@ play_mode, id_next, is_child, filename, pause FROM kFrames WHERE id_route=" + to
 	return res;	
 }
 
+std::vector<utils::Coord> kGeometry::read(int route_id)
+{
+	std::vector<utils::Coord> res;
+
+	// Таблица есть только в НСИ с геометрией маршрутов
+	if( !this->column_exists("seq") ){
+		return res;
+	}
+
+	const std::string sql = "SELECT lat, lon FROM " + name + " WHERE id_route=" + to_s(route_id) + " ORDER BY seq;";
+
+	auto callback = [](void *param, int argc, char **argv, char **col_name) -> int {
+		std::vector<utils::Coord> *res = static_cast<std::vector<utils::Coord>*>(param);
+		utils::Coord point;
+
+		if((argc >= 2) && argv[0] && argv[1] && utils::parse_microdegrees(argv[0], strlen(argv[0]), &point.lat) &&
+			utils::parse_microdegrees(argv[1], strlen(argv[1]), &point.lon))
+		{
+			res->push_back(point);
+		}
+
+		return 0;
+	};
+
+	send_sql(sql, excp_method(""), callback, &res);
+
+	return res;
+}
+
 void NSIDatabase::read()
 {
 	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
@@ -925,6 +1059,43 @@ std::vector<std::string> NSIDatabase::get_available_route_names()
 	return res;
 }
 
+std::string NSIDatabase::get_route_name(int route_id)
+{
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	auto it = routes_.find(route_id);
+	return (it != routes_.end()) ? it->second.name : std::string();
+}
+
+std::vector<std::pair<int, kFrames::main_frames>> NSIDatabase::read_all_route_frames()
+{
+	std::vector<std::pair<int, kFrames::main_frames>> res;
+
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	// Открытая вызывающим БД остается открытой
+	const bool opened = (fd_ == nullptr);
+	if( !open() ){
+		log_warn("Couldn't open NSI (%s)\n", path_);
+		return res;
+	}
+
+	for(const auto &elem : routes_){
+		try{
+			res.emplace_back(elem.first, kframe_.read(elem.first).first);
+		}
+		catch(const std::exception &e){
+			log_err("Could not read kFrames of route %d: %s\n", elem.first, e.what());
+		}
+	}
+
+	if(opened){
+		close();
+	}
+
+	return res;
+}
+
 void NSIDatabase::select_route(int route_id)
 {
 	{
@@ -954,6 +1125,29 @@ void NSIDatabase::select_route(const std::string &route_name)
 	select_route(route_id);
 }
 
+// Замена в тексте фразы шаблонов {route} (номер) и {route_name} (название маршрута)
+static void expand_media_text(std::string &text, const kRoute::route &route)
+{
+	if(text.empty()){
+		return;
+	}
+
+	auto replace_all = [&text](const std::string &from, const std::string &to){
+		for(size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size())){
+			text.replace(pos, from.size(), to);
+		}
+	};
+
+	// Номер маршрута дополняется литерой (в общем случае пробелом)
+	std::string number = route.number;
+	while( !number.empty() && (number.back() == ' ') ){
+		number.pop_back();
+	}
+
+	replace_all("{route}", number);
+	replace_all("{route_name}", route.name);
+}
+
 void NSIDatabase::reload_route_frames()
 {
 	int route_id = get_current_route();
@@ -967,15 +1161,116 @@ void NSIDatabase::reload_route_frames()
 		catch(const std::exception &e){
 			log_err("Could not read kFrames: %s\n", e.what());
 		}
+
+		try{
+			geometry_ = kgeometry_.read(route_id);
+		}
+		catch(const std::exception &e){
+			geometry_.clear();
+			log_err("Could not read kGeometry: %s\n", e.what());
+		}
+
+		if(hilbert_layout_){
+			reorder_frames_along_hilbert();
+		}
+
+		// Идентификаторы по возрастанию - в порядке загрузки
+		frame_slots_.clear();
+		frame_slots_.reserve(frames_.first.size());
+		for(size_t i = 0; i < frames_.first.size(); ++i){
+			frame_slots_.emplace_back(frames_.first[i].id, static_cast<uint32_t>(i));
+		}
+
+		std::sort(frame_slots_.begin(), frame_slots_.end());
+
+		// Индекс зон для оценки расстояния до ближайшего фрейма
+		// (индексы - в порядке расположения фреймов)
+		zone_grid_.clear();
+		route_triggers_.clear();
+		for(size_t i = 0; i < frames_.first.size(); ++i){
+			if(frames_.first[i].zone){
+				utils::Coord min, max;
+				frames_.first[i].zone->bounds(&min, &max);
+				zone_grid_.add(static_cast<uint32_t>(i), min, max, frames_.first[i].zone->course_bitmap());
+			}
+
+			if(frames_.first[i].route_offset_cm >= 0){
+				route_triggers_.emplace_back(frames_.first[i].route_offset_cm, static_cast<uint32_t>(i));
+			}
+		}
+
+		std::sort(route_triggers_.begin(), route_triggers_.end());
+		++frames_generation_;
+
+		// Подставляем данные маршрута в тексты фраз
+		auto rit = routes_.find(route_id);
+		if(rit != routes_.end()){
+			for(auto &frame : frames_.first){
+				expand_media_text(frame.minfo.text, rit->second);
+			}
+
+			for(auto &elem : frames_.second){
+				expand_media_text(elem.second.text, rit->second);
+			}
+		}
 	}
 }
 
+void NSIDatabase::reorder_frames_along_hilbert()
+{
+	auto &m_frames = frames_.first;
+
+	// Фреймы без зоны (срабатывающие по отметке вдоль маршрута) - в конце
+	std::vector<utils::Coord> centers;
+	std::vector<uint32_t> zoned;
+	std::vector<uint32_t> order;
+
+	for(size_t i = 0; i < m_frames.size(); ++i){
+		if( !m_frames[i].zone ){
+			continue;
+		}
+
+		utils::Coord min, max;
+		m_frames[i].zone->bounds(&min, &max);
+		centers.emplace_back(static_cast<int32_t>((static_cast<int64_t>(min.lat) + max.lat) / 2),
+			static_cast<int32_t>((static_cast<int64_t>(min.lon) + max.lon) / 2));
+		zoned.push_back(static_cast<uint32_t>(i));
+	}
+
+	for(uint32_t i : ZoneGrid::hilbert_order(centers)){
+		order.push_back(zoned[i]);
+	}
+
+	for(size_t i = 0; i < m_frames.size(); ++i){
+		if( !m_frames[i].zone ){
+			order.push_back(static_cast<uint32_t>(i));
+		}
+	}
+
+	kFrames::main_frames reordered;
+	reordered.reserve(m_frames.size());
+
+	for(uint32_t i : order){
+		reordered.push_back(std::move(m_frames[i]));
+	}
+
+	m_frames.swap(reordered);
+
+	log_msg(MSG_DEBUG, "%zu frames reordered along Hilbert curve\n", m_frames.size());
+}
+
 bool NSIDatabase::check_media_content_presence(const std::string &media_dir)
 {
 	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
 
+	// Фразы синтеза речи (text) готовятся кешем TTS и здесь не проверяются
+
 	// Check content for Main frames
 	for(const auto &frame : frames_.first){
+		if( !frame.minfo.text.empty() ){
+			continue;
+		}
+
 		if( !utils::file_exists(media_dir + "/" + frame.minfo.filename) ){
 			log_warn("main frame media '%s' not found\n", frame.minfo.filename);
 			return false;
@@ -984,6 +1279,10 @@ bool NSIDatabase::check_media_content_presence(const std::string &media_dir)
 
 	// Check content for Child frames
 	for(const auto &elem : frames_.second){
+		if( !elem.second.text.empty() ){
+			continue;
+		}
+
 		if( !utils::file_exists(media_dir + "/" + elem.second.filename) ){
 			log_warn("child frame media '%s' not found\n", elem.second.filename);
 			return false;
@@ -993,6 +1292,46 @@ bool NSIDatabase::check_media_content_presence(const std::string &media_dir)
 	return true;
 }
 
+void NSIDatabase::set_media_durations(const std::function<uint32_t(const std::string &filename)> &get_duration)
+{
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	for(auto &frame : frames_.first){
+		if(frame.minfo.text.empty()){
+			frame.minfo.duration_ms = get_duration(frame.minfo.filename);
+		}
+	}
+
+	for(auto &elem : frames_.second){
+		if(elem.second.text.empty()){
+			elem.second.duration_ms = get_duration(elem.second.filename);
+		}
+	}
+}
+
+std::vector<std::string> NSIDatabase::get_media_texts()
+{
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	std::vector<std::string> res;
+
+	auto add = [&res](const std::string &text){
+		if( !text.empty() && (std::find(res.begin(), res.end(), text) == res.end()) ){
+			res.push_back(text);
+		}
+	};
+
+	for(const auto &frame : frames_.first){
+		add(frame.minfo.text);
+	}
+
+	for(const auto &elem : frames_.second){
+		add(elem.second.text);
+	}
+
+	return res;
+}
+
 // bool NSIDatabase::ready()
 // {
 // 	if( (get_version() != "unknown") && !frames_.first.empty() ){
@@ -1067,10 +1406,14 @@ void NSIDatabase::show_frames()
 
 	log_msg(MSG_DEBUG, "|" + Logging::padding(total_col - 2, " Main Frames ", '*') + "|\n");
 	for(const auto &frame : frames_.first){
+		// Фрейм без зоны срабатывает по отметке вдоль маршрута
+		const std::string zone = frame.zone ? frame.zone->show() : 
+			"offset " + to_s(frame.route_offset_cm / 100) + " m";
+
 		log_msg(MSG_DEBUG, "|%s|%s|%s|%s|%s|%s|\n", 
-			Logging::padding(short_col, std::to_string(frame.id)), Logging::padding(big_col, frame.zone->show()), 
+			Logging::padding(short_col, std::to_string(frame.id)), Logging::padding(big_col, zone), 
 			Logging::padding(tiny_col, std::to_string(frame.minfo.play_mode)), Logging::padding(short_col, std::to_string(frame.minfo.id_next)), 
-			Logging::padding(norm_col, frame.minfo.filename), Logging::padding(tiny_col, std::to_string(frame.minfo.pause)) );
+			Logging::padding(norm_col, frame.minfo.text.empty() ? frame.minfo.filename : "TTS"), Logging::padding(tiny_col, std::to_string(frame.minfo.pause)) );
 	}
 
 	log_msg(MSG_DEBUG, "|" + Logging::padding(total_col - 2, " Child Frames ", '*') + "|\n");
@@ -1078,7 +1421,7 @@ void NSIDatabase::show_frames()
 		log_msg(MSG_DEBUG, "|%s|%s|%s|%s|%s|%s|\n", 
 			Logging::padding(short_col, std::to_string(frame.first)), Logging::padding(big_col, ""), 
 			Logging::padding(tiny_col, std::to_string(frame.second.play_mode)), Logging::padding(short_col, std::to_string(frame.second.id_next)), 
-			Logging::padding(norm_col, frame.second.filename), Logging::padding(tiny_col, std::to_string(frame.second.pause)) );
+			Logging::padding(norm_col, frame.second.text.empty() ? frame.second.filename : "TTS"), Logging::padding(tiny_col, std::to_string(frame.second.pause)) );
 	}
 
 	log_msg(MSG_DEBUG, Logging::padding(total_col, "", '-') + "\n");
@@ -1089,57 +1432,172 @@ std::string NSIDatabase::get_version()
 	return get_cfg_param<std::string>("dataVersion", "unknown");
 }
 
-//
-const kFrames::MediaInfo* NSIDatabase::find_media_info(
-	const std::pair<double, double> &lat_lon, double course, int *frame_id)
+std::vector<utils::Coord> NSIDatabase::get_route_geometry(bool frames_fallback)
+{
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	if( !geometry_.empty() || !frames_fallback ){
+		return geometry_;
+	}
+
+	std::vector<utils::Coord> res;
+	res.reserve(frames_.first.size());
+
+	// Порядок следования - по идентификаторам, а не по расположению в памяти
+	for(const auto &slot : frame_slots_){
+		const auto &frame = frames_.first[slot.second];
+
+		if( !frame.zone ){
+			continue;
+		}
+
+		utils::Coord min, max;
+		frame.zone->bounds(&min, &max);
+		res.emplace_back(static_cast<int32_t>((static_cast<int64_t>(min.lat) + max.lat) / 2),
+			static_cast<int32_t>((static_cast<int64_t>(min.lon) + max.lon) / 2));
+	}
+
+	return res;
+}
+
+uint32_t NSIDatabase::nearest_zone_distance_cm(const utils::Coord &point, uint32_t max_cm)
+{
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+	return zone_grid_.nearest_distance_cm(point, max_cm);
+}
+
+void NSIDatabase::FrameTracker::reset()
+{
+	active_.clear();
+	generation_ = 0;
+}
+
+const std::vector<NSIDatabase::FrameTracker::event>& NSIDatabase::FrameTracker::update(
+	const utils::Coord &point, double course, const utils::Coord *prev_point, bool route_progress)
 {
+	// Отрезок длиннее этого - скачок координат (перезапуск приемника, выход
+	// из зоны плохого приема), а не пройденный путь
+	const uint32_t max_jump_cm = 20000;
+
 	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
 
-	// Для отслеживания попадания в один и тот же фрейм используем 
-	// сохраненное значение предыдущего обработанного фрейма. Если мы
-	// все еще в той же зоне, что и прежде - выходим не проверяя оставшиеся
-	const size_t UNDEFINED = std::numeric_limits<size_t>::max();
-	static size_t prev_frame_idx = UNDEFINED;
+	events_.clear();
+
+	if(generation_ != frames_generation_){
+		active_.clear();
+		generation_ = frames_generation_;
+	}
 
 	const auto &m_frames = frames_.first;
 
-	// Проверить попадание в зону ранее обработанного фрейма (курс не учитывается)
-	if(prev_frame_idx != UNDEFINED){
+	auto add_event = [this, &m_frames](uint32_t idx, bool enter){
+		event ev;
+		ev.frame_id = m_frames[idx].id;
+		ev.minfo = &m_frames[idx].minfo;
+		ev.enter = enter;
+		events_.push_back(ev);
+	};
+
+	// Кандидаты - зоны ячеек индекса вокруг решения, а при проверке пути
+	// между решениями - вдоль пути
+	bool sweep = prev_point && (*prev_point != point);
+	utils::Coord min = point, max = point;
 
-		// Проверяем только координаты, без курса , чтобы не отслеживать 
-		// повороты и не срабатывать ложно повторно
-		if(m_frames[prev_frame_idx].zone && m_frames[prev_frame_idx].zone->contains(lat_lon, course)){
-			// Мы по прежнему в зоне, которая уже была обработана
-			return nullptr;
+	if(sweep){
+		const utils::LocalMetric metric(point.lat);
+		if(metric.distance_cm(*prev_point, point) > max_jump_cm){
+			log_msg(MSG_TRACE, "GPS jump over %u cm: swept zone check skipped\n", max_jump_cm);
+			sweep = false;
+		}
+		else{
+			min = utils::Coord(std::min(prev_point->lat, point.lat), std::min(prev_point->lon, point.lon));
+			max = utils::Coord(std::max(prev_point->lat, point.lat), std::max(prev_point->lon, point.lon));
 		}
 	}
 
-	// Проходимся по каждому фрейму в поисках вхождения переданых координат
-	// в одну из зон. Помечаем фрейм как обработанный, возвращаем медиа-инфо.
-	for(size_t i = 0; i < m_frames.size(); ++i){
-		const auto &frame = m_frames[i];
+	// Зоны другого направления отбрасываются в индексе по битовой карте
+	// секторов курса (вход и пересечение проверяются с курсом)
+	zone_grid_.query(min, max, &candidates_, (course >= 0.0) ? kFrames::Zone::course_to_bitmask(course) : 0);
 
-		if(frame.zone && frame.zone->contains(lat_lon, course)){
-			prev_frame_idx = i;
-			log_info("Entering zone id: %d (lat: %lf, lon: %lf, course: %.2lf)\n", frame.id, lat_lon.first, lat_lon.second, course);
-			if(frame_id){
-				*frame_id = frame.id;
-			}
-			return &frame.minfo;
+	// События - по порядку идентификаторов независимо от расположения фреймов в памяти
+	std::sort(candidates_.begin(), candidates_.end(), [&m_frames](uint32_t a, uint32_t b){ return m_frames[a].id < m_frames[b].id; });
+
+	// Активные фреймы: выход проверяется только по координатам, без курса -
+	// поворот внутри зоны не приводит к повторному срабатыванию
+	next_active_.clear();
+	for(uint32_t idx : active_){
+		if(m_frames[idx].zone->contains(point)){
+			next_active_.push_back(idx);
+			continue;
 		}
+
+		log_info("Exiting zone id: %d (lat: %s, lon: %s, course: %.2lf)\n", m_frames[idx].id, 
+			utils::microdegrees_to_string(point.lat), utils::microdegrees_to_string(point.lon), course);
+		add_event(idx, false);
 	}
 
-	// Нет попадания ни в одну из зон
-	if(prev_frame_idx != UNDEFINED){
-		log_info("Exiting zone id: %d (lat: %lf, lon: %lf, course: %.2lf)\n", m_frames[prev_frame_idx].id, lat_lon.first, lat_lon.second, course);
-		if(frame_id){
-			// Признак выхода из предыдущего фрейма
-			*frame_id = -1;
+	for(uint32_t idx : candidates_){
+		const auto &frame = m_frames[idx];
+
+		// Фреймы с отметкой вдоль маршрута проверяются find_route_triggers()
+		if(route_progress && (frame.route_offset_cm >= 0)){
+			continue;
+		}
+
+		if(std::binary_search(active_.begin(), active_.end(), idx)){
+			continue;
+		}
+
+		if(frame.zone->contains(point, course)){
+			log_info("Entering zone id: %d (lat: %s, lon: %s, course: %.2lf)\n", frame.id, 
+				utils::microdegrees_to_string(point.lat), utils::microdegrees_to_string(point.lon), course);
+			next_active_.push_back(idx);
+			add_event(idx, true);
+		}
+		else if(sweep && !frame.zone->contains(*prev_point) && frame.zone->intersects(*prev_point, point, course)){
+			// Зона пройдена целиком между решениями - точка уже вне ее
+			log_info("Passing zone id: %d (lat: %s, lon: %s, course: %.2lf)\n", frame.id, 
+				utils::microdegrees_to_string(point.lat), utils::microdegrees_to_string(point.lon), course);
+			add_event(idx, true);
+			add_event(idx, false);
 		}
 	}
 
-	prev_frame_idx = UNDEFINED;
-	return nullptr;
+	std::sort(next_active_.begin(), next_active_.end());
+	active_.swap(next_active_);
+
+	return events_;
+}
+
+void NSIDatabase::find_route_triggers(int32_t prev_pos_cm, int32_t pos_cm, std::vector<FrameTracker::event> *out)
+{
+	// Продвижение больше этого - скачок (повторный захват линии маршрута в другом
+	// месте), а не пройденный путь: отметки не срабатывают
+	const int32_t max_jump_cm = 20000;
+
+	out->clear();
+
+	if((pos_cm <= prev_pos_cm) || (pos_cm - prev_pos_cm > max_jump_cm)){
+		return;
+	}
+
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	// Первая отметка после prev_pos_cm и первая после pos_cm
+	const auto less = [](int32_t value, const std::pair<int32_t, uint32_t> &trigger){ return value < trigger.first; };
+	const auto first = std::upper_bound(route_triggers_.begin(), route_triggers_.end(), prev_pos_cm, less);
+	const auto last = std::upper_bound(first, route_triggers_.end(), pos_cm, less);
+
+	for(auto it = first; it != last; ++it){
+		const auto &frame = frames_.first[it->second];
+		log_info("Route offset frame id: %d at %.1lf m\n", frame.id, frame.route_offset_cm / 100.0);
+
+		FrameTracker::event ev;
+		ev.frame_id = frame.id;
+		ev.minfo = &frame.minfo;
+		ev.enter = true;
+		out->push_back(ev);
+	}
 }
 
 const kFrames::MediaInfo* NSIDatabase::get_media_info_of_child(int id)
@@ -1155,6 +1613,32 @@ const kFrames::MediaInfo* NSIDatabase::get_media_info_of_child(int id)
 	return &(it->second);
 }
 
+std::vector<kFrames::MediaInfo> NSIDatabase::get_parent_media_infos()
+{
+	std::lock_guard<std::recursive_mutex> lck(db_file_mutex_);
+
+	// Режимы INTERRUPTED_PARENT (3) и UNINTERRUPTED_PARENT (4)
+	auto is_parent = [](const kFrames::MediaInfo &minfo){
+		return (minfo.id_next > -1) && ((minfo.play_mode == 3) || (minfo.play_mode == 4));
+	};
+
+	std::vector<kFrames::MediaInfo> res;
+
+	for(const auto &frame : frames_.first){
+		if(is_parent(frame.minfo)){
+			res.push_back(frame.minfo);
+		}
+	}
+
+	for(const auto &elem : frames_.second){
+		if(is_parent(elem.second)){
+			res.push_back(elem.second);
+		}
+	}
+
+	return res;
+}
+
 
 } //namespace avi
 
@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include <cmath>
 #include <cstdint>
 #include <ctime>
 #include <string>
@@ -16,6 +17,9 @@
 #include <functional>
 #include <unordered_map>
 
+#include "utils/geo.hpp"
+#include "zone_index.hpp"
+
 extern "C"{
 #include <sqlite3.h>
 }
@@ -43,6 +47,9 @@ public:
 	// Очистка таблицы
 	virtual void clear();
 
+	// Проверка наличия столбца в таблице
+	bool column_exists(const std::string &col_name) const;
+
 	// Добавление столбца если не существует
 	bool add_column_if_not_exists(
 		const std::string &col_name, 
@@ -134,6 +141,39 @@ private:
 	files_versions dates_cache;
 };
 
+// Метаданные медиа-файла
+struct media_meta
+{
+	std::string md5;				// Хеш файла, для которого получены метаданные
+	uint32_t duration_ms = 0;		// Длительность воспроизведения
+	uint32_t bitrate = 0;			// Средний битрейт (кбит/с)
+	uint32_t sample_rate = 0;		// Частота дискретизации (Гц)
+};
+
+// Имя медиа-файла -> метаданные
+using media_metas = std::unordered_map<std::string, media_meta>;
+
+// Таблица метаданных медиа-файлов (заполняется однократно при скачивании файла)
+class MediaMetadata_table final: public Base_table
+{
+public:
+	MediaMetadata_table(const std::string &n = "MediaMetadata", sqlite3 **sq = nullptr): Base_table(n, sq) {}
+
+	void create() override;
+
+	void set(const std::string &file_name, const media_meta &meta);
+	void remove(const std::string &file_name);
+
+	// Возвращает false если для файла нет записи
+	bool get(const std::string &file_name, media_meta *meta);
+	media_metas get_all();
+
+private:
+	mutable std::recursive_mutex cache_mtx;
+	media_metas cache;
+	bool cache_loaded = false;
+};
+
 // Таблица информации об устройстве 
 class DeviceInfo_table final: public Base_table
 {
@@ -172,6 +212,7 @@ public:
 
 	FilesMetadata_table f_data;
 	DeviceInfo_table dev_info;
+	MediaMetadata_table media_data;
 
 private:
 	sqlite3 *fd = nullptr;
@@ -267,50 +308,61 @@ public:
 		// Абстрактная Зона действия фрейма
 		struct Zone
 		{
-			Zone(double lat_start, double lon_start, uint8_t course_bitmap): 
-				lat_start_(lat_start), lon_start_(lon_start), course_bitmap_(course_bitmap) {}
+			Zone(const utils::Coord &start, uint8_t course_bitmap): 
+				start_(start), course_bitmap_(course_bitmap) {}
 			virtual ~Zone() = default;
 
 			// Курс в градусах: [0 .. 360]
 			// Курс по-умолчанию не учитывается
-			virtual bool contains(const std::pair<double, double> &lat_lon, double course = -1.0) const = 0;
+			virtual bool contains(const utils::Coord &point, double course = -1.0) const = 0;
 			virtual std::string show() const = 0;
 
+			// Пересечение зоны отрезком пути между решениями from -> to.
+			// Курс проверяется так же, как в contains()
+			virtual bool intersects(const utils::Coord &from, const utils::Coord &to, double course = -1.0) const = 0;
+
+			// Ограничивающий прямоугольник зоны (юго-западный и северо-восточный углы)
+			virtual void bounds(utils::Coord *min, utils::Coord *max) const = 0;
+
 			// Преобразование курса в градусах в битовое представление
 			static uint8_t course_to_bitmask(double course_degrees) noexcept;
 			bool course_check(double course_degrees) const noexcept;
+			uint8_t course_bitmap() const noexcept { return course_bitmap_; }
 
 		protected:
-			double lat_start_ = 0.0;	// Широта начала (центра для зоны в виде окружности)	
-			double lon_start_ = 0.0;	// Долгота начала (центра для зоны в виде окружности)
+			utils::Coord start_;		// Начало (центр для зоны в виде окружности)
 			uint8_t course_bitmap_ = 0;	// Курс (целое число от 0 до 255, битовая карта сектора)
 		};
 
 		// Прямоугольная зона
 		struct RectangleZone: public Zone
 		{
-			RectangleZone(double lat_start, double lon_start, uint8_t course, double lat_end, double lon_end):
-				Zone(lat_start, lon_start, course), lat_end_(lat_end), lon_end_(lon_end) {}
+			RectangleZone(const utils::Coord &start, uint8_t course, const utils::Coord &end):
+				Zone(start, course), end_(end) {}
 
-			bool contains(const std::pair<double, double> &lat_lon, double course) const override;
+			bool contains(const utils::Coord &point, double course) const override;
 			std::string show() const override;
+			bool intersects(const utils::Coord &from, const utils::Coord &to, double course) const override;
+			void bounds(utils::Coord *min, utils::Coord *max) const override { *min = start_; *max = end_; }
 
 		protected:
-			double lat_end_ = 0.0; 	// Широта окончания (NULL для зоны в виде окружности)
-			double lon_end_ = 0.0;	// Долгота окончания (NULL для зоны в виде окружности)
+			utils::Coord end_;		// Окончание (правый верхний угол)
 		};
 
 		// Круглая зона
 		struct CircleZone: public Zone
 		{
-			CircleZone(double lat_start, double lon_start, uint8_t course, double radius):
-				Zone(lat_start, lon_start, course), radius_(radius) {}
+			CircleZone(const utils::Coord &center, uint8_t course, double radius_m):
+				Zone(center, course), radius_cm_(static_cast<uint32_t>(std::lround(radius_m * 100.0))), metric_(center.lat) {}
 
-			bool contains(const std::pair<double, double> &lat_lon, double course) const override;
+			bool contains(const utils::Coord &point, double course) const override;
 			std::string show() const override;
+			bool intersects(const utils::Coord &from, const utils::Coord &to, double course) const override;
+			void bounds(utils::Coord *min, utils::Coord *max) const override;
 
 		protected:
-			double radius_ = 0.0;	// Радиус зоны в виде окружности (метры)
+			uint32_t radius_cm_ = 0;	// Радиус зоны (сантиметры)
+			utils::LocalMetric metric_;	// Метрика в окрестности центра зоны
 		};
 
 		// Медиа информация
@@ -319,6 +371,8 @@ public:
 			std::string filename;	// Имя файла с mp3 для проигрования
 			int id_next = -1;		// Идентификатор следующего воспроизводимого фрейма
 			int pause = 0;			// Пауза перед воспроизведением (сек)
+			uint32_t duration_ms = 0;	// Длительность воспроизведения (0 - неизвестна)
+			std::string text;		// Текст фразы для синтеза речи (если задан - filename не используется)
 			// uint8_t is_child = 0;	// 0 не дочерний, 1 - дочерний
 			uint8_t play_mode = 0;	// Режим воспроизведения
 			// padd 
@@ -329,12 +383,14 @@ public:
 			int id = -1;			// Идентификатор фрейма
 			std::unique_ptr<Zone> zone;	// Указатель на конкретную зону (может быть nullptr)		 
 			MediaInfo minfo;
+			int32_t route_offset_cm = -1;	// Срабатывание по расстоянию вдоль маршрута (-1 - по зоне)
 		};
 
 		// Массив основных фреймов.
 		// Среди основных фреймов поиск идет по текущим координатам и вызывается часто -
 		// используем последовательный контейнер для увеличения частоты попаданий в кеш.
-		// Сортируется по возрастанию id.
+		// Сортируется по возрастанию id (при загрузке маршрута может быть переупорядочен,
+		// см. set_hilbert_layout()).
 		using main_frames = std::vector<Frame>;	
 
 		// Таблица дочерних фреймов (идентификатор -> медиа-данные).
@@ -349,6 +405,19 @@ public:
 
 	};
 
+	// Необязательная таблица геометрии маршрутов (линия маршрута в порядке движения):
+	// id_route, seq - порядковый номер точки, lat, lon
+	class kGeometry_table final: public Base_table
+	{
+	public:
+		kGeometry_table(const std::string &n = "kGeometry", sqlite3 **sq = nullptr): Base_table(n, sq) {}
+
+		void create() override {}
+
+		// Пустой результат - таблицы нет в НСИ или для маршрута нет точек
+		std::vector<utils::Coord> read(int route_id);
+	};
+
 	static void set_path(const std::string &path){ path_ = path; }
 
 	static bool open(int modes = DB_RO | DB_FMTX);
@@ -368,6 +437,11 @@ public:
 	static void show_frames();
 
 	static std::vector<std::string> get_available_route_names();
+	static std::string get_route_name(int route_id);
+
+	// Основные фреймы всех маршрутов НСИ (идентификатор маршрута -> фреймы),
+	// для определения маршрута по траектории. БД открывается при необходимости
+	static std::vector<std::pair<int, kFrames_table::main_frames>> read_all_route_frames();
 
 	static void select_route(int route_id);
 	static void select_route(const std::string &route_name);
@@ -386,8 +460,19 @@ public:
 	// при помощи select_route() идентификатором маршрута 
 	static void reload_route_frames();
 
+	// Расположение основных фреймов в памяти вдоль кривой Гильберта по центрам
+	// зон (вместо порядка идентификаторов) - близкие на местности зоны рядом
+	// в памяти. Применяется при следующей загрузке фреймов маршрута
+	static void set_hilbert_layout(bool enable){ hilbert_layout_ = enable; }
+
 	static bool check_media_content_presence(const std::string &media_dir);
 
+	// Заполняет длительности медиа-файлов фреймов текущего маршрута
+	static void set_media_durations(const std::function<uint32_t(const std::string &filename)> &get_duration);
+
+	// Уникальные тексты фраз синтеза речи фреймов текущего маршрута
+	static std::vector<std::string> get_media_texts();
+
 	template<typename T>
 	static T get_cfg_param(const std::string &param_name, T default_value)
 	{
@@ -408,9 +493,82 @@ public:
 
 	static std::string get_version();	
 
-	static const kFrames_table::MediaInfo* find_media_info(const std::pair<double, double> &lat_lon, double course, int *frame_id = nullptr); 
+	// Отслеживание нахождения в зонах основных фреймов текущего маршрута.
+	// Множество активных фреймов (в зонах которых находится решение) хранится
+	// в экземпляре - задачи и воспроизведение трека отслеживают положение
+	// независимо друг от друга. Перекрывающиеся зоны срабатывают каждая.
+	// После перезагрузки фреймов маршрута состояние сбрасывается
+	class FrameTracker
+	{
+	public:
+		struct event
+		{
+			int frame_id = -1;
+			const kFrames_table::MediaInfo *minfo = nullptr;
+			bool enter = false;		// true - вход в зону, false - выход из нее
+		};
+
+		void reset();
+
+		/**
+		  * @описание   Обновление множества активных фреймов по решению. Проверяются
+		  *             только активные фреймы и кандидаты из ячеек индекса зон вокруг
+		  *             решения (и пути от предыдущего решения)
+		  * @параметры
+		  *     Входные:
+		  *         point - решение
+		  *         course - курс решения (для входа в зону, выход - только по координатам)
+		  *         prev_point - предыдущее решение: зона, пройденная целиком между
+		  *                      решениями (малая зона, низкая частота GPS), дает вход
+		  *                      и выход. nullptr - путь не проверяется
+		  *         route_progress - положение вдоль маршрута известно: фреймы с отметкой
+		  *                      route_offset проверяются find_route_triggers(), а не по зоне
+		  * @возвращает события по порядку фреймов: выходы, затем входы (пройденная
+		  *             между решениями зона - вход и сразу выход). Действительны
+		  *             до следующего вызова
+		 */
+		const std::vector<event>& update(const utils::Coord &point, double course, const utils::Coord *prev_point = nullptr,
+			bool route_progress = false);
+
+		// Решение находится в зоне хотя бы одного фрейма
+		bool inside() const { return !active_.empty(); }
+
+	private:
+		uint64_t generation_ = 0;			// Поколение фреймов маршрута, к которому относятся индексы
+		std::vector<uint32_t> active_;		// Активные фреймы (индексы в frames_.first по возрастанию)
+		std::vector<uint32_t> candidates_;
+		std::vector<uint32_t> next_active_;
+		std::vector<event> events_;
+	};
 	static const kFrames_table::MediaInfo* get_media_info_of_child(int id);
 
+	// Линия текущего маршрута из таблицы kGeometry. При ее отсутствии и
+	// frames_fallback - по центрам зон основных фреймов в порядке идентификаторов
+	// (только для НСИ, где идентификаторы идут по порядку следования), иначе - пустая
+	static std::vector<utils::Coord> get_route_geometry(bool frames_fallback = false);
+
+	/**
+	  * @описание   Фреймы, срабатывающие по расстоянию вдоль маршрута (столбец route_offset)
+	  *             при продвижении от prev_pos_cm до pos_cm. Поиск двоичный по
+	  *             отсортированным отметкам. Срабатывают все пройденные отметки -
+	  *             так же, как зоны, пройденные между решениями
+	  * @параметры
+	  *     Входные:
+	  *         prev_pos_cm - предыдущее положение вдоль маршрута (см)
+	  *         pos_cm - текущее положение вдоль маршрута (см)
+	  *     Выходные:
+	  *         out - входы в фреймы по порядку отметок (вектор очищается)
+	 */
+	static void find_route_triggers(int32_t prev_pos_cm, int32_t pos_cm, std::vector<FrameTracker::event> *out);
+
+	// Расстояние (см) до ближайшей зоны фреймов текущего маршрута в радиусе max_cm
+	// (UINT32_MAX - зон в радиусе нет, 0 - точка в пределах зоны)
+	static uint32_t nearest_zone_distance_cm(const utils::Coord &point, uint32_t max_cm);
+
+	// Копии медиа-данных фреймов (основных и дочерних), после воспроизведения
+	// которых принудительно воспроизводится потомок id_next
+	static std::vector<kFrames_table::MediaInfo> get_parent_media_infos();
+
 private:
 	static std::recursive_mutex db_file_mutex_;
 
@@ -420,6 +578,7 @@ private:
 	static kRoute_table kroute_;
 	static kCfg_table kcfg_;
 	static kFrames_table kframe_;
+	static kGeometry_table kgeometry_;
 
 	static std::mutex curr_route_mutex_;
 	static int curr_route_id_;
@@ -430,6 +589,21 @@ private:
 	static kCfg_table::params cfg_params_;
 	// Текущие фреймы воспроизведения аудио оповещений
 	static std::pair<kFrames_table::main_frames, kFrames_table::child_frames> frames_;
+	// Пространственный индекс зон основных фреймов (индексы в frames_.first)
+	static ZoneGrid zone_grid_;
+	// Линия текущего маршрута из таблицы kGeometry (пусто - строится по фреймам)
+	static std::vector<utils::Coord> geometry_;
+	// Отметки срабатывания вдоль маршрута (см) -> индекс в frames_.first, по возрастанию отметок
+	static std::vector<std::pair<int32_t, uint32_t>> route_triggers_;
+	// Счетчик перезагрузок фреймов (индексы активных фреймов FrameTracker устаревают)
+	static uint64_t frames_generation_;
+	// Фреймы расположены вдоль кривой Гильберта
+	static bool hilbert_layout_;
+	// Идентификатор фрейма -> индекс в frames_.first, по возрастанию идентификаторов
+	static std::vector<std::pair<int, uint32_t>> frame_slots_;
+
+	// Перестановка frames_.first вдоль кривой Гильберта по центрам зон
+	static void reorder_frames_along_hilbert();
 };
 
 
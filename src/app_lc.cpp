@@ -8,6 +8,7 @@
 #include "utils/fs.hpp"
 #include "utils/crypto.hpp"
 #include "utils/datetime.hpp"
+#include "utils/mp3.hpp"
 #include "app_db.hpp"
 #include "app.hpp"
 #include "app_lc.hpp"
@@ -74,6 +75,10 @@ void LC_client_task::init()
 	// Заполнения локальных медиа листов
 	const_media_list.fill(app->dirs.media_dir, false);
 	tmp_media_list.fill(app->dirs.media_dir);
+
+	// Файлы могли быть скачаны предыдущей версией ПО (без метаданных)
+	this->update_media_metadata(const_media_list);
+	this->update_media_metadata(tmp_media_list);
 	
 	log_msg(MSG_VERBOSE /*| MSG_TO_FILE*/, "const_media_list (ver. %s):\n%s\n", const_media_list.version, const_media_list.data_to_str(29));
 	log_msg(MSG_VERBOSE /*| MSG_TO_FILE*/, "tmp_media_list (ver. %s):\n%s\n", tmp_media_list.version, tmp_media_list.data_to_str(29));
@@ -145,6 +150,48 @@ void LC_client_task::save_media(const std::string &dest_dir, const std::string &
 	utils::change_mod(file_path, 0666);
 
 	log_info("Media '%s' has been saved\n", file_path);
+
+	// Заголовки фреймов разбираем однократно - пока содержимое файла в памяти
+	try{
+		utils::MP3_info info = utils::mp3_buffer_info(content, size);
+
+		media_meta meta;
+		meta.md5 = utils::md5sum(reinterpret_cast<const char*>(content), size);
+		meta.duration_ms = info.duration_ms;
+		meta.bitrate = info.bitrate;
+		meta.sample_rate = info.sample_rate;
+
+		app->mdb.media_data.set(name, meta);
+		log_msg(MSG_DEBUG, "Media '%s' duration: %u ms (%u kbps, %u Hz)\n", name, meta.duration_ms, meta.bitrate, meta.sample_rate);
+	}
+	catch(const std::exception &e){
+		log_warn("Could not get metadata of media '%s': %s\n", name, e.what());
+	}
+}
+
+void LC_client_task::update_media_metadata(const Media_list &list) const
+{
+	for(const auto &elem : list.data){
+		media_meta meta;
+
+		if(app->mdb.media_data.get(elem.name, &meta) && (meta.md5 == elem.md5)){
+			continue;
+		}
+
+		try{
+			utils::MP3_info info = utils::mp3_file_info(app->dirs.media_dir + "/" + elem.name);
+
+			meta.md5 = elem.md5;
+			meta.duration_ms = info.duration_ms;
+			meta.bitrate = info.bitrate;
+			meta.sample_rate = info.sample_rate;
+
+			app->mdb.media_data.set(elem.name, meta);
+		}
+		catch(const std::exception &e){
+			log_warn("Could not get metadata of media '%s': %s\n", elem.name, e.what());
+		}
+	}
 }
 
 // Проверяет есть ли элемент elem с заданным именем и md5 хешем в указанном списке
@@ -200,6 +247,13 @@ void LC_client_task::clear_unused_media(const lc_media_list &local, const lc_med
 			std::string path = app->dirs.media_dir + "/" + elem.name;
 			log_info("Removing unused media (not in remote list) '%s'\n", elem.name);
 			remove(path.c_str());
+
+			try{
+				app->mdb.media_data.remove(elem.name);
+			}
+			catch(const std::exception &e){
+				log_warn("%s\n", e.what());
+			}
 		}
 	}
 }
@@ -398,7 +452,9 @@ void LC_client_task::download()
 void LC_client_task::send_device_status()
 {
 	// Заполнение структуры актуальными текущими значениями
-	this->avi_status.set_state( this->app->dev_state.get() );
+	// Воспроизведение - по событиям шины проигрывателя (см. Announcement_task)
+	const std::string playing = this->app->get_playing_media();
+	this->avi_status.set_state( this->app->dev_state.get() + (playing.empty() ? "" : ", воспроизведение: " + playing) );
 	this->avi_status.set_prev_push_info("1", "23");	// TODO
 
 	// 
@@ -407,7 +463,7 @@ void LC_client_task::send_device_status()
 	const auto pos = this->app->get_current_position();
 
 	if(pos.valid){
-		this->avi_status.set_latitude_longitude( std::to_string(pos.latitude), std::to_string(pos.longitude) );
+		this->avi_status.set_latitude_longitude( utils::microdegrees_to_string(pos.coord.lat), utils::microdegrees_to_string(pos.coord.lon) );
 	}
 	else{
 		this->avi_status.set_latitude_longitude("", "");
@@ -160,6 +160,9 @@ private:
 	void clear_unused_media(const lc_media_list &local, const lc_media_list &remote) const;
 	void get_media(bool tmp_media, const lc_media_list &list);
 	void save_media(const std::string &dest_dir, const std::string &name, const uint8_t *content, size_t size);
+
+	// Заполнение метаданных (длительности) для файлов медиа-листа, у которых их еще нет
+	void update_media_metadata(const Media_list &list) const;
 };
 
 } // namespace avi
@@ -84,6 +84,11 @@ public:
 	 	return period_sec;
 	}
 
+	std::chrono::milliseconds get_period() const { 
+		std::lock_guard<std::mutex> lck(this->period_mtx);
+		return this->period_ms;
+	}
+
 	std::string get_name() const noexcept {
 		return this->task_name;
 	}
@@ -1,6 +1,7 @@
 
 #include <stdexcept>
 #include <cstring>
+#include <array>
 #include <vector>
 #include <sstream>
 
@@ -198,40 +199,24 @@ std::string GPSinfo::as_string(bool verbose) const
 	return out.str();
 }
 
-double GPSinfo::NMEA_to_dec_degrees(const std::string &nmea, const std::string &quadrant) const
+int32_t GPSinfo::NMEA_to_microdegrees(const std::string &nmea, const std::string &quadrant) const
 {
-	double dec_res = 0.0;
+	int32_t res = 0;
 
 	if( !valid_ ){
-		return dec_res;
+		return res;
 	}
 
-	try{
-		size_t int_len = (nmea.at(4) == '.') ? 2 : 3;
-
-		std::string int_part = nmea.substr(0, int_len);
-		std::string min_part = nmea.substr(int_len);
-
-		dec_res = std::stod(int_part) + std::stod(min_part) / 60.;
-		if(quadrant == "S" || quadrant == "W"){
-			dec_res *= -1;
-		}
-
-		return dec_res;
-	}
-	catch(const std::exception &e){
-		throw std::runtime_error("GPSinfo::NMEA_to_dec_degrees(" + nmea + ":" + quadrant + ") failed: " + e.what());
+	if( quadrant.empty() || !utils::nmea_to_microdegrees(nmea.data(), nmea.size(), quadrant[0], &res) ){
+		throw std::runtime_error("GPSinfo::NMEA_to_microdegrees(" + nmea + ":" + quadrant + ") failed");
 	}
+
+	return res;
 }
 
-std::pair<double, double> GPSinfo::get_decimal_coordinates() const 
+utils::Coord GPSinfo::get_coord() const 
 {
-	std::pair<double, double> lat_lon;
-
-	lat_lon.first = NMEA_to_dec_degrees(latitude_, north_south_);
-	lat_lon.second = NMEA_to_dec_degrees(longitude_, east_west_);
-
-	return lat_lon;
+	return utils::Coord(NMEA_to_microdegrees(latitude_, north_south_), NMEA_to_microdegrees(longitude_, east_west_));
 }
 
 
@@ -312,9 +297,8 @@ int main(int argc, char* argv[])
 			auto info = AT_port::get_GPSinfo();
 			std::cout << info.as_string(true) << std::endl;
 
-			auto coord = info.get_decimal_coordinates();
-			std::cout.precision(6);
-			std::cout << "decimal: " << std::fixed << coord.first << " " << coord.second << std::endl;
+			auto coord = info.get_coord();
+			std::cout << "decimal: " << utils::microdegrees_to_string(coord.lat) << " " << utils::microdegrees_to_string(coord.lon) << std::endl;
 		}
 		else{
 			std::string answer = AT_port::send("AT" + cmd, "", 3000);
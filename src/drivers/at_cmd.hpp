@@ -12,6 +12,8 @@
 #include <mutex>
 #include <atomic>
 
+#include "utils/geo.hpp"
+
 namespace hw{
 
 struct GPSinfo
@@ -29,8 +31,8 @@ struct GPSinfo
 		return { {latitude_, north_south_}, {longitude_, east_west_} };
 	}
 
-	// Convertion to degrees with minutes <latitude, longitude>
-	std::pair<double, double> get_decimal_coordinates() const;
+	// Convertion to microdegrees
+	utils::Coord get_coord() const;
 
 	std::string get_date() const { return date_; }
 	std::string get_utc_time() const { return utc_time_; }
@@ -53,7 +55,7 @@ private:
 	double course_ = -1; 		// Course. Degrees. 0 - to North, 90 - East, 180 - South, 270 - West.
 	bool valid_ = false;		// Data validness
 
-	double NMEA_to_dec_degrees(const std::string &nmea, const std::string &quadrant) const;
+	int32_t NMEA_to_microdegrees(const std::string &nmea, const std::string &quadrant) const;
 };
 
 
@@ -4,7 +4,9 @@
 #include <memory>
 #include <cstring>
 #include <cerrno>
+#include <algorithm>
 #include <cstdio>
+#include <vector>
 
 extern "C"{
 #include <unistd.h>
@@ -100,6 +102,66 @@ void i2c_write(uint8_t slave_address, uint16_t reg, const uint8_t *buf, uint16_t
 	}
 }
 
+/**
+  * @описание   Пакетная запись нескольких регистров одной транзакцией I2C_RDWR
+  * @параметры
+  *     Входные:
+  *         slave_address - адрес подчиненного устройства
+  *         writes - массив записей
+  *         count - количество записей
+  * @исключения: std::runtime_error
+ */
+void i2c_write_batch(uint8_t slave_address, const i2c_reg_write *writes, size_t count)
+{
+	if(writes == nullptr || count == 0){
+		return;
+	}
+
+	size_t data_len = 0;
+	for(size_t i = 0; i < count; ++i){
+		data_len += ((writes[i].reg > 0xFF) ? 2 : 1) + writes[i].len;
+	}
+
+	// Данные всех сообщений размещаются в одном буфере
+	std::vector<uint8_t> data(data_len);
+	std::vector<struct i2c_msg> msgs(count);
+	size_t offset = 0;
+	errno = 0;
+
+	for(size_t i = 0; i < count; ++i){
+		uint8_t *p = data.data() + offset;
+		uint16_t reg_len = (writes[i].reg > 0xFF) ? 2 : 1;
+
+		if(reg_len == 2){
+			p[0] = writes[i].reg >> 8;
+			p[1] = writes[i].reg & 0xFF;
+		}
+		else{
+			p[0] = writes[i].reg;
+		}
+
+		if(writes[i].len){
+			memcpy(p + reg_len, writes[i].buf, writes[i].len);
+		}
+
+		msgs[i].addr = slave_address >> 1;
+		msgs[i].flags = 0;
+		msgs[i].buf = p;
+		msgs[i].len = reg_len + writes[i].len;
+
+		offset += msgs[i].len;
+	}
+
+	// Драйвер ядра ограничивает количество сообщений в одном вызове
+	for(size_t pos = 0; pos < count; pos += I2C_RDWR_IOCTL_MAX_MSGS){
+		size_t n = std::min<size_t>(count - pos, I2C_RDWR_IOCTL_MAX_MSGS);
+
+		if( !i2c_rdwr(msgs.data() + pos, n) ) {
+			throw std::runtime_error(std::string("i2c_write_batch error (addr: " + std::to_string(slave_address) + ") - ") + strerror(errno)); 
+		}
+	}
+}
+
 // Поддержка SMBus передачи
 void i2c_write_byte(uint8_t slave_address, uint8_t byte)
 {
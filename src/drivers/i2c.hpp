@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <cstddef>
 #include <string>
 
 namespace hw{
@@ -20,6 +21,27 @@ void i2c_init(const std::string &dev);
  */
 void i2c_write(uint8_t slave_address, uint16_t reg, const uint8_t *buf, uint16_t len);
 
+// Запись в регистр подчиненного устройства (элемент пакетной передачи)
+struct i2c_reg_write
+{
+	uint16_t reg;			// адрес регистра
+	const uint8_t *buf;		// данные
+	uint16_t len;			// размер данных
+};
+
+/**
+  * @описание	Пакетная запись нескольких регистров одной транзакцией I2C_RDWR
+  *				(сообщения разделяются повторным стартом, шина не освобождается).
+  *				Пакеты больше I2C_RDWR_IOCTL_MAX_MSGS сообщений передаются частями
+  * @параметры
+  *     Входные:
+  * 		slave_address - адрес подчиненного устройства
+  * 		writes - массив записей
+  *			count - количество записей
+  * @исключения: std::runtime_error
+ */
+void i2c_write_batch(uint8_t slave_address, const i2c_reg_write *writes, size_t count);
+
 // Поддержка SMBus передачи
 void i2c_write_byte(uint8_t slave_address, uint8_t byte);
 
@@ -16,6 +16,43 @@ void NAU8810::init(const std::string &i2c_dev)
     i2c_init(i2c_dev);
 }
 
+// Значения регистров после сброса (по документации NAU8810). Используются только
+// регистры, с которыми работает драйвер - остальные читаются при первом обращении
+static const struct{
+    uint8_t reg;
+    uint16_t value;
+} reset_defaults[] = {
+    {POWER_MANAGMENT_1,     0x0000},
+    {POWER_MANAGMENT_2,     0x0000},
+    {POWER_MANAGMENT_3,     0x0000},
+    {DAC_CTRL,              0x0000},
+    {DAC_VOLUME,            0x00FF},
+    {ADC_CTRL,              0x0100},
+    {ADC_VOLUME,            0x00FF},
+    {DAC_LIMITER_1,         0x0032},
+    {DAC_LIMITER_2,         0x0000},
+    {ATTENUATION_CTRL,      0x0000},
+    {INPUT_CTRL,            0x0003},
+    {PGA_GAIN,              0x0010},
+    {ADC_BOOST,             0x0100},
+    {OUTPUT_CTRL,           0x0002},
+    {MIXER_CTRL,            0x0001},
+    {SPKOUT_VOLUME,         0x0039},
+    {MONO_MIXER_CONTROL,    0x0001},
+};
+
+// Первый байт посылки записи: 7 бит адреса регистра и 9-й бит данных
+static uint8_t nau_reg_byte(uint8_t reg, uint16_t value)
+{
+    uint16_t nau_reg = 0;
+
+    nau_reg = (value & 0x0100);         // get 9th data bit
+    nau_reg |= (uint16_t)(reg << 9);    // add reg address   
+    nau_reg >>= 8;                      // make reg size as 1 byte
+
+    return (uint8_t)nau_reg;
+}
+
 uint16_t NAU8810::read_reg(uint16_t reg)
 {
     // The 7-MSB bits “0011010” are the device address
@@ -23,48 +60,122 @@ uint16_t NAU8810::read_reg(uint16_t reg)
     uint8_t buf[2]; // NAU response with 2 data bytes 
     memset(buf, 0, sizeof buf);
 
-    reg <<= 1;      // NAU protocol requeres shifted reg-addr
+    i2c_read(CHIP_ADDR, reg << 1, buf, sizeof buf);     // NAU protocol requeres shifted reg-addr
 
-    i2c_read(CHIP_ADDR, reg, buf, sizeof buf);
-
-    // log_dbg("(0x%02X) '%s': 0x%02X%02X\n", reg >> 1, reg_name, buf[0], buf[1]);
+    // log_dbg("(0x%02X) '%s': 0x%02X%02X\n", reg, reg_name, buf[0], buf[1]);
 
     uint16_t res = buf[1];
     res |= buf[0] << 8;
 
+    // Непереданные изменения не затираем прочитанным значением
+    if(reg < NAU8810_REG_COUNT && !dirty_[reg]){
+        shadow_[reg] = res;
+        valid_.set(reg);
+    }
+
     return res;
 }
 
-void NAU8810::write_reg(uint8_t reg, uint16_t value)
+uint16_t NAU8810::cached_reg(uint8_t reg)
 {
-    // first 7 bit is reg addr, rest 9 - is data
-    uint16_t nau_reg = 0;
-    uint8_t data = 0;
+    if( !valid_[reg] ){
+        read_reg(reg);
+    }
 
-    nau_reg = (value & 0x0100);         // get 9th data bit
-    nau_reg |= (uint16_t)(reg << 9);    // add reg address   
-    nau_reg >>= 8;                      // make reg size as 1 byte
+    return shadow_[reg];
+}
 
-    data = (uint8_t)(value & 0xFF);
+void NAU8810::load_defaults()
+{
+    valid_.reset();
+
+    for(const auto &def : reset_defaults){
+        shadow_[def.reg] = def.value;
+        valid_.set(def.reg);
+    }
+}
+
+void NAU8810::write_reg(uint8_t reg, uint16_t value)
+{
+    // first 7 bit is reg addr, rest 9 - is data
+    value &= 0x01FF;
 
-    // log_msg(MSG_VERBOSE, "nau write addr: 0x%02X, data: 0x%02X\n", nau_reg, data);
+    if( !valid_[reg] || (shadow_[reg] != value) ){
+        shadow_[reg] = value;
+        valid_.set(reg);
+        dirty_.set(reg);
+    }
 
-    i2c_write(CHIP_ADDR, nau_reg, &data, 1);
+    if( !batch_depth_ ){
+        commit();
+    }
 }
 
 void NAU8810::edit_bit(uint8_t reg, uint16_t bitmask, bool set)
 {
-    uint16_t tmp = read_reg(reg);
+    uint16_t tmp = cached_reg(reg);
     uint16_t val = set ? (tmp | bitmask) : (tmp & (~bitmask));  // set or unset bit
 
     write_reg(reg, val);
 }
 
+void NAU8810::end_batch()
+{
+    abort_batch();
+
+    if( !batch_depth_ ){
+        commit();
+    }
+}
+
+void NAU8810::commit()
+{
+    if(dirty_.none()){
+        return;
+    }
+
+    i2c_reg_write writes[NAU8810_REG_COUNT];
+    uint8_t data[NAU8810_REG_COUNT];
+    size_t count = 0;
+
+    for(uint8_t reg = 0; reg < NAU8810_REG_COUNT; ++reg){
+        if( !dirty_[reg] ){
+            continue;
+        }
+
+        data[count] = (uint8_t)(shadow_[reg] & 0xFF);
+
+        writes[count].reg = nau_reg_byte(reg, shadow_[reg]);
+        writes[count].buf = &data[count];
+        writes[count].len = 1;
+        ++count;
+    }
+
+    // log_msg(MSG_VERBOSE, "nau commit %zu regs\n", count);
+
+    try{
+        i2c_write_batch(CHIP_ADDR, writes, count);
+    }
+    catch(...){
+        // Неизвестно, какие из регистров были записаны - перечитаем их при следующем изменении
+        valid_ &= ~dirty_;
+        dirty_.reset();
+        throw;
+    }
+
+    dirty_.reset();
+}
+
 void NAU8810::soft_reset()
 {
     // Performing a write instruction to this register with any data
     // will reset all the bits in the register map to default
-    write_reg(SOFTWARE_RESET, 0x0000);
+    uint8_t data = 0;
+    i2c_write(CHIP_ADDR, nau_reg_byte(SOFTWARE_RESET, 0x0000), &data, 1);
+
+    // Непереданные изменения теряют смысл после сброса
+    dirty_.reset();
+    load_defaults();
 }
 
 
@@ -138,7 +249,7 @@ void NAU8810::DAC_de_emphasis(uint8_t rate)
 // -6 .. -1 dB
 void NAU8810::DAC_set_limiter_threshold(int8_t thr)
 {
-    uint16_t tmp = read_reg(DAC_LIMITER_2);
+    uint16_t tmp = cached_reg(DAC_LIMITER_2);
     tmp &= 0x018F;   // reset current threshold
 
     switch(thr){
@@ -179,7 +290,7 @@ void NAU8810::DAC_set_limiter_boost(uint16_t val)
     // Only 4 bits available and 0..12 values
     if(val > 12) val = 12;
 
-    uint16_t tmp = read_reg(DAC_LIMITER_2);
+    uint16_t tmp = cached_reg(DAC_LIMITER_2);
     tmp &= 0x01F0; // reset current boost value 
     uint16_t new_val = tmp | val; 
 
@@ -189,8 +300,8 @@ void NAU8810::DAC_set_limiter_boost(uint16_t val)
 
 void NAU8810::DAC_enable_limiter(bool on_off)
 {
-    write_reg(DAC_LIMITER_1, 0x0000); // fastest Attack and Decay
-    edit_bit(DAC_LIMITER_1, DACLIMEN, on_off);
+    // fastest Attack and Decay
+    write_reg(DAC_LIMITER_1, on_off ? DACLIMEN : 0x0000);
 }
 
 // True - enable 128x (best SNR), Flas - 64x (Lowest power)
@@ -236,16 +347,23 @@ void NAU8810::MOUT_attenuate(bool on_off)
 // True - MIC power on, False - MIC power off
 void NAU8810::MIC_bias(bool on_off)
 {
+    Batch batch(*this);
+
     if(on_off){
         // Set MICBIAS Voltage to 0.5 VDDA, and enable NMICPGA, PMICPGA
         write_reg(INPUT_CTRL, MICBIASV8 | MICBIASV7 | NMICPGA | PMICPGA);
     }
     
-     edit_bit(POWER_MANAGMENT_1, DCBUFEN | MICBIASEN | REFIMP0 | ABIASEN, on_off);
+    edit_bit(POWER_MANAGMENT_1, DCBUFEN | MICBIASEN | REFIMP0 | ABIASEN, on_off);
+
+    batch.commit();
 }
 
+// Все регистры передаются одной транзакцией
 void NAU8810::MIC_sidetone()
 {
+    Batch batch(*this);
+
     // Enable BYPMOUT[1] and DACMOUT[0] in Mono Mixer Comtrol
     write_reg(MONO_MIXER_CONTROL, BYPMOUT | DACMOUT);
 
@@ -271,6 +389,8 @@ void NAU8810::MIC_sidetone()
 
     // DACEN, MOUTMXEN, MOUTEN
     write_reg(POWER_MANAGMENT_3, 0x0089);
+
+    batch.commit();
 }     
 
 } // namespace hw
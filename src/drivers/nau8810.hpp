@@ -2,6 +2,8 @@
 #define _NAU8810_HPP
 
 #include <cstdint>
+#include <string>
+#include <bitset>
 
 #define CHIP_ADDR    0x34
 
@@ -123,21 +125,59 @@
 
 // Register ID
 
+// Количество адресов в карте регистров (7 бит адреса, используются 0x00..0x4F)
+#define NAU8810_REG_COUNT	0x50
+
 // -----------------------------
 
 namespace hw{
 
+// Драйвер хранит теневую копию карты регистров: изменение отдельных бит не
+// требует чтения регистра по шине, а запись выполняется только для регистров,
+// значение которых действительно изменилось. Изменения, сделанные внутри
+// пакета (Batch), передаются одной транзакцией I2C_RDWR при его завершении.
 class NAU8810
 {
 public:
+	// Группировка изменений регистров в одну транзакцию I2C.
+	// Без вызова commit() изменения остаются в теневой копии и будут переданы
+	// при следующей записи
+	class Batch
+	{
+	public:
+		Batch(NAU8810 &chip): chip_(chip) { chip_.begin_batch(); }
+		~Batch() { if(active_) chip_.abort_batch(); }
+
+		Batch(const Batch&) = delete;
+		Batch& operator=(const Batch&) = delete;
+
+		void commit() { active_ = false; chip_.end_batch(); }
+
+	private:
+		NAU8810 &chip_;
+		bool active_ = true;
+	};
+
 	NAU8810(const std::string &i2c_dev = "/dev/i2c-5") { init(i2c_dev); }
 
 	void init(const std::string &i2c_dev = "/dev/i2c-5");
 
+	// Чтение регистра с устройства (теневая копия обновляется, если в ней
+	// нет непереданных изменений этого регистра)
 	uint16_t read_reg(uint16_t reg);
 
 	void soft_reset();
 
+	// Начало пакета изменений (допускается вложенность)
+	void begin_batch() { ++batch_depth_; }
+
+	// Завершение пакета. При выходе из внешнего пакета измененные регистры
+	// передаются одной транзакцией
+	void end_batch();
+
+	// Передать все измененные регистры
+	void commit();
+
 	void PGA_mute(bool on_off = true);
 	void PGA_boost(bool on_off = true);
 	void PGA_set_gain(uint8_t gain);
@@ -161,6 +201,18 @@ public:
 	void MOUT_add_resistance(bool on_off = true);
 
 private:
+	using reg_set = std::bitset<NAU8810_REG_COUNT>;
+
+	uint16_t shadow_[NAU8810_REG_COUNT] = {};	// Теневая копия регистров
+	reg_set valid_;								// Значение в теневой копии известно
+	reg_set dirty_;								// Значение изменено, но не передано
+	unsigned batch_depth_ = 0;
+
+	void abort_batch() { if(batch_depth_) --batch_depth_; }
+
+	uint16_t cached_reg(uint8_t reg);
+	void load_defaults();
+
 	void write_reg(uint8_t reg, uint16_t value);
 	void edit_bit(uint8_t reg, uint16_t bitmask, bool set);
 };
@@ -0,0 +1,109 @@
+#include <cstring>
+#include <chrono>
+#include <stdexcept>
+
+#include "nmea_port.hpp"
+
+namespace hw{
+
+void NMEA_port::start(sentence_callback cb)
+{
+	if(thread_.joinable()){
+		return;
+	}
+
+	// Ошибка открытия порта при старте - исключение вызывающему
+	uart_.init();
+
+	exit_ = false;
+	thread_ = std::thread(&NMEA_port::reader, this, cb);
+}
+
+void NMEA_port::stop()
+{
+	exit_ = true;
+
+	if(thread_.joinable()){
+		thread_.join();
+	}
+
+	uart_.deinit();
+}
+
+std::string NMEA_port::last_error()
+{
+	std::lock_guard<std::mutex> lock(error_mutex_);
+	std::string res;
+	std::swap(res, last_error_);
+	return res;
+}
+
+void NMEA_port::set_error(const std::string &err)
+{
+	std::lock_guard<std::mutex> lock(error_mutex_);
+	last_error_ = err;
+}
+
+void NMEA_port::reader(sentence_callback cb)
+{
+	uint8_t buf[256];
+	char line[max_sentence_len + 1];
+	size_t line_len = 0;
+	bool overflow = false;
+
+	while( !exit_ ){
+		size_t count = 0;
+
+		try{
+			// Чтение завершается по таймауту порта (1 сек) - флаг выхода проверяется регулярно
+			count = uart_.read(buf, sizeof(buf));
+		}
+		catch(const std::exception &e){
+			set_error(e.what());
+
+			// USB порт модуля мог пропасть - переоткрываем
+			std::this_thread::sleep_for(std::chrono::seconds(1));
+
+			try{
+				uart_.deinit();
+				uart_.init();
+			}
+			catch(const std::exception &e){
+				set_error(std::string("reopen '") + port_name_ + "' failed: " + e.what());
+			}
+
+			line_len = 0;
+			continue;
+		}
+
+		for(size_t i = 0; i < count; ++i){
+			const char ch = static_cast<char>(buf[i]);
+
+			// Начало нового предложения - отбрасываем незавершенный остаток
+			if(ch == '$'){
+				line_len = 0;
+				overflow = false;
+			}
+
+			if((ch == '\r') || (ch == '\n')){
+				if(line_len && !overflow && (line[0] == '$') && cb){
+					line[line_len] = '\0';
+					cb(line, line_len);
+				}
+
+				line_len = 0;
+				overflow = false;
+				continue;
+			}
+
+			if(line_len < max_sentence_len){
+				line[line_len++] = ch;
+			}
+			else{
+				overflow = true;
+			}
+		}
+	}
+}
+
+} // namespace hw
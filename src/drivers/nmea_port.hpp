@@ -0,0 +1,61 @@
+/*==============================================================================
+Описание: 	Модуль чтения потока NMEA предложений из порта GPS приемника
+			(NMEA порт SIMCOM). Предложения передаются в колбек по мере
+			поступления из отдельного потока - без опроса AT+CGPSINFO.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include "uart.hpp"
+
+namespace hw{
+
+class NMEA_port
+{
+public:
+	// Колбек получения предложения (без завершающих "\r\n", строка завершена нулем)
+	using sentence_callback = std::function<void(const char *sentence, size_t len)>;
+
+	// Максимальная длина предложения (по стандарту - 82 символа)
+	static const size_t max_sentence_len = 128;
+
+	NMEA_port(const std::string &port_name): port_name_(port_name), uart_(port_name) {}
+	~NMEA_port() { this->stop(); }
+
+	NMEA_port(const NMEA_port&) = delete;
+	NMEA_port& operator=(const NMEA_port&) = delete;
+
+	// Открыть порт и запустить поток чтения
+	void start(sentence_callback cb);
+	void stop();
+
+	bool is_running() const { return thread_.joinable(); }
+
+	// Описание последней ошибки потока чтения (очищается при чтении)
+	std::string last_error();
+
+private:
+	std::string port_name_;
+	UART uart_;
+
+	std::atomic<bool> exit_{false};
+	std::thread thread_;
+
+	std::mutex error_mutex_;
+	std::string last_error_;
+
+	void reader(sentence_callback cb);
+	void set_error(const std::string &err);
+};
+
+} // namespace hw
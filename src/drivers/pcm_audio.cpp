@@ -0,0 +1,693 @@
+#include <cstring>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+
+#ifndef _HOST_BUILD
+extern "C" {
+#include <alsa/asoundlib.h>
+}
+#endif
+
+#define MINIMP3_IMPLEMENTATION
+#include "minimp3.h"
+
+#include "pcm_audio.hpp"
+
+namespace hw{
+
+static std::vector<uint8_t> read_file(const std::string &path)
+{
+	std::unique_ptr<FILE, int(*)(FILE*)> file{fopen(path.c_str(), "rb"), fclose};
+
+	if( !file ){
+		throw std::runtime_error("could not open '" + path + "': " + strerror(errno));
+	}
+
+	fseek(file.get(), 0, SEEK_END);
+	long size = ftell(file.get());
+	fseek(file.get(), 0, SEEK_SET);
+
+	if(size < 0){
+		throw std::runtime_error("could not get size of '" + path + "'");
+	}
+
+	std::vector<uint8_t> res(static_cast<size_t>(size));
+
+	if(fread(res.data(), 1, res.size(), file.get()) != res.size()){
+		throw std::runtime_error("could not read '" + path + "'");
+	}
+
+	return res;
+}
+
+// Линейная передискретизация (моно) с фиксированной точкой 16.16.
+// Состояние сохраняется между вызовами - на стыке файлов нет разрыва
+class Resampler
+{
+public:
+	void set_rates(unsigned in_rate, unsigned out_rate)
+	{
+		if((in_rate == in_rate_) && (out_rate == out_rate_)){
+			return;
+		}
+
+		in_rate_ = in_rate;
+		out_rate_ = out_rate;
+		step_ = static_cast<uint32_t>((static_cast<uint64_t>(in_rate) << 16) / out_rate);
+		pos_ = 0;
+	}
+
+	void process(const int16_t *in, size_t n, std::vector<int16_t> &out)
+	{
+		if(in_rate_ == out_rate_){
+			out.insert(out.end(), in, in + n);
+			if(n){
+				prev_ = in[n - 1];
+			}
+			return;
+		}
+
+		for(size_t i = 0; i < n; ++i){
+			const int64_t delta = static_cast<int64_t>(in[i]) - prev_;
+
+			while(pos_ < 0x10000){
+				out.push_back(static_cast<int16_t>(prev_ + ((delta * pos_) >> 16)));
+				pos_ += step_;
+			}
+
+			pos_ -= 0x10000;
+			prev_ = in[i];
+		}
+	}
+
+private:
+	unsigned in_rate_ = 0;
+	unsigned out_rate_ = 0;
+	uint32_t step_ = 0x10000;
+	uint32_t pos_ = 0;
+	int16_t prev_ = 0;
+};
+
+// Потоковый декодер MP3 -> моно PCM с частотой дискретизации выхода
+class PCM_Audio::Decoder
+{
+public:
+	Decoder(unsigned out_rate): out_rate_(out_rate) {}
+
+	void open(const std::string &path)
+	{
+		data_ = read_file(path);
+		offset_ = 0;
+		pending_.clear();
+		pending_pos_ = 0;
+		mp3dec_init(&mp3d_);
+	}
+
+	// Возвращает 0 по окончании файла
+	size_t read(int16_t *out, size_t frames)
+	{
+		size_t done = 0;
+
+		while(done < frames){
+			if(pending_pos_ >= pending_.size()){
+				if( !this->decode_next() ){
+					break;
+				}
+			}
+
+			const size_t n = std::min(frames - done, pending_.size() - pending_pos_);
+			memcpy(out + done, pending_.data() + pending_pos_, n * sizeof(int16_t));
+			pending_pos_ += n;
+			done += n;
+		}
+
+		return done;
+	}
+
+private:
+	const unsigned out_rate_ = 0;
+	std::vector<uint8_t> data_;
+	size_t offset_ = 0;
+	mp3dec_t mp3d_;
+	Resampler resampler_;
+
+	// Декодированные и передискретизированные отсчеты текущего фрейма
+	std::vector<int16_t> pending_;
+	size_t pending_pos_ = 0;
+
+	bool decode_next()
+	{
+		int16_t pcm[MINIMP3_MAX_SAMPLES_PER_FRAME];
+
+		while(offset_ < data_.size()){
+			mp3dec_frame_info_t info;
+			int samples = mp3dec_decode_frame(&mp3d_, data_.data() + offset_, data_.size() - offset_, pcm, &info);
+
+			if( !info.frame_bytes ){
+				// Больше нет корректных фреймов
+				offset_ = data_.size();
+				return false;
+			}
+
+			offset_ += info.frame_bytes;
+
+			// Пропущенные данные (ID3 теги, мусор) или фрейм без звука
+			if(samples <= 0){
+				continue;
+			}
+
+			// Смешиваем каналы - на плате моно кодек
+			if(info.channels == 2){
+				for(int i = 0; i < samples; ++i){
+					pcm[i] = static_cast<int16_t>((static_cast<int32_t>(pcm[2 * i]) + pcm[2 * i + 1]) / 2);
+				}
+			}
+
+			pending_.clear();
+			pending_pos_ = 0;
+			resampler_.set_rates(info.hz, out_rate_);
+			resampler_.process(pcm, samples, pending_);
+
+			if( !pending_.empty() ){
+				return true;
+			}
+		}
+
+		return false;
+	}
+};
+
+
+#ifndef _HOST_BUILD
+void ALSA_sink::open(unsigned rate)
+{
+	if(pcm_){
+		return;
+	}
+
+	int err = snd_pcm_open(&pcm_, device_.c_str(), SND_PCM_STREAM_PLAYBACK, 0);
+
+	if(err < 0){
+		pcm_ = nullptr;
+		throw std::runtime_error("snd_pcm_open(" + device_ + ") failed: " + snd_strerror(err));
+	}
+
+	err = snd_pcm_set_params(pcm_, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, 1, rate, 1, latency_us_);
+
+	if(err < 0){
+		this->close();
+		throw std::runtime_error(std::string("snd_pcm_set_params() failed: ") + snd_strerror(err));
+	}
+}
+
+void ALSA_sink::write(const int16_t *buf, size_t frames)
+{
+	while(frames){
+		snd_pcm_sframes_t n = snd_pcm_writei(pcm_, buf, frames);
+
+		if(n < 0){
+			// Восстановление после опустошения буфера (underrun)
+			n = snd_pcm_recover(pcm_, static_cast<int>(n), 1);
+			if(n < 0){
+				throw std::runtime_error(std::string("snd_pcm_writei() failed: ") + snd_strerror(static_cast<int>(n)));
+			}
+			continue;
+		}
+
+		buf += n;
+		frames -= n;
+	}
+}
+
+void ALSA_sink::drain()
+{
+	snd_pcm_drain(pcm_);
+	snd_pcm_prepare(pcm_);
+}
+
+void ALSA_sink::drop()
+{
+	snd_pcm_drop(pcm_);
+	snd_pcm_prepare(pcm_);
+}
+
+void ALSA_sink::close()
+{
+	if(pcm_){
+		snd_pcm_close(pcm_);
+		pcm_ = nullptr;
+	}
+}
+#endif
+
+
+void Null_sink::write(const int16_t *buf, size_t frames)
+{
+	using namespace std::chrono;
+
+	const auto now = steady_clock::now();
+
+	if(idle_ || (next_ < now)){
+		next_ = now;
+		idle_ = false;
+	}
+
+	next_ += microseconds(frames * 1000000ULL / rate_);
+
+	// Имитация аппаратного буфера: блокируемся пока в нем больше 40 мс данных
+	const auto limit = next_ - milliseconds(40);
+	if(limit > now){
+		std::this_thread::sleep_until(limit);
+	}
+}
+
+void Null_sink::drain()
+{
+	if( !idle_ ){
+		std::this_thread::sleep_until(next_);
+	}
+
+	idle_ = true;
+}
+
+
+static void put_le(uint8_t *p, uint32_t value, int bytes)
+{
+	for(int i = 0; i < bytes; ++i){
+		p[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+}
+
+void WAV_sink::open(unsigned rate)
+{
+	if(file_){
+		return;
+	}
+
+	file_ = fopen(path_.c_str(), "wb");
+
+	if( !file_ ){
+		throw std::runtime_error("could not open '" + path_ + "': " + strerror(errno));
+	}
+
+	rate_ = rate;
+	data_size_ = 0;
+
+	// Заголовок перезаписывается при закрытии, когда известен размер данных
+	uint8_t header[44] = {0};
+	fwrite(header, 1, sizeof(header), file_);
+}
+
+void WAV_sink::write(const int16_t *buf, size_t frames)
+{
+	if(fwrite(buf, sizeof(int16_t), frames, file_) != frames){
+		throw std::runtime_error("write to '" + path_ + "' failed");
+	}
+
+	data_size_ += frames * sizeof(int16_t);
+}
+
+void WAV_sink::close()
+{
+	if( !file_ ){
+		return;
+	}
+
+	uint8_t header[44];
+	memcpy(header, "RIFF", 4);
+	put_le(header + 4, 36 + data_size_, 4);
+	memcpy(header + 8, "WAVEfmt ", 8);
+	put_le(header + 16, 16, 4);				// Размер блока fmt
+	put_le(header + 20, 1, 2);				// PCM
+	put_le(header + 22, 1, 2);				// Моно
+	put_le(header + 24, rate_, 4);
+	put_le(header + 28, rate_ * 2, 4);		// Байт в секунду
+	put_le(header + 32, 2, 2);				// Байт на отсчет
+	put_le(header + 34, 16, 2);				// Бит на отсчет
+	memcpy(header + 36, "data", 4);
+	put_le(header + 40, data_size_, 4);
+
+	fseek(file_, 0, SEEK_SET);
+	fwrite(header, 1, sizeof(header), file_);
+	fclose(file_);
+	file_ = nullptr;
+}
+
+
+PCM_Audio::PCM_Audio(std::unique_ptr<PCM_sink> sink, unsigned rate): 
+	sink_(std::move(sink)), rate_(rate), period_(rate / 100)
+{
+	if( !sink_ ){
+		throw std::invalid_argument("PCM_Audio: sink is not set");
+	}
+
+	if( !period_ ){
+		throw std::invalid_argument("PCM_Audio: unsupported rate " + std::to_string(rate));
+	}
+
+	sink_->open(rate_);
+	thread_ = std::thread(&PCM_Audio::engine, this);
+}
+
+PCM_Audio::~PCM_Audio()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		exit_ = true;
+		stop_ = true;
+	}
+
+	cv_.notify_all();
+
+	if(thread_.joinable()){
+		thread_.join();
+	}
+
+	sink_->close();
+}
+
+void PCM_Audio::play(const std::string &file_path)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if(playing_.load()){
+		return;
+	}
+
+	queue_.push_back({file_path, std::chrono::steady_clock::now()});
+	playing_.store(true);
+	cv_.notify_one();
+}
+
+void PCM_Audio::enqueue(const std::string &file_path)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	queue_.push_back({file_path, std::chrono::steady_clock::now()});
+	playing_.store(true);
+	cv_.notify_one();
+}
+
+void PCM_Audio::play_overlay(const std::string &file_path)
+{
+	// Сигнал короткий - декодируем целиком вне потока воспроизведения
+	std::vector<int16_t> pcm = this->decode_file(file_path);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	overlay_ = std::move(pcm);
+	overlay_pos_ = 0;
+	cv_.notify_one();
+}
+
+void PCM_Audio::stop()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	queue_.clear();
+	overlay_.clear();
+	overlay_pos_ = 0;
+
+	if(playing_.load()){
+		stop_ = true;
+	}
+}
+
+PCM_Audio::latency_stats PCM_Audio::get_latency_stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+std::string PCM_Audio::last_error()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::string res;
+	std::swap(res, last_error_);
+	return res;
+}
+
+void PCM_Audio::update_stats(double ms)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if( !stats_.count ){
+		stats_.min_ms = ms;
+		stats_.max_ms = ms;
+	}
+
+	stats_.min_ms = std::min(stats_.min_ms, ms);
+	stats_.max_ms = std::max(stats_.max_ms, ms);
+	stats_.avg_ms = (stats_.avg_ms * stats_.count + ms) / (stats_.count + 1);
+	++stats_.count;
+}
+
+std::vector<int16_t> PCM_Audio::decode_file(const std::string &file_path) const
+{
+	Decoder dec(rate_);
+	dec.open(file_path);
+
+	std::vector<int16_t> res;
+	std::vector<int16_t> block(period_);
+
+	while(size_t n = dec.read(block.data(), block.size())){
+		res.insert(res.end(), block.begin(), block.begin() + n);
+	}
+
+	return res;
+}
+
+bool PCM_Audio::next_stream(Decoder &dec, bool *first, std::chrono::steady_clock::time_point *req_time)
+{
+	for(;;){
+		request req;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			if(queue_.empty() || stop_){
+				return false;
+			}
+
+			req = std::move(queue_.front());
+			queue_.pop_front();
+		}
+
+		try{
+			dec.open(req.path);
+		}
+		catch(const std::exception &e){
+			std::lock_guard<std::mutex> lock(mutex_);
+			last_error_ = e.what();
+			continue;
+		}
+
+		if(first){
+			*first = true;
+		}
+
+		if(req_time){
+			*req_time = req.time;
+		}
+
+		return true;
+	}
+}
+
+size_t PCM_Audio::mix_overlay(int16_t *buf, size_t frames, size_t filled)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if(overlay_pos_ >= overlay_.size()){
+		return filled;
+	}
+
+	const size_t n = std::min(frames, overlay_.size() - overlay_pos_);
+
+	// Речь закончилась раньше сигнала - дополняем тишиной
+	if(n > filled){
+		std::fill(buf + filled, buf + n, 0);
+	}
+
+	// Смешивание с насыщением
+	for(size_t i = 0; i < n; ++i){
+		int32_t sample = static_cast<int32_t>(buf[i]) + overlay_[overlay_pos_ + i];
+		sample = std::min<int32_t>(sample, std::numeric_limits<int16_t>::max());
+		sample = std::max<int32_t>(sample, std::numeric_limits<int16_t>::min());
+		buf[i] = static_cast<int16_t>(sample);
+	}
+
+	overlay_pos_ += n;
+
+	if(overlay_pos_ >= overlay_.size()){
+		overlay_.clear();
+		overlay_pos_ = 0;
+	}
+
+	return std::max(filled, n);
+}
+
+void PCM_Audio::session()
+{
+	using namespace std::chrono;
+
+	Decoder dec(rate_);
+	std::vector<int16_t> block(period_);
+	steady_clock::time_point req_time;
+	bool first = false;
+	bool stopped = false;
+	bool have_stream = this->next_stream(dec, &first, &req_time);
+
+	for(;;){
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			if(stop_){
+				stopped = true;
+				break;
+			}
+		}
+
+		size_t filled = 0;
+
+		while(have_stream && (filled < period_)){
+			size_t n = dec.read(block.data() + filled, period_ - filled);
+			filled += n;
+
+			// Файл закончился - продолжаем следующим из очереди в том же блоке
+			if( !n ){
+				have_stream = this->next_stream(dec, nullptr, nullptr);
+			}
+		}
+
+		const size_t frames = this->mix_overlay(block.data(), period_, filled);
+
+		if( !frames ){
+			break;
+		}
+
+		sink_->write(block.data(), frames);
+
+		if(first){
+			first = false;
+			this->update_stats(duration_cast<microseconds>(steady_clock::now() - req_time).count() / 1000.0);
+		}
+	}
+
+	if(stopped){
+		sink_->drop();
+	}
+	else{
+		sink_->drain();
+	}
+}
+
+void PCM_Audio::engine()
+{
+	for(;;){
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			cv_.wait(lock, [this](){ return exit_ || !queue_.empty() || !overlay_.empty(); });
+
+			if(exit_){
+				return;
+			}
+
+			playing_.store(true);
+		}
+
+		try{
+			this->session();
+		}
+		catch(const std::exception &e){
+			std::lock_guard<std::mutex> lock(mutex_);
+			last_error_ = e.what();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			if(exit_){
+				return;
+			}
+
+			stop_ = false;
+			playing_.store( !queue_.empty() );
+		}
+
+		// Аналогично SIMCOM событию окончания воспроизведения
+		if(finished_callback){
+			finished_callback();
+		}
+	}
+}
+
+} // namespace hw
+
+
+#ifdef _PCM_AUDIO_TEST
+
+#include <iostream>
+
+using namespace hw;
+
+static void wait_finished(PCM_Audio &audio)
+{
+	while(audio.is_playing()){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2){
+		std::cout << "Usage: " << argv[0] << " [-w out.wav] file1.mp3 [file2.mp3 ...]" << std::endl;
+		return 1;
+	}
+
+	int first_file = 1;
+	std::unique_ptr<PCM_sink> sink{new Null_sink};
+
+	if((argc > 3) && (std::string(argv[1]) == "-w")){
+		sink.reset(new WAV_sink(argv[2]));
+		first_file = 3;
+	}
+
+	try{
+		PCM_Audio audio{std::move(sink)};
+
+		// Задержка старта одиночного воспроизведения
+		for(int i = first_file; i < argc; ++i){
+			audio.play(argv[i]);
+			wait_finished(audio);
+
+			std::string err = audio.last_error();
+			if( !err.empty() ){
+				std::cout << "Error: " << err << std::endl;
+			}
+		}
+
+		// Воспроизведение очереди без пауз
+		auto start = std::chrono::steady_clock::now();
+
+		for(int i = first_file; i < argc; ++i){
+			audio.enqueue(argv[i]);
+		}
+
+		wait_finished(audio);
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		PCM_Audio::latency_stats stats = audio.get_latency_stats();
+
+		std::cout << "Queue of " << argc - first_file << " files played in " << elapsed << " ms" << std::endl;
+		std::cout << "Start latency (" << stats.count << " starts): min " << stats.min_ms << " ms, avg " << 
+			stats.avg_ms << " ms, max " << stats.max_ms << " ms" << std::endl;
+	}
+	catch(const std::exception &e){
+		std::cout << "Exception: " << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+#endif
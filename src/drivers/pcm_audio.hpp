@@ -0,0 +1,191 @@
+/*==============================================================================
+Описание: 	Модуль воспроизведения MP3 через PCM поток (ALSA) с декодированием
+			внутри процесса.
+
+			В отличие от hw::Audio (SIMCOM audio_play_start) не требует копирования
+			файла в виртуальную ФС 'e:/', допускает вызов play() из колбека
+			окончания воспроизведения, воспроизводит очередь файлов без пауз и
+			позволяет накладывать короткий сигнал (гонг) поверх речи.
+
+			Зависимости: alsa-lib (целевая платформа) и minimp3.h (single-header
+			декодер, должен находиться в include-директориях тулчейна).
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+
+#ifndef _HOST_BUILD
+struct _snd_pcm;
+#endif
+
+namespace hw{
+
+// Приемник PCM данных (моно, signed 16 bit)
+class PCM_sink
+{
+public:
+	virtual ~PCM_sink() = default;
+
+	virtual void open(unsigned rate) = 0;
+	virtual void write(const int16_t *buf, size_t frames) = 0;
+
+	// Дождаться воспроизведения записанных данных
+	virtual void drain() = 0;
+
+	// Сбросить записанные данные без воспроизведения
+	virtual void drop() = 0;
+
+	virtual void close() = 0;
+};
+
+#ifndef _HOST_BUILD
+// Вывод на звуковую карту через alsa-lib
+class ALSA_sink final: public PCM_sink
+{
+public:
+	// latency_us - размер аппаратного буфера. Определяет задержку старта и запас
+	// по времени для потока декодирования
+	ALSA_sink(const std::string &device = "default", unsigned latency_us = 40000):
+		device_(device), latency_us_(latency_us) {}
+	~ALSA_sink() { this->close(); }
+
+	void open(unsigned rate) override;
+	void write(const int16_t *buf, size_t frames) override;
+	void drain() override;
+	void drop() override;
+	void close() override;
+
+private:
+	std::string device_;
+	unsigned latency_us_ = 0;
+	struct _snd_pcm *pcm_ = nullptr;
+};
+#endif
+
+// Приемник без вывода. Темп записи соответствует реальному времени
+// воспроизведения (для измерения задержек без оборудования)
+class Null_sink final: public PCM_sink
+{
+public:
+	void open(unsigned rate) override { rate_ = rate; idle_ = true; }
+	void write(const int16_t *buf, size_t frames) override;
+	void drain() override;
+	void drop() override { idle_ = true; }
+	void close() override {}
+
+private:
+	unsigned rate_ = 0;
+	bool idle_ = true;
+	std::chrono::steady_clock::time_point next_;	// Момент окончания записанных данных
+};
+
+// Запись потока в WAV файл (без ожидания реального времени)
+class WAV_sink final: public PCM_sink
+{
+public:
+	WAV_sink(const std::string &path): path_(path) {}
+	~WAV_sink() { this->close(); }
+
+	void open(unsigned rate) override;
+	void write(const int16_t *buf, size_t frames) override;
+	void drain() override {}
+	void drop() override {}
+	void close() override;
+
+private:
+	std::string path_;
+	FILE *file_ = nullptr;
+	unsigned rate_ = 0;
+	uint32_t data_size_ = 0;
+};
+
+
+class PCM_Audio
+{
+public:
+	// Статистика задержки старта воспроизведения (от вызова play() до записи
+	// первого блока в приемник)
+	struct latency_stats{
+		uint32_t count = 0;
+		double min_ms = 0.0;
+		double max_ms = 0.0;
+		double avg_ms = 0.0;
+	};
+
+	PCM_Audio(std::unique_ptr<PCM_sink> sink, unsigned rate = 44100);
+	~PCM_Audio();
+
+	// Воспроизвести файл (игнорируется если воспроизведение уже идет)
+	void play(const std::string &file_path);
+
+	// Добавить файл в очередь. Файл начнет воспроизводиться сразу после
+	// окончания предыдущего, без паузы
+	void enqueue(const std::string &file_path);
+
+	// Наложить короткий файл (гонг) поверх текущего воспроизведения
+	void play_overlay(const std::string &file_path);
+
+	// Остановить воспроизведение и очистить очередь
+	void stop();
+
+	bool is_playing() const { return playing_.load(); }
+
+	latency_stats get_latency_stats() const;
+
+	// Описание последней ошибки потока воспроизведения (очищается при чтении)
+	std::string last_error();
+
+	// Колбек окончания воспроизведения (вызывается из потока воспроизведения,
+	// из него допустим вызов play())
+	std::function<void(void)> finished_callback;
+
+private:
+	struct request{
+		std::string path;
+		std::chrono::steady_clock::time_point time;
+	};
+
+	class Decoder;
+
+	std::unique_ptr<PCM_sink> sink_;
+	const unsigned rate_ = 0;
+	const size_t period_ = 0;			// Размер блока записи в приемник (отсчеты)
+
+	mutable std::mutex mutex_;
+	std::condition_variable cv_;
+	std::deque<request> queue_;
+	std::vector<int16_t> overlay_;		// Накладываемый сигнал
+	size_t overlay_pos_ = 0;
+	bool stop_ = false;
+	bool exit_ = false;
+	std::string last_error_;
+	latency_stats stats_;
+
+	std::atomic<bool> playing_{false};
+	std::thread thread_;
+
+	void engine();
+	void session();
+	bool next_stream(Decoder &dec, bool *first, std::chrono::steady_clock::time_point *req_time);
+	size_t mix_overlay(int16_t *buf, size_t frames, size_t filled);
+	void update_stats(double ms);
+	std::vector<int16_t> decode_file(const std::string &file_path) const;
+};
+
+} // namespace hw
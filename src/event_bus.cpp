@@ -0,0 +1,113 @@
+#include <stdexcept>
+
+#define LOG_MODULE_NAME		"[ EVB ]"
+#include "logger.hpp"
+
+#include "event_bus.hpp"
+
+namespace avi{
+
+int Event_bus::subscribe(uint32_t types, size_t capacity)
+{
+	std::lock_guard<std::mutex> lock(subscribe_mutex_);
+
+	const int id = count_.load(std::memory_order_relaxed);
+	if(id >= static_cast<int>(max_subscribers)){
+		throw std::runtime_error(excp_method("too many event bus subscribers"));
+	}
+
+	subs_[id].types = types;
+	subs_[id].queue.reset(new utils::MPMC_queue<event>(capacity));
+
+	// Подписчик становится виден публикующему потоку только заполненным
+	count_.store(id + 1, std::memory_order_release);
+
+	return id;
+}
+
+void Event_bus::publish(const event &ev) noexcept
+{
+	const int count = count_.load(std::memory_order_acquire);
+
+	for(int i = 0; i < count; ++i){
+		subscriber &sub = subs_[i];
+
+		if( !(sub.types & ev.t) ){
+			continue;
+		}
+
+		if( !sub.queue->try_push(ev) ){
+			sub.dropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+}
+
+bool Event_bus::poll(int id, event *ev)
+{
+	if((id < 0) || (id >= count_.load(std::memory_order_acquire))){
+		return false;
+	}
+
+	return subs_[id].queue->try_pop(ev);
+}
+
+uint64_t Event_bus::dropped(int id) const
+{
+	if((id < 0) || (id >= count_.load(std::memory_order_acquire))){
+		return 0;
+	}
+
+	return subs_[id].dropped.load(std::memory_order_relaxed);
+}
+
+void Event_bus::clear()
+{
+	event ev;
+	const int count = count_.load(std::memory_order_acquire);
+
+	for(int i = 0; i < count; ++i){
+		while(subs_[i].queue->try_pop(&ev)){}
+	}
+}
+
+void Event_consumer_task::init(Event_bus *bus, uint32_t types, size_t capacity, handler h)
+{
+	if( !bus ){
+		throw std::invalid_argument(excp_method("bus was not set (nullptr)"));
+	}
+
+	if(sub_id_ < 0){
+		bus_ = bus;
+		sub_id_ = bus_->subscribe(types, capacity);
+		batch_.reserve(capacity);
+	}
+
+	handler_ = h;
+}
+
+Background_task::signal Event_consumer_task::main_func(void)
+{
+	if(this->get_current_state() == Background_task::signal::STOP){
+		return Background_task::signal::STOP;
+	}
+
+	this->drain();
+
+	return Background_task::signal::SLEEP;
+}
+
+void Event_consumer_task::drain()
+{
+	batch_.clear();
+
+	Event_bus::event ev;
+	while(bus_->poll(sub_id_, &ev)){
+		batch_.push_back(std::move(ev));
+	}
+
+	if( !batch_.empty() && handler_ ){
+		handler_(batch_);
+	}
+}
+
+} // namespace avi
@@ -0,0 +1,134 @@
+/*==============================================================================
+Описание: 	Модуль шины событий навигации внутри процесса.
+
+			Поток источника GPS данных публикует события (решение, вход в
+			зону фрейма, выход из зоны), проигрыватель - начало и окончание
+			воспроизведения. Публикующий не ждет потребителей: у каждого
+			подписчика своя ограниченная очередь без блокировок, при ее
+			переполнении событие для этого подписчика отбрасывается.
+			Потребители (проигрыватель, дисплей, журнал трека) разбирают
+			свои очереди в своих потоках со своей периодичностью.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <functional>
+
+#include "bg_task.hpp"
+#include "platform.hpp"
+#include "app_db.hpp"
+#include "utils/mpmc_queue.hpp"
+
+namespace avi{
+
+// Решение приемника в виде, допускающем побайтовое копирование (публикация
+// в очереди и seqlock без блокировок и выделения памяти)
+struct Nav_fix
+{
+	utils::Coord coord;			// Координаты
+	double speed_kmh = 0.0;
+	double course = 0.0;
+	bool valid = false;			// Признак валидности решения приемника
+	bool confident = false;		// Решение достаточно устойчиво для сопоставления с зонами
+	bool estimated = false;		// Координаты счислены по последнему устойчивому решению (приемник без решения)
+	int32_t route_pos_cm = -1;	// Расстояние вдоль линии маршрута (-1 - решение не привязано к линии)
+	char date_time[24] = {0};	// Дата и время решения приемника
+};
+
+class Event_bus
+{
+public:
+	// Типы событий (битовая маска подписки)
+	enum type: uint32_t
+	{
+		FIX = 1,			// Решение приемника
+		ZONE_ENTER = 2,		// Вход в зону фрейма (воспроизведение minfo)
+		ZONE_EXIT = 4,		// Выход из зоны фрейма
+		PLAYBACK_START = 8,	// Начало воспроизведения minfo
+		PLAYBACK_END = 16	// Окончание воспроизведения minfo (вместе с переданными бэкенду потомками)
+	};
+
+	struct event
+	{
+		type t = FIX;
+		int frame_id = -1;
+		const NSIDatabase::kFrames_table::MediaInfo *minfo = nullptr;
+		bool inside = false;		// Решение осталось в зоне другого фрейма (ZONE_EXIT)
+		Nav_fix gps;				// Решение приемника (FIX). Без строк - копирование в очередь не выделяет память
+	};
+
+	static const size_t max_subscribers = 8;
+
+	/**
+	  * @описание   Подписка на события. Выполняется до начала публикации
+	  * @параметры
+	  *     Входные:
+	  *         types - маска типов событий
+	  *         capacity - емкость очереди подписчика
+	  * @возвращает идентификатор подписчика
+	  * @исключения std::runtime_error - подписчиков больше max_subscribers
+	 */
+	int subscribe(uint32_t types, size_t capacity);
+
+	// Публикация события всем подписчикам его типа. Не блокирует
+	void publish(const event &ev) noexcept;
+
+	// Очередное событие подписчика, false - очередь пуста
+	bool poll(int id, event *ev);
+
+	// Отброшено событий подписчика из-за переполнения очереди
+	uint64_t dropped(int id) const;
+
+	// Очистка очередей всех подписчиков
+	void clear();
+
+private:
+	struct subscriber
+	{
+		uint32_t types = 0;
+		std::unique_ptr<utils::MPMC_queue<event>> queue;
+		std::atomic<uint64_t> dropped{0};
+	};
+
+	std::mutex subscribe_mutex_;
+	std::array<subscriber, max_subscribers> subs_;
+	std::atomic<int> count_{0};
+};
+
+// Фоновая задача разбора очереди подписчика шины событий: за период
+// разбираются все накопившиеся события и передаются обработчику пакетом
+class Event_consumer_task final: public Background_task
+{
+public:
+	using handler = std::function<void(const std::vector<Event_bus::event> &events)>;
+
+	Event_consumer_task(const std::string &task_name = "Event_consumer_task"): Background_task(task_name) {}
+
+	// Подписка (однократно) и обработчик событий
+	void init(Event_bus *bus, uint32_t types, size_t capacity, handler h);
+
+	int get_subscriber_id() const { return sub_id_; }
+
+	// Разбор накопившихся событий в потоке вызывающего (воспроизведение трека
+	// в виртуальном времени - поток задачи при этом остановлен)
+	void drain();
+
+private:
+	Event_bus *bus_ = nullptr;
+	int sub_id_ = -1;
+	handler handler_;
+	std::vector<Event_bus::event> batch_;
+
+	Background_task::signal main_func(void) override;
+};
+
+} // namespace avi
@@ -0,0 +1,321 @@
+#include <cmath>
+
+#define LOG_MODULE_NAME		"[ GPSF ]"
+#include "logger.hpp"
+
+#include "gps_filter.hpp"
+
+namespace avi{
+
+static const double PI = 3.14159265358979;
+
+void GPS_filter::reset()
+{
+	initialized_ = false;
+	x_ = y_ = vx_ = vy_ = 0.0;
+	last_t_ = 0.0;
+	score_ = 0;
+	outliers_ = 0;
+	out_ = platform::GPS_data();
+}
+
+void GPS_filter::add_score(int delta)
+{
+	score_ += delta;
+
+	if(score_ < 0){
+		score_ = 0;
+	}
+	else if(score_ > params_.confidence_fixes){
+		score_ = params_.confidence_fixes;
+	}
+}
+
+void GPS_filter::restart(const platform::GPS_data &fix, double t_sec)
+{
+	const double v = fix.speed_kmh / 3.6;
+	const double crs = fix.course * PI / 180.0;
+
+	ref_ = fix.coord;
+	metric_ = utils::LocalMetric(ref_.lat);
+	x_ = y_ = 0.0;
+	vx_ = v * sin(crs);
+	vy_ = v * cos(crs);
+	last_t_ = t_sec;
+	outliers_ = 0;
+	initialized_ = true;
+}
+
+void GPS_filter::make_output(const platform::GPS_data &fix)
+{
+	const double v = sqrt(vx_ * vx_ + vy_ * vy_);
+
+	out_.date_time = fix.date_time;
+	out_.coord = metric_.shift(ref_, std::llround(x_ * 100.0), std::llround(y_ * 100.0));
+	out_.speed_kmh = v * 3.6;
+	out_.valid = fix.valid;
+
+	// На малой скорости направление вектора скорости определяется шумом
+	if(v >= 1.0){
+		double crs = atan2(vx_, vy_) * 180.0 / PI;
+		out_.course = (crs < 0.0) ? crs + 360.0 : crs;
+	}
+	else{
+		out_.course = fix.course;
+	}
+}
+
+const platform::GPS_data& GPS_filter::update(const platform::GPS_data &fix, double t_sec)
+{
+	// Невалидное решение не меняет состояние фильтра, только снижает уверенность.
+	// Длительное отсутствие валидных решений перезапустит фильтр по перерыву
+	if( !fix.valid ){
+		add_score(-1);
+		out_.valid = false;
+		out_.date_time = fix.date_time;
+		return out_;
+	}
+
+	const double dt = t_sec - last_t_;
+
+	if( !initialized_ || (dt > params_.max_gap_s) ){
+		if(initialized_){
+			log_msg(MSG_DEBUG, "GPS filter restarted after %.1lf sec gap\n", dt);
+		}
+
+		score_ = 0;
+		restart(fix, t_sec);
+		add_score(1);
+		make_output(fix);
+		return out_;
+	}
+
+	// Прогноз по модели постоянной скорости
+	const double step = (dt > 0.0) ? dt : 0.0;
+	const double px = x_ + vx_ * step;
+	const double py = y_ + vy_ * step;
+
+	int64_t east = 0;
+	int64_t north = 0;
+	metric_.offset_cm(ref_, fix.coord, &east, &north);
+
+	const double rx = east / 100.0 - px;
+	const double ry = north / 100.0 - py;
+
+	if(rx * rx + ry * ry > params_.gate_m * params_.gate_m){
+		++outliers_;
+		add_score(-1);
+
+		if(outliers_ > 1){
+			// Несколько выбросов подряд - положение действительно изменилось скачком
+			// (выход из зоны плохого приема). Начинаем заново
+			log_msg(MSG_DEBUG, "GPS filter restarted after jump of %.1lf m\n", sqrt(rx * rx + ry * ry));
+			score_ = 0;
+			restart(fix, t_sec);
+			add_score(1);
+		}
+		else{
+			// Одиночный выброс игнорируем - продолжаем по прогнозу
+			x_ = px;
+			y_ = py;
+			last_t_ = t_sec;
+		}
+
+		make_output(fix);
+		return out_;
+	}
+
+	outliers_ = 0;
+
+	// Коррекция положения и скорости
+	x_ = px + params_.alpha * rx;
+	y_ = py + params_.alpha * ry;
+
+	if(step > 0.0){
+		vx_ += params_.beta / step * rx;
+		vy_ += params_.beta / step * ry;
+	}
+
+	// Доплеровская скорость приемника точнее разностной оценки
+	const double v = fix.speed_kmh / 3.6;
+	const double crs = fix.course * PI / 180.0;
+	vx_ += params_.gamma * (v * sin(crs) - vx_);
+	vy_ += params_.gamma * (v * cos(crs) - vy_);
+
+	last_t_ = t_sec;
+	add_score(1);
+
+	// Переносим начало локальной системы за транспортом - погрешность
+	// равнопромежуточной проекции растет с удалением от опорной точки
+	if((fabs(x_) > 1000.0) || (fabs(y_) > 1000.0)){
+		ref_ = metric_.shift(ref_, std::llround(x_ * 100.0), std::llround(y_ * 100.0));
+		metric_ = utils::LocalMetric(ref_.lat);
+		x_ = y_ = 0.0;
+	}
+
+	make_output(fix);
+	return out_;
+}
+
+} // namespace avi
+
+
+#ifdef _GPS_FILTER_TEST
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+using avi::GPS_filter;
+
+struct track_point
+{
+	double t = 0.0;
+	platform::GPS_data data;
+};
+
+// Формат строки трека: "[ 14.07.22 12:00:07 ] vld: 1, lat: ..., long: ..., crs: ..., spd: ..."
+static vector<track_point> load_track(const string &file_path)
+{
+	ifstream in{file_path};
+	if( !in.is_open() ){
+		throw runtime_error("could not open '" + file_path + "'");
+	}
+
+	vector<track_point> res;
+	string line;
+
+	while(getline(in, line)){
+		int hh = 0, mm = 0, ss = 0;
+		auto pos = line.find_last_of(']');
+
+		if((pos == string::npos) || (sscanf(line.c_str(), "[ %*d.%*d.%*d %d:%d:%d", &hh, &mm, &ss) != 3)){
+			continue;
+		}
+
+		try{
+			track_point pt;
+			pt.t = hh * 3600 + mm * 60 + ss;
+			pt.data = platform::GPS_data(line.substr(pos + 2));
+			res.push_back(pt);
+		}
+		catch(const exception &e){
+			cerr << "WARN: " << e.what() << endl;
+		}
+	}
+
+	// Метки времени с точностью до секунды - равномерно распределяем
+	// решения внутри одной секунды
+	for(size_t i = 0; i < res.size(); ){
+		size_t j = i;
+		while((j < res.size()) && (res[j].t == res[i].t)){
+			++j;
+		}
+
+		for(size_t k = i; k < j; ++k){
+			res[k].t += static_cast<double>(k - i) / (j - i);
+		}
+
+		i = j;
+	}
+
+	return res;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2){
+		cout << "Usage: " << argv[0] << " file.track [min_speed_kmh] [valid_threshold]" << endl;
+		return 1;
+	}
+
+	const double min_speed = (argc > 2) ? atof(argv[2]) : 6.0;
+	const int threshold = (argc > 3) ? atoi(argv[3]) : 4;
+
+	try{
+		vector<track_point> track = load_track(argv[1]);
+
+		GPS_filter::params p;
+		p.confidence_fixes = threshold;
+		GPS_filter filter(p);
+
+		int legacy_counter = 0;
+		size_t legacy_allowed = 0;
+		size_t filter_allowed = 0;
+		size_t moving = 0;
+
+		// Латентность: от начала движения до первого разрешенного сопоставления с зонами
+		size_t starts = 0;
+		size_t legacy_starts = 0, filter_starts = 0;
+		double legacy_latency = 0.0, filter_latency = 0.0;
+		double legacy_max = 0.0, filter_max = 0.0;
+		bool was_moving = false;
+		double start_t = 0.0;
+		bool legacy_pending = false, filter_pending = false;
+
+		for(const auto &pt : track){
+			const auto &fix = pt.data;
+			const bool is_moving = fix.valid && (fix.speed_kmh >= min_speed);
+
+			// Прежний алгоритм (Announcement_task::gps_data_ready_for_processing до фильтра)
+			bool legacy_ok = false;
+			if( !is_moving ){
+				legacy_counter = 0;
+			}
+			else if(++legacy_counter >= threshold){
+				legacy_counter = 0;
+				legacy_ok = true;
+			}
+
+			const platform::GPS_data &smoothed = filter.update(fix, pt.t);
+			const bool filter_ok = filter.confident() && (smoothed.speed_kmh >= min_speed);
+
+			moving += is_moving;
+			legacy_allowed += legacy_ok;
+			filter_allowed += filter_ok;
+
+			if(is_moving && !was_moving){
+				++starts;
+				start_t = pt.t;
+				legacy_pending = filter_pending = true;
+			}
+
+			if(legacy_pending && legacy_ok){
+				legacy_pending = false;
+				++legacy_starts;
+				legacy_latency += pt.t - start_t;
+				legacy_max = max(legacy_max, pt.t - start_t);
+			}
+
+			if(filter_pending && filter_ok){
+				filter_pending = false;
+				++filter_starts;
+				filter_latency += pt.t - start_t;
+				filter_max = max(filter_max, pt.t - start_t);
+			}
+
+			was_moving = is_moving;
+		}
+
+		printf("%s: %zu fixes, %zu moving, %zu starts (min speed %.1lf km/h, threshold %d)\n",
+			argv[1], track.size(), moving, starts, min_speed, threshold);
+		// Начала движения без единого сопоставления (короткие проезды) в среднее не входят
+		printf("  legacy: %6zu matches (%5.1lf%% of moving), start latency avg %.2lf s, max %.2lf s, missed starts %zu\n",
+			legacy_allowed, moving ? 100.0 * legacy_allowed / moving : 0.0,
+			legacy_starts ? legacy_latency / legacy_starts : 0.0, legacy_max, starts - legacy_starts);
+		printf("  filter: %6zu matches (%5.1lf%% of moving), start latency avg %.2lf s, max %.2lf s, missed starts %zu\n",
+			filter_allowed, moving ? 100.0 * filter_allowed / moving : 0.0,
+			filter_starts ? filter_latency / filter_starts : 0.0, filter_max, starts - filter_starts);
+	}
+	catch(const exception &e){
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+#endif
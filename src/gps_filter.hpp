@@ -0,0 +1,81 @@
+/*==============================================================================
+Описание: 	Модуль сглаживания GPS координат альфа-бета фильтром
+			(модель постоянной скорости).
+
+			Фильтр оценивает положение и скорость в локальной плоскости,
+			отбрасывает скачки координат и рассчитывает уверенность в
+			решении. Уверенность растет с каждым согласованным решением
+			и снижается на выбросах и невалидных данных, но, в отличие от
+			счетчика валидных решений, не сбрасывается на каждой остановке.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include "platform.hpp"
+#include "utils/geo.hpp"
+
+namespace avi{
+
+class GPS_filter
+{
+public:
+	struct params
+	{
+		double alpha = 0.6;			// Коэффициент коррекции положения
+		double beta = 0.2;			// Коэффициент коррекции скорости по положению
+		double gamma = 0.5;			// Коэффициент коррекции скорости по доплеровской скорости приемника
+		double gate_m = 25.0;		// Отклонение от прогноза, после которого решение считается выбросом
+		double max_gap_s = 3.0;		// Перерыв в данных, после которого фильтр перезапускается
+		int confidence_fixes = 4;	// Количество согласованных решений до полной уверенности
+	};
+
+	GPS_filter() = default;
+	explicit GPS_filter(const params &p): params_(p) {}
+
+	void set_params(const params &p) { params_ = p; this->reset(); }
+	const params& get_params() const { return params_; }
+
+	void reset();
+
+	/**
+	  * @описание   Обработка очередного решения приемника
+	  * @параметры
+	  *     Входные:
+	  *         fix - решение приемника
+	  *         t_sec - время получения решения (монотонное, секунды)
+	  * @возвращает сглаженное решение
+	 */
+	const platform::GPS_data& update(const platform::GPS_data &fix, double t_sec);
+
+	// Последнее сглаженное решение
+	const platform::GPS_data& get() const { return out_; }
+
+	// Уверенность в решении [0 .. 1]
+	double confidence() const { return static_cast<double>(score_) / params_.confidence_fixes; }
+
+	// Решение достаточно устойчиво для сопоставления с зонами
+	bool confident() const { return initialized_ && out_.valid && (score_ >= params_.confidence_fixes); }
+
+private:
+	params params_;
+
+	bool initialized_ = false;
+	utils::Coord ref_;				// Начало локальной системы координат
+	utils::LocalMetric metric_;
+	double x_ = 0.0, y_ = 0.0;		// Положение (м): восток, север
+	double vx_ = 0.0, vy_ = 0.0;	// Скорость (м/с)
+	double last_t_ = 0.0;
+	int score_ = 0;					// Количество согласованных решений [0 .. confidence_fixes]
+	int outliers_ = 0;				// Подряд идущие выбросы
+	platform::GPS_data out_;
+
+	void restart(const platform::GPS_data &fix, double t_sec);
+	void make_output(const platform::GPS_data &fix);
+	void add_score(int delta);
+};
+
+} // namespace avi
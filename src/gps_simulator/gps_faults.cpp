@@ -0,0 +1,181 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#define LOG_MODULE_NAME		"[ GFI ]"
+#include "logger.hpp"
+
+#include "utils/geo.hpp"
+#include "gps_faults.hpp"
+
+namespace platform{
+
+static GPS_fault_profile preset(const std::string &name)
+{
+	GPS_fault_profile res;
+	res.name = name;
+
+	if(name == "clean"){
+		return res;
+	}
+
+	// Multipath reflections between buildings, unstable course in traffic jams
+	if((name == "urban") || (name == "harsh")){
+		res.jump_prob = 0.02;
+		res.jump_m = 80.0;
+		res.jump_sec = 3.0;
+		res.course_noise_deg = 30.0;
+	}
+
+	// Long signal losses
+	if((name == "tunnel") || (name == "harsh")){
+		res.dropout_prob = 0.005;
+		res.dropout_sec = 30.0;
+	}
+
+	// Receiver repeating the last solution
+	if((name == "frozen") || (name == "harsh")){
+		res.freeze_prob = 0.01;
+		res.freeze_sec = 5.0;
+	}
+
+	// Course is undefined when standing or crawling
+	if(name == "lowspeed"){
+		res.course_noise_deg = 90.0;
+		res.course_noise_speed_kmh = 15.0;
+	}
+
+	if((name != "urban") && (name != "tunnel") && (name != "frozen") && (name != "lowspeed") && (name != "harsh")){
+		throw std::invalid_argument("unknown GPS fault profile '" + name + "'");
+	}
+
+	return res;
+}
+
+GPS_fault_profile GPS_fault_profile::parse(const std::string &str)
+{
+	std::istringstream in(str);
+	std::string token;
+
+	if( !std::getline(in, token, ',') || token.empty() ){
+		throw std::invalid_argument("empty GPS fault profile");
+	}
+
+	GPS_fault_profile res = preset(token);
+
+	while(std::getline(in, token, ',')){
+		const auto eq = token.find('=');
+		const std::string key = token.substr(0, eq);
+		const char *value = (eq != std::string::npos) ? token.c_str() + eq + 1 : "";
+		char *end = nullptr;
+		const double num = strtod(value, &end);
+
+		if((eq == std::string::npos) || (end == value) || *end || (num < 0.0)){
+			throw std::invalid_argument("invalid GPS fault profile parameter '" + token + "'");
+		}
+
+		if(key == "seed") res.seed = static_cast<uint32_t>(num);
+		else if(key == "jump_prob") res.jump_prob = num;
+		else if(key == "jump_m") res.jump_m = num;
+		else if(key == "jump_sec") res.jump_sec = num;
+		else if(key == "dropout_prob") res.dropout_prob = num;
+		else if(key == "dropout_sec") res.dropout_sec = num;
+		else if(key == "freeze_prob") res.freeze_prob = num;
+		else if(key == "freeze_sec") res.freeze_sec = num;
+		else if(key == "course_noise_deg") res.course_noise_deg = num;
+		else if(key == "course_noise_speed_kmh") res.course_noise_speed_kmh = num;
+		else{
+			throw std::invalid_argument("unknown GPS fault profile parameter '" + key + "'");
+		}
+	}
+
+	return res;
+}
+
+std::string GPS_fault_profile::to_string() const
+{
+	char buf[256];
+	snprintf(buf, sizeof(buf), "%s (seed %u): jump %.3lf/%.0lf m/%.1lf s, dropout %.3lf/%.1lf s, freeze %.3lf/%.1lf s, course noise %.0lf deg < %.1lf km/h",
+		name.c_str(), seed, jump_prob, jump_m, jump_sec, dropout_prob, dropout_sec, freeze_prob, freeze_sec,
+		course_noise_deg, course_noise_speed_kmh);
+
+	return buf;
+}
+
+GPS_fault_injector::GPS_fault_injector(const GPS_fault_profile &profile): profile_(profile), rng_(profile.seed)
+{
+}
+
+double GPS_fault_injector::uniform()
+{
+	return rng_() / 4294967296.0;
+}
+
+bool GPS_fault_injector::apply(GPS_data *data, time_point now)
+{
+	using namespace std::chrono;
+
+	const auto seconds = [](double sec){ return duration_cast<steady_clock::duration>(duration<double>(sec)); };
+
+	++stats_.fixes;
+
+	// The same amount of random numbers for every fix - the sequence of faults
+	// depends only on the seed and the number of fixes
+	const double r_dropout = this->uniform();
+	const double r_freeze = this->uniform();
+	const double r_jump = this->uniform();
+	const double r_direction = this->uniform();
+	const double r_distance = this->uniform();
+	const double r_noise = this->uniform();
+
+	if((now >= dropout_until_) && (profile_.dropout_sec > 0.0) && (r_dropout < profile_.dropout_prob)){
+		dropout_until_ = now + seconds(profile_.dropout_sec);
+	}
+
+	if(now < dropout_until_){
+		++stats_.dropped;
+		return false;
+	}
+
+	if( !data->valid ){
+		return true;
+	}
+
+	if(now < freeze_until_){
+		*data = frozen_;
+		++stats_.frozen;
+		return true;
+	}
+
+	// The current fix is delivered and repeated afterwards
+	if((profile_.freeze_sec > 0.0) && (r_freeze < profile_.freeze_prob)){
+		freeze_until_ = now + seconds(profile_.freeze_sec);
+		frozen_ = *data;
+	}
+
+	if((now >= jump_until_) && (profile_.jump_sec > 0.0) && (r_jump < profile_.jump_prob)){
+		const double PI = 3.14159265358979;
+		const double distance_cm = profile_.jump_m * 100.0 * (0.3 + 0.7 * r_distance);
+
+		jump_east_cm_ = static_cast<int64_t>(distance_cm * std::sin(2.0 * PI * r_direction));
+		jump_north_cm_ = static_cast<int64_t>(distance_cm * std::cos(2.0 * PI * r_direction));
+		jump_until_ = now + seconds(profile_.jump_sec);
+	}
+
+	if(now < jump_until_){
+		const utils::LocalMetric metric(data->coord.lat);
+		data->coord = metric.shift(data->coord, jump_east_cm_, jump_north_cm_);
+		++stats_.jumped;
+	}
+
+	if((profile_.course_noise_deg > 0.0) && (data->speed_kmh < profile_.course_noise_speed_kmh)){
+		data->course = std::fmod(data->course + (2.0 * r_noise - 1.0) * profile_.course_noise_deg + 360.0, 360.0);
+		++stats_.noised;
+	}
+
+	return true;
+}
+
+} // namespace platform
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <random>
+#include <chrono>
+
+#include "platform.hpp"
+
+
+namespace platform{
+
+// Reproducible GPS data faults for robustness benchmarking. Applied between the
+// GPS data source (receiver, generator or replayed track) and the subscribers
+struct GPS_fault_profile
+{
+	std::string name = "clean";
+	uint32_t seed = 1;
+
+	double jump_prob = 0.0;				// multipath jump start probability (per fix)
+	double jump_m = 0.0;				// max jump distance (m)
+	double jump_sec = 0.0;				// jump duration - position stays shifted
+	double dropout_prob = 0.0;			// dropout (tunnel) start probability (per fix)
+	double dropout_sec = 0.0;			// dropout duration - no fixes are delivered
+	double freeze_prob = 0.0;			// frozen fix start probability (per fix)
+	double freeze_sec = 0.0;			// frozen fix duration - the last fix is repeated
+	double course_noise_deg = 0.0;		// course noise amplitude (uniform) at low speed
+	double course_noise_speed_kmh = 10.0;	// course noise speed threshold
+
+	// Preset name with optional overrides: "name[,key=value...]", e.g. "urban,seed=7,jump_m=120".
+	// Presets: clean, urban, tunnel, frozen, lowspeed, harsh. Throws std::invalid_argument
+	static GPS_fault_profile parse(const std::string &str);
+	std::string to_string() const;
+};
+
+class GPS_fault_injector
+{
+public:
+	struct stats
+	{
+		uint64_t fixes = 0;		// fixes passed to apply()
+		uint64_t dropped = 0;
+		uint64_t jumped = 0;
+		uint64_t frozen = 0;
+		uint64_t noised = 0;
+	};
+
+	explicit GPS_fault_injector(const GPS_fault_profile &profile);
+
+	// Distorts the fix. now - time of the fix (durations of faults).
+	// Returns false if the fix must be dropped
+	bool apply(GPS_data *data, std::chrono::steady_clock::time_point now);
+
+	const GPS_fault_profile& profile() const { return profile_; }
+	const stats& get_stats() const { return stats_; }
+
+private:
+	using time_point = std::chrono::steady_clock::time_point;
+
+	GPS_fault_profile profile_;
+	std::mt19937 rng_;
+	stats stats_;
+
+	time_point jump_until_;
+	time_point dropout_until_;
+	time_point freeze_until_;
+	int64_t jump_east_cm_ = 0;
+	int64_t jump_north_cm_ = 0;
+	GPS_data frozen_;
+
+	double uniform();	// [0, 1)
+};
+
+} // namespace platform
@@ -2,6 +2,9 @@
 #include <cstring>
 #include <cerrno>
 #include <iostream>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
 
 #include "gps_gen.hpp"
 
@@ -10,75 +13,207 @@ using namespace std;
 
 void GPS_Generator::load_route(const std::string &file_path)
 {
-	errno = 0;
-	std::ifstream in{file_path};
-
-	if( !in.is_open() ){
-		throw std::runtime_error("could not open '" + file_path + "' - " + strerror(errno));
-	}
-
-	std::string tmp;
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
 
+	file_.open(file_path);
 	this->refresh();
-
-	while(std::getline(in, tmp)){
-
-		try{
-			if(tmp.substr(0, 6) == "$GPRMC"){
-				RMC_data data = parser_.parse_RMC(tmp);
-				cache_.push_back(std::move(data));
-			}
-		}
-		catch(const std::exception &e){
-			cerr << "WARN: " << e.what() << endl;
-		}
-	}
-
-	// printf("GPS_Generator: loaded %zu RMC sentences\n", cache_.size());
 }
 
 void GPS_Generator::refresh()
 {
-	cache_.clear();
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
+	offsets_.clear();
+	scan_pos_ = 0;
 	cache_index_ = 0;
 	cache_step_ = 1;
+	reversed_ = false;
+	segment_time_ = 0.0;
+
+	this->index_until(1);
+}
+
+void GPS_Generator::index_until(size_t count)
+{
+	RMC_data tmp;
+
+	while((offsets_.size() < count) && (scan_pos_ < file_.size())){
+		const char *line = nullptr;
+		size_t len = 0;
+		const size_t pos = scan_pos_;
+		scan_pos_ = file_.line(pos, &line, &len);
+
+		// Other sentences and broken RMC sentences are skipped
+		if((len > 6) && !memcmp(line + 3, "RMC", 3) && parser_.parse_RMC(line, len, &tmp)){
+			offsets_.push_back(pos);
+		}
+	}
 }
 
 void GPS_Generator::reset(int index, int increment_step)
 {
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
 	cache_index_ = index;
 	cache_step_ = increment_step;
+	segment_time_ = 0.0;
+}
+
+bool GPS_Generator::read_point(int index, RMC_data *out)
+{
+	if(index < 0){
+		return false;
+	}
+
+	// One point ahead - the caller detects the end of the route by route_size()
+	this->index_until(static_cast<size_t>(index) + 2);
+
+	if(static_cast<size_t>(index) >= offsets_.size()){
+		return false;
+	}
+
+	const char *line = nullptr;
+	size_t len = 0;
+	file_.line(offsets_[index], &line, &len);
+	parser_.parse_RMC(line, len, out);
+
+	if(reversed_){
+		out->course += 180.0;
+		if(out->course > 360.0){
+			out->course -= 360.0;
+		}
+	}
+
+	return true;
+}
+
+// Seconds of the day of RMC time stamp (hhmmss.sss), -1 if absent
+static double rmc_seconds(const RMC_data &data)
+{
+	int hh = 0, mm = 0;
+	double ss = 0.0;
+
+	if(sscanf(data.utc_time, "%2d%2d%lf", &hh, &mm, &ss) != 3){
+		return -1.0;
+	}
+
+	return hh * 3600 + mm * 60 + ss;
 }
 
 
 RMC_data GPS_Generator::get_route_point(int *index)
 {
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
 	RMC_data res;
 
 	if(index){
 		*index = cache_index_;
 	}
 
-	if( cache_.empty() || (cache_index_ >= cache_.size()) || (cache_index_ < 0) ){
+	if( !this->read_point(cache_index_, &res) ){
 		return res;
 	}
 
-	res = cache_[cache_index_];
 	cache_index_ += cache_step_;
 
 	return res;
 }
 
+RMC_data GPS_Generator::get_interpolated_point(double dt_sec, int *index)
+{
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+	RMC_data from, to;
+
+	if( !this->read_point(cache_index_, &from) ){
+		if(index){
+			*index = cache_index_;
+		}
+
+		return from;
+	}
+
+	segment_time_ += std::max(dt_sec, 0.0);
+
+	for(;;){
+		// End of the route - the last point is returned
+		if( !this->read_point(cache_index_ + cache_step_, &to) ){
+			if(index){
+				*index = cache_index_ + cache_step_;
+			}
+
+			cache_index_ += cache_step_;
+			segment_time_ = 0.0;
+
+			return from;
+		}
+
+		const double t_from = rmc_seconds(from);
+		const double t_to = rmc_seconds(to);
+		double duration = std::fabs(t_to - t_from);
+
+		// Midnight crossing
+		if(duration > 43200.0){
+			duration = 86400.0 - duration;
+		}
+
+		if((t_from < 0.0) || (t_to < 0.0) || (duration <= 0.0) || (duration > 60.0)){
+			duration = 1.0;
+		}
+
+		if(segment_time_ < duration){
+			const double f = segment_time_ / duration;
+
+			RMC_data res = from;
+			res.coord = utils::great_circle_point(from.coord, to.coord, f);
+			res.speed = from.speed + (to.speed - from.speed) * f;
+			res.valid = from.valid && to.valid;
+
+			// Shortest turn between the courses
+			double turn = to.course - from.course;
+			if(turn > 180.0){
+				turn -= 360.0;
+			}
+			else if(turn < -180.0){
+				turn += 360.0;
+			}
+
+			res.course = from.course + turn * f;
+			if(res.course < 0.0){
+				res.course += 360.0;
+			}
+			else if(res.course >= 360.0){
+				res.course -= 360.0;
+			}
+
+			if((t_from >= 0.0) && (t_to >= 0.0)){
+				double t = t_from + (t_to - t_from) * f;
+				t = (t < 0.0) ? t + 86400.0 : std::fmod(t, 86400.0);
+
+				const int sec = static_cast<int>(t);
+				snprintf(res.utc_time, sizeof(res.utc_time), "%02d%02d%06.3lf", sec / 3600, sec / 60 % 60, t - sec / 60 * 60);
+			}
+
+			if(index){
+				*index = cache_index_;
+			}
+
+			return res;
+		}
+
+		segment_time_ -= duration;
+		cache_index_ += cache_step_;
+		from = to;
+	}
+}
+
 
 void GPS_Generator::reverse_route()
 {
+	std::lock_guard<std::recursive_mutex> lock(mutex_);
+
 	// Change points course
-	for(auto &elem : cache_){
-		elem.course += 180.0;
-		if(elem.course > 360.0){
-			elem.course -= 360.0;
-		}
-	}
+	reversed_ = !reversed_;
+	segment_time_ = 0.0;
 
 	cache_step_ *= -1;
 	cache_index_ += cache_step_;
@@ -4,23 +4,45 @@
 #include <vector>
 #include <mutex>
 #include "nmea_parser.hpp"
+#include "utils/mapped_file.hpp"
 
 
+// Route points are read lazily from the memory mapped file: only offsets of
+// the RMC lines passed so far are kept, sentences are parsed on request
 class GPS_Generator
 {
 public:
 	void load_route(const std::string &file_path = "output.rmc");
 	RMC_data get_route_point(int *index = nullptr);
+
+	// Point between the route points (great circle position, course and speed) for
+	// arbitrary output rates. Route time is advanced by dt_sec, the time between route
+	// points is taken from RMC time stamps (1 sec if absent or inconsistent).
+	// index - the current segment start, out of range at the end of the route
+	RMC_data get_interpolated_point(double dt_sec, int *index = nullptr);
+
 	void refresh();
 	void reset(int index = 0, int step = 1);
 
 	void reverse_route();
-	size_t route_size() const { return cache_.size(); }
+
+	// Number of route points indexed so far (grows while the route is being passed,
+	// always exceeds the current index until the end of the file is reached)
+	size_t route_size() const { std::lock_guard<std::recursive_mutex> lock(mutex_); return offsets_.size(); }
 
 private:
 	mutable std::recursive_mutex mutex_;
 	int cache_index_ = 0;
 	int cache_step_ = 1;
-	std::vector<RMC_data> cache_;	// route cache (array of pionts)
+	bool reversed_ = false;			// course is turned by 180 degrees
+	double segment_time_ = 0.0;		// route time passed since the current point (sec)
+
+	utils::Mapped_file file_;
+	std::vector<size_t> offsets_;	// offsets of valid RMC sentences
+	size_t scan_pos_ = 0;			// file position indexed so far
 	NMEA_Parser parser_;
+
+	// Index RMC sentences until there are at least count of them (or the file ends)
+	void index_until(size_t count);
+	bool read_point(int index, RMC_data *out);
 };
\ No newline at end of file
@@ -1,4 +1,4 @@
-#include <sstream>
+#include <cstring>
 #include <stdexcept>
 
 #include "nmea_parser.hpp"
@@ -6,95 +6,492 @@
 using namespace std;
 
 
-// Checks if GGA sentence is valid.
-bool NMEA_Parser::is_valid_GGA(const string &GGASentence) const
+/*-----Auxiliary functions-----*/
+
+static int hex_digit(char ch)
 {
-	vector<std::string> elementVector = split_by_comma(GGASentence);
+	if((ch >= '0') && (ch <= '9')) return ch - '0';
+	if((ch >= 'A') && (ch <= 'F')) return ch - 'A' + 10;
+	if((ch >= 'a') && (ch <= 'f')) return ch - 'a' + 10;
 
-	if( (elementVector[0] != "$GPGGA") ||    
-		(elementVector.size() != 15) ||
-		(std::stoi(elementVector[6]) == 0) || 
-		(std::stoi(elementVector[7]) == 0) )
-	{
+	return -1;
+}
+
+static bool field_is(const NMEA_field &field, char ch)
+{
+	return (field.len == 1) && (field.ptr[0] == ch);
+}
+
+static bool field_to_uint(const NMEA_field &field, unsigned *out)
+{
+	if(field.empty() || (field.len > 9)){
+		return false;
+	}
+
+	unsigned val = 0;
+	for(size_t i = 0; i < field.len; ++i){
+		const char ch = field.ptr[i];
+		if((ch < '0') || (ch > '9')){
+			return false;
+		}
+
+		val = val * 10 + static_cast<unsigned>(ch - '0');
+	}
+
+	*out = val;
+
+	return true;
+}
+
+// Decimal number ("-12.345") without strtod - no locale dependency and no null terminator needed
+static bool field_to_double(const NMEA_field &field, double *out)
+{
+	static const double pow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+									1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18};
+
+	size_t i = 0;
+	bool negative = false;
+
+	if(field.empty()){
+		return false;
+	}
+
+	if((field.ptr[0] == '-') || (field.ptr[0] == '+')){
+		negative = (field.ptr[0] == '-');
+		++i;
+	}
+
+	uint64_t mantissa = 0;
+	size_t digits = 0;
+	size_t frac_digits = 0;
+	bool dot = false;
+
+	for(; i < field.len; ++i){
+		const char ch = field.ptr[i];
+
+		if(ch == '.'){
+			if(dot){
+				return false;
+			}
+
+			dot = true;
+			continue;
+		}
+
+		if((ch < '0') || (ch > '9')){
+			return false;
+		}
+
+		// Digits beyond double precision are dropped
+		if(digits < 18){
+			mantissa = mantissa * 10 + static_cast<uint64_t>(ch - '0');
+			++digits;
+			frac_digits += dot;
+		}
+		else if( !dot ){
+			return false;
+		}
+	}
+
+	if( !digits ){
 		return false;
 	}
 
+	double val = static_cast<double>(mantissa) / pow10[frac_digits];
+	*out = negative ? -val : val;
+
 	return true;
 }
 
-// Input: GGA NMEA_Parser sentence
-// Output: set values in class.
-// void NMEA_Parser::set_values_GGA(const string &GGA)
-// {
-// 	vector<std::string> elementVector = split_by_comma(GGA);
-// 	// Assert we have a GGA sentence
-// 	assert(elementVector[0] == "$GPGGA");
+// Optional numeric field: empty field gives zero
+static bool field_to_double_opt(const NMEA_field &field, double *out)
+{
+	if(field.empty()){
+		*out = 0.0;
+		return true;
+	}
+
+	return field_to_double(field, out);
+}
+
+// NMEA coordinates pair ([d]ddmm.mmmm + N/S/E/W) to microdegrees
+static bool fields_to_coord(const NMEA_tokens &tk, size_t idx, utils::Coord *out)
+{
+	const NMEA_field &lat = tk[idx];
+	const NMEA_field &lon = tk[idx + 2];
+
+	return (tk[idx + 1].len == 1) && (tk[idx + 3].len == 1) &&
+		utils::nmea_to_microdegrees(lat.ptr, lat.len, tk[idx + 1].ptr[0], &out->lat) &&
+		utils::nmea_to_microdegrees(lon.ptr, lon.len, tk[idx + 3].ptr[0], &out->lon);
+}
+
+template<size_t N>
+static void copy_field(char (&dst)[N], const NMEA_field &field)
+{
+	const size_t len = (field.len < N) ? field.len : N - 1;
+	memcpy(dst, field.ptr, len);
+	dst[len] = '\0';
+}
+
+static char mode_indicator(const NMEA_tokens &tk, size_t idx)
+{
+	return ((tk.size() > idx) && (tk[idx].len == 1)) ? tk[idx].ptr[0] : 0;
+}
+
+/*-----Tokenizer-----*/
+
+bool NMEA_tokens::tokenize(const char *sentence, size_t len)
+{
+	count_ = 0;
+
+	while(len && ((sentence[len - 1] == '\r') || (sentence[len - 1] == '\n'))){
+		--len;
+	}
+
+	// "$" + address + "*hh"
+	if((len < 9) || (sentence[0] != '$')){
+		return false;
+	}
+
+	uint8_t checksum = 0;
+	size_t begin = 1;
+	size_t i = 1;
+
+	for(; (i < len) && (sentence[i] != '*'); ++i){
+		const char ch = sentence[i];
+		checksum ^= static_cast<uint8_t>(ch);
+
+		if(ch == ','){
+			if(count_ == max_fields){
+				return false;
+			}
+
+			fields_[count_++] = NMEA_field{sentence + begin, i - begin};
+			begin = i + 1;
+		}
+	}
+
+	if(count_ == max_fields){
+		return false;
+	}
+
+	fields_[count_++] = NMEA_field{sentence + begin, i - begin};
+
+	// Checksum is exactly two hex digits at the end of the sentence
+	if(i + 3 != len){
+		return false;
+	}
+
+	const int hi = hex_digit(sentence[i + 1]);
+	const int lo = hex_digit(sentence[i + 2]);
+
+	if((hi < 0) || (lo < 0) || (static_cast<uint8_t>((hi << 4) | lo) != checksum)){
+		return false;
+	}
+
+	// Talker id (2 chars) + sentence formatter (3 chars)
+	return fields_[0].len == 5;
+}
+
+NMEA_type NMEA_tokens::type() const
+{
+	if( !count_ || (fields_[0].len != 5) ){
+		return NMEA_type::Invalid;
+	}
+
+	const char *formatter = fields_[0].ptr + 2;
 
-// 	this->UTC = atoi(elementVector[1].c_str());
-// 	this->latitude = get_coordinates(elementVector[2]);
-// 	if (elementVector[3] == "S") this->latitude  = -this->latitude;
-// 	this->longitude = get_coordinates(elementVector[4]);
-// 	if (elementVector[5] == "W") this->longitude  = -this->longitude;
-// 	this->altitude = std::stod(elementVector[9]);
-// 	this->numberSatellites = atoi(elementVector[7].c_str());
-// }
+	if( !memcmp(formatter, "RMC", 3) ) return NMEA_type::RMC;
+	if( !memcmp(formatter, "GGA", 3) ) return NMEA_type::GGA;
+	if( !memcmp(formatter, "GSA", 3) ) return NMEA_type::GSA;
+	if( !memcmp(formatter, "VTG", 3) ) return NMEA_type::VTG;
 
+	return NMEA_type::Unsupported;
+}
 
-// RMC sentence
+/*-----Sentences-----*/
 
 std::ostream& operator<< (std::ostream &os, const RMC_data &data)
 {
-	os << "valid: " << data.valid << " utc_time: " << data.utc_time << " date: " << data.date << 
-		" lat: " << data.latitude << " lon: " << data.longitude << " speed: " << data.speed <<
+	os << "valid: " << data.valid << " utc_time: " << data.utc_time << " date: " << data.date <<
+		" lat: " << utils::microdegrees_to_string(data.coord.lat) << " lon: " << utils::microdegrees_to_string(data.coord.lon) << " speed: " << data.speed <<
 		" course: " << data.course;
 
 	return os;
 }
 
-// Check if RMC sentence is valid with NMEA_Parser standard.
-bool NMEA_Parser::is_valid_RMC(const string &RMCSentence, vector<std::string> *elements) const
+// $GPRMC,time,status,lat,N,lon,E,speed,course,date,magvar,E[,mode[,navstatus]]*hh
+const char* NMEA_Parser::rmc_from_tokens(const NMEA_tokens &tk, RMC_data *out)
 {
-	vector<std::string> elementVector = split_by_comma(RMCSentence);
+	if(tk.size() < 12){
+		return "invalid RMC sentence size";
+	}
 
-	if(elementVector[0] != "$GPRMC"){
-		throw std::runtime_error("Invalid RMC sentence beginning (" + elementVector[0] + ")");
+	RMC_data res;
+
+	copy_field(res.utc_time, tk[1]);
+	copy_field(res.date, tk[9]);
+	res.mode = mode_indicator(tk, 12);
+	res.valid = field_is(tk[2], 'A') && (res.mode != 'N');
+
+	// Receiver without a fix leaves position fields empty
+	if( !tk[3].empty() || res.valid ){
+		if( !fields_to_coord(tk, 3, &res.coord) ){
+			return "invalid RMC coordinates";
+		}
 	}
 
-	if(elementVector.size() != 12){
-		throw std::runtime_error("Invalid RMC sentence size (" + RMCSentence + ")");
+	// Course is empty when standing on some receivers
+	if( !field_to_double_opt(tk[7], &res.speed) || !field_to_double_opt(tk[8], &res.course) ){
+		return "invalid RMC speed or course";
 	}
 
-	if(elements){
-		*elements = std::move(elementVector);
+	*out = res;
+
+	return nullptr;
+}
+
+// $GPGGA,time,lat,N,lon,E,quality,sats,hdop,alt,M,sep,M,age,station*hh
+const char* NMEA_Parser::gga_from_tokens(const NMEA_tokens &tk, GGA_data *out)
+{
+	if(tk.size() < 15){
+		return "invalid GGA sentence size";
 	}
 
-	return true;
+	GGA_data res;
+	unsigned quality = 0;
+	unsigned sats = 0;
+
+	copy_field(res.utc_time, tk[1]);
+
+	if( !field_to_uint(tk[6], &quality) || (!tk[7].empty() && !field_to_uint(tk[7], &sats)) ){
+		return "invalid GGA fix quality";
+	}
+
+	res.fix_quality = static_cast<uint8_t>(quality);
+	res.satellites = static_cast<uint8_t>(sats);
+	res.valid = (quality != 0);
+
+	if( !tk[2].empty() || res.valid ){
+		if( !fields_to_coord(tk, 2, &res.coord) ){
+			return "invalid GGA coordinates";
+		}
+	}
+
+	if( !field_to_double_opt(tk[8], &res.hdop) ||
+		!field_to_double_opt(tk[9], &res.altitude) ||
+		!field_to_double_opt(tk[11], &res.geoid_separation) )
+	{
+		return "invalid GGA dilution or altitude";
+	}
+
+	*out = res;
+
+	return nullptr;
 }
 
-RMC_data NMEA_Parser::parse_RMC(const string &RMCSentence) const
+// $GPGSA,selection,fix,prn1,...,prn12,pdop,hdop,vdop[,system]*hh
+const char* NMEA_Parser::gsa_from_tokens(const NMEA_tokens &tk, GSA_data *out)
+{
+	if(tk.size() < 18){
+		return "invalid GSA sentence size";
+	}
+
+	GSA_data res;
+	unsigned fix = 0;
+
+	res.selection = (tk[1].len == 1) ? tk[1].ptr[0] : 0;
+
+	if( !field_to_uint(tk[2], &fix) ){
+		return "invalid GSA fix type";
+	}
+
+	res.fix_type = static_cast<uint8_t>(fix);
+	res.valid = (fix >= 2);
+
+	for(size_t i = 0; i < GSA_data::max_prn; ++i){
+		unsigned prn = 0;
+
+		if(tk[3 + i].empty()){
+			continue;
+		}
+
+		if( !field_to_uint(tk[3 + i], &prn) ){
+			return "invalid GSA satellite id";
+		}
+
+		res.prn[res.prn_count++] = static_cast<uint8_t>(prn);
+	}
+
+	if( !field_to_double_opt(tk[15], &res.pdop) ||
+		!field_to_double_opt(tk[16], &res.hdop) ||
+		!field_to_double_opt(tk[17], &res.vdop) )
+	{
+		return "invalid GSA dilution";
+	}
+
+	*out = res;
+
+	return nullptr;
+}
+
+// $GPVTG,course,T,course_magnetic,M,speed,N,speed_kmh,K[,mode]*hh
+const char* NMEA_Parser::vtg_from_tokens(const NMEA_tokens &tk, VTG_data *out)
+{
+	if(tk.size() < 9){
+		return "invalid VTG sentence size";
+	}
+
+	VTG_data res;
+
+	res.mode = mode_indicator(tk, 9);
+
+	if( !field_to_double_opt(tk[1], &res.course) ||
+		!field_to_double_opt(tk[3], &res.course_magnetic) ||
+		!field_to_double_opt(tk[5], &res.speed) ||
+		!field_to_double_opt(tk[7], &res.speed_kmh) )
+	{
+		return "invalid VTG course or speed";
+	}
+
+	res.valid = !tk[5].empty() && (res.mode != 'N');
+
+	*out = res;
+
+	return nullptr;
+}
+
+const char* NMEA_Parser::tokenize(const char *sentence, size_t len, NMEA_type type, NMEA_tokens *tk)
+{
+	if( !tk->tokenize(sentence, len) ){
+		return "malformed sentence or checksum mismatch";
+	}
+
+	if(tk->type() != type){
+		return "unexpected sentence type";
+	}
+
+	return nullptr;
+}
+
+NMEA_type NMEA_Parser::parse(const char *sentence, size_t len)
+{
+	NMEA_tokens tk;
+
+	if( !tk.tokenize(sentence, len) ){
+		error_ = "malformed sentence or checksum mismatch";
+		return NMEA_type::Invalid;
+	}
+
+	const NMEA_type type = tk.type();
+	const char *err = nullptr;
+
+	switch(type){
+		case NMEA_type::RMC: err = rmc_from_tokens(tk, &rmc_); break;
+		case NMEA_type::GGA: err = gga_from_tokens(tk, &gga_); break;
+		case NMEA_type::GSA: err = gsa_from_tokens(tk, &gsa_); break;
+		case NMEA_type::VTG: err = vtg_from_tokens(tk, &vtg_); break;
+		default: break;
+	}
+
+	if(err){
+		error_ = err;
+		return NMEA_type::Invalid;
+	}
+
+	return type;
+}
+
+bool NMEA_Parser::parse_RMC(const char *sentence, size_t len, RMC_data *out) const
+{
+	NMEA_tokens tk;
+	return !tokenize(sentence, len, NMEA_type::RMC, &tk) && !rmc_from_tokens(tk, out);
+}
+
+bool NMEA_Parser::parse_GGA(const char *sentence, size_t len, GGA_data *out) const
+{
+	NMEA_tokens tk;
+	return !tokenize(sentence, len, NMEA_type::GGA, &tk) && !gga_from_tokens(tk, out);
+}
+
+bool NMEA_Parser::parse_GSA(const char *sentence, size_t len, GSA_data *out) const
 {
-	vector<std::string> elementVector;
+	NMEA_tokens tk;
+	return !tokenize(sentence, len, NMEA_type::GSA, &tk) && !gsa_from_tokens(tk, out);
+}
+
+bool NMEA_Parser::parse_VTG(const char *sentence, size_t len, VTG_data *out) const
+{
+	NMEA_tokens tk;
+	return !tokenize(sentence, len, NMEA_type::VTG, &tk) && !vtg_from_tokens(tk, out);
+}
+
+// Checks if GGA sentence is valid and has a fix
+bool NMEA_Parser::is_valid_GGA(const string &GGASentence) const
+{
+	GGA_data data;
+	return this->parse_GGA(GGASentence.data(), GGASentence.size(), &data) && data.valid;
+}
 
-	is_valid_RMC(RMCSentence, &elementVector);
+// Check if RMC sentence is valid with NMEA standard (any talker id, NMEA 2.2 - 4.1)
+bool NMEA_Parser::is_valid_RMC(const string &RMCSentence) const
+{
+	RMC_data data;
+	return this->parse_RMC(RMCSentence.data(), RMCSentence.size(), &data);
+}
 
+RMC_data NMEA_Parser::parse_RMC(const string &RMCSentence) const
+{
+	NMEA_tokens tk;
 	RMC_data output;
 
-	output.date = elementVector[9];
-	output.utc_time = elementVector[1];
-	output.latitude = get_dec_coordinate(elementVector[3], elementVector[4]);
-	output.longitude = get_dec_coordinate(elementVector[5], elementVector[6]);
-	output.speed = std::stod(elementVector[7]);
-	output.course = std::stod(elementVector[8]);
-	output.valid = (elementVector[2] == "A") ? true : false;
+	const char *err = tokenize(RMCSentence.data(), RMCSentence.size(), NMEA_type::RMC, &tk);
+	if( !err ){
+		err = rmc_from_tokens(tk, &output);
+	}
+
+	if(err){
+		throw std::runtime_error(std::string(err) + " (" + RMCSentence + ")");
+	}
 
 	return output;
 }
 
-/*-----Auxiliary functions-----*/
 
-// Input: coma separated string
-// Output: Vector with all the elements in input.
-vector<string> NMEA_Parser::split_by_comma(const string &input) const
+#ifdef _NMEA_BENCH
+
+#include <new>
+#include <cmath>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdlib>
+
+// Heap allocations counter
+static size_t alloc_count = 0;
+
+void* operator new(size_t size)
+{
+	++alloc_count;
+
+	void *p = malloc(size ? size : 1);
+	if( !p ){
+		throw std::bad_alloc();
+	}
+
+	return p;
+}
+
+void operator delete(void *p) noexcept
+{
+	free(p);
+}
+
+// Previous parser implementation (stringstream split + stod) as a baseline
+namespace legacy{
+
+static vector<string> split_by_comma(const string &input)
 {
 	vector<string> returnVector;
 	stringstream ss(input);
@@ -107,22 +504,176 @@ vector<string> NMEA_Parser::split_by_comma(const string &input) const
 	return returnVector;
 }
 
-double NMEA_Parser::degrees_to_decimal(int degrees, double minutes, int seconds)
-{
-	return static_cast<double>(degrees) + minutes / 60.0 + static_cast<double>(seconds) / 3600.0;
-}
-
-double NMEA_Parser::get_dec_coordinate(const std::string &nmea_coordinate, const std::string &quadrant) const
+static double get_dec_coordinate(const std::string &nmea_coordinate, const std::string &quadrant)
 {
 	size_t int_len = (nmea_coordinate.at(4) == '.') ? 2 : 3;
 
 	std::string degree_part = nmea_coordinate.substr(0, int_len);
 	std::string minutes_part = nmea_coordinate.substr(int_len);
 
-	double dec_degrees = degrees_to_decimal(std::stoi(degree_part), std::stod(minutes_part));
+	double dec_degrees = static_cast<double>(std::stoi(degree_part)) + std::stod(minutes_part) / 60.0;
 	if(quadrant == "S" || quadrant == "W"){
 		dec_degrees *= -1;
 	}
 
 	return dec_degrees;
 }
+
+static RMC_data parse_RMC(const string &RMCSentence)
+{
+	vector<std::string> elementVector = split_by_comma(RMCSentence);
+
+	if((elementVector[0].size() != 6) || (elementVector[0][0] != '$') || elementVector[0].compare(3, 3, "RMC")){
+		throw std::runtime_error("Invalid RMC sentence beginning (" + elementVector[0] + ")");
+	}
+
+	if((elementVector.size() != 12) && (elementVector.size() != 13)){
+		throw std::runtime_error("Invalid RMC sentence size (" + RMCSentence + ")");
+	}
+
+	RMC_data output;
+
+	strncpy(output.date, elementVector[9].c_str(), sizeof(output.date) - 1);
+	strncpy(output.utc_time, elementVector[1].c_str(), sizeof(output.utc_time) - 1);
+	output.coord = utils::Coord::from_degrees(get_dec_coordinate(elementVector[3], elementVector[4]),
+		get_dec_coordinate(elementVector[5], elementVector[6]));
+	output.speed = std::stod(elementVector[7]);
+	output.course = std::stod(elementVector[8]);
+	output.valid = (elementVector[2] == "A") ? true : false;
+
+	return output;
+}
+
+} // namespace legacy
+
+static double elapsed_ns(const std::chrono::steady_clock::time_point &start)
+{
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int bench_file(const string &file_path, int passes)
+{
+	std::ifstream in{file_path};
+	if( !in.is_open() ){
+		cerr << "could not open '" << file_path << "'" << endl;
+		return 1;
+	}
+
+	vector<string> lines;
+	vector<size_t> rmc_lines;
+	string tmp;
+
+	while(std::getline(in, tmp)){
+		while( !tmp.empty() && ((tmp.back() == '\r') || (tmp.back() == '\n')) ){
+			tmp.pop_back();
+		}
+
+		if(tmp.compare(0, 1, "$")){
+			continue;
+		}
+
+		if( !tmp.compare(3, 3, "RMC") ){
+			rmc_lines.push_back(lines.size());
+		}
+
+		lines.push_back(tmp);
+	}
+
+	// Results comparison
+	NMEA_Parser parser;
+	size_t mismatch = 0;
+
+	for(size_t idx : rmc_lines){
+		RMC_data a = legacy::parse_RMC(lines[idx]);
+		RMC_data b;
+
+		if( !parser.parse_RMC(lines[idx].data(), lines[idx].size(), &b) ||
+			(a.valid != b.valid) || strcmp(a.utc_time, b.utc_time) || strcmp(a.date, b.date) ||
+			(abs(a.coord.lat - b.coord.lat) > 1) || (abs(a.coord.lon - b.coord.lon) > 1) ||
+			(fabs(a.speed - b.speed) > 1e-9) || (fabs(a.course - b.course) > 1e-9) )
+		{
+			++mismatch;
+		}
+	}
+
+	// Legacy parser, RMC sentences only
+	volatile double sink = 0.0;
+	size_t allocs = alloc_count;
+	auto start = std::chrono::steady_clock::now();
+
+	for(int p = 0; p < passes; ++p){
+		for(size_t idx : rmc_lines){
+			sink = sink + legacy::parse_RMC(lines[idx]).coord.lat;
+		}
+	}
+
+	const double legacy_ns = elapsed_ns(start) / (passes * rmc_lines.size());
+	const double legacy_allocs = static_cast<double>(alloc_count - allocs) / (passes * rmc_lines.size());
+
+	// New parser, RMC sentences only
+	RMC_data rmc;
+	allocs = alloc_count;
+	start = std::chrono::steady_clock::now();
+
+	for(int p = 0; p < passes; ++p){
+		for(size_t idx : rmc_lines){
+			parser.parse_RMC(lines[idx].data(), lines[idx].size(), &rmc);
+			sink = sink + rmc.coord.lat;
+		}
+	}
+
+	const double rmc_ns = elapsed_ns(start) / (passes * rmc_lines.size());
+	const double rmc_allocs = static_cast<double>(alloc_count - allocs) / (passes * rmc_lines.size());
+
+	// New parser, whole stream (GGA + GSA + RMC ...)
+	size_t errors = 0;
+	allocs = alloc_count;
+	start = std::chrono::steady_clock::now();
+
+	for(int p = 0; p < passes; ++p){
+		for(const auto &line : lines){
+			errors += (parser.parse(line.data(), line.size()) == NMEA_type::Invalid);
+		}
+	}
+
+	const double stream_ns = elapsed_ns(start) / (passes * lines.size());
+	const double stream_allocs = static_cast<double>(alloc_count - allocs) / (passes * lines.size());
+
+	printf("%s: %zu sentences (%zu RMC), mismatches: %zu, stream errors: %zu\n",
+		file_path.c_str(), lines.size(), rmc_lines.size(), mismatch, errors / passes);
+	printf("  legacy RMC: %8.1f ns/sentence, %5.1f allocs/sentence\n", legacy_ns, legacy_allocs);
+	printf("  new RMC:    %8.1f ns/sentence, %5.1f allocs/sentence (x%.1f)\n", rmc_ns, rmc_allocs, legacy_ns / rmc_ns);
+	printf("  new stream: %8.1f ns/sentence, %5.1f allocs/sentence\n", stream_ns, stream_allocs);
+
+	return mismatch ? 1 : 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if(argc < 2){
+		cout << "Usage: " << argv[0] << " file.nmea [file.nmea ...] [-n passes]" << endl;
+		return 1;
+	}
+
+	int passes = 20;
+	int res = EXIT_SUCCESS;
+
+	for(int i = 1; i < argc; ++i){
+		if( !strcmp(argv[i], "-n") && (i + 1 < argc) ){
+			passes = atoi(argv[++i]);
+			continue;
+		}
+
+		try{
+			res |= bench_file(argv[i], (passes > 0) ? passes : 1);
+		}
+		catch(const std::exception &e){
+			cerr << e.what() << endl;
+			return 1;
+		}
+	}
+
+	return res;
+}
+
+#endif
@@ -1,9 +1,12 @@
 #pragma once
 
-#include <vector>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <iostream>
 
+#include "utils/geo.hpp"
+
 // Knots to Kilometers / Hour convertion
 constexpr double knots_to_kmh(double knots)
 {
@@ -18,46 +21,141 @@ constexpr double knots_to_mps(double knots)
 
 struct RMC_data
 {
-	std::string utc_time;
-	std::string date;
-	double latitude = 0.0;	// in decimal format
-	double longitude = 0.0;	// in decimal format
+	char utc_time[11] = {0};	// hhmmss.sss
+	char date[7] = {0};			// ddmmyy
+	utils::Coord coord;		// in microdegrees
 	double speed = 0.0;		// in knots
 	double course = 0.0;	// in degrees (0 - to the North, 90 - East, 180 - South, 270 - West)
+	char mode = 0;			// NMEA 2.3+ mode indicator (A - autonomous, D - differential, E - estimated, N - not valid), 0 if absent
 	bool valid = false;
 
 	friend std::ostream& operator<< (std::ostream &os, const RMC_data &data);
 };
 
-// TODO
 struct GGA_data
 {
-
+	char utc_time[11] = {0};	// hhmmss.sss
+	utils::Coord coord;		// in microdegrees
+	uint8_t fix_quality = 0;	// 0 - invalid, 1 - GPS, 2 - DGPS, 4/5 - RTK, 6 - estimated
+	uint8_t satellites = 0;		// satellites in use
+	double hdop = 0.0;
+	double altitude = 0.0;		// above mean sea level, meters
+	double geoid_separation = 0.0;	// meters
+	bool valid = false;
 };
 
-// TODO
 struct GSA_data
 {
+	static const size_t max_prn = 12;
+
+	char selection = 0;			// A - automatic, M - manual 2D/3D selection
+	uint8_t fix_type = 0;		// 1 - no fix, 2 - 2D, 3 - 3D
+	uint8_t prn[max_prn] = {0};	// PRNs of satellites used in solution
+	uint8_t prn_count = 0;
+	double pdop = 0.0;
+	double hdop = 0.0;
+	double vdop = 0.0;
+	bool valid = false;
+};
+
+struct VTG_data
+{
+	double course = 0.0;		// true course, degrees
+	double course_magnetic = 0.0;
+	double speed = 0.0;			// in knots
+	double speed_kmh = 0.0;
+	char mode = 0;				// NMEA 2.3+ mode indicator, 0 if absent
+	bool valid = false;
+};
+
+enum class NMEA_type: uint8_t
+{
+	Invalid = 0,	// malformed sentence or checksum mismatch
+	Unsupported,	// well-formed, but not parsed (GSV, TXT ...)
+	RMC,
+	GGA,
+	GSA,
+	VTG
+};
+
+// Sentence field. Points into the source sentence (not null terminated)
+struct NMEA_field
+{
+	NMEA_field(const char *p = nullptr, size_t l = 0): ptr(p), len(l) {}
+
+	const char *ptr;
+	size_t len;
+
+	bool empty() const { return len == 0; }
+};
+
+// In-place single pass tokenizer. Fields are located without copying,
+// the sentence must outlive the tokens
+class NMEA_tokens
+{
+public:
+	static const size_t max_fields = 24;
+
+	// Splits the sentence ("$" ... "*hh", trailing CR/LF allowed) by commas
+	// and validates the checksum. Field 0 is the address ("GPRMC").
+	// Returns false if the sentence is malformed or the checksum does not match
+	bool tokenize(const char *sentence, size_t len);
+
+	size_t size() const { return count_; }
+	const NMEA_field& operator[](size_t i) const { return fields_[i]; }
+
+	// Sentence formatter regardless of talker id ($GPRMC, $GNRMC ... -> RMC)
+	NMEA_type type() const;
 
+private:
+	NMEA_field fields_[max_fields];
+	size_t count_ = 0;
 };
 
 class NMEA_Parser
 {
 public:
+	/*
+	 * Stream interface. Parses any supported sentence and keeps it as the latest
+	 * one of its type, so a multi-sentence epoch (GGA + GSA + RMC ...) can be read
+	 * after its last sentence. No heap allocations.
+	 * Returns the type of parsed sentence, NMEA_type::Invalid on error (see error())
+	 */
+	NMEA_type parse(const char *sentence, size_t len);
+
+	const RMC_data& rmc() const { return rmc_; }
+	const GGA_data& gga() const { return gga_; }
+	const GSA_data& gsa() const { return gsa_; }
+	const VTG_data& vtg() const { return vtg_; }
+
+	// Description of the last parse() error
+	const char* error() const { return error_; }
+
+	// Single sentence parsing (no heap allocations). Return false if the sentence is invalid
+	bool parse_RMC(const char *sentence, size_t len, RMC_data *out) const;
+	bool parse_GGA(const char *sentence, size_t len, GGA_data *out) const;
+	bool parse_GSA(const char *sentence, size_t len, GSA_data *out) const;
+	bool parse_VTG(const char *sentence, size_t len, VTG_data *out) const;
 
-	// GGA sentences 
+	// GGA sentences
 	bool is_valid_GGA(const std::string &GGASentence) const;
-	
+
 	// RMC sentences
-	bool is_valid_RMC(const std::string &RMCSentence, std::vector<std::string> *elements = nullptr) const;
-	RMC_data parse_RMC(const std::string &RMCSentence) const;
+	bool is_valid_RMC(const std::string &RMCSentence) const;
+	RMC_data parse_RMC(const std::string &RMCSentence) const;	// throws std::runtime_error
 
 private:
-	// Auxualiary functions
-	std::vector<std::string> split_by_comma(const std::string&) const;
-	double get_dec_coordinate(const std::string &nmea_coordinate, const std::string &quadrant) const;
-
-	static double degrees_to_decimal(int degrees, double minutes, int seconds = 0);
-};
+	RMC_data rmc_;
+	GGA_data gga_;
+	GSA_data gsa_;
+	VTG_data vtg_;
+	const char *error_ = "";
 
+	// Return nullptr on success, otherwise error description
+	static const char* rmc_from_tokens(const NMEA_tokens &tk, RMC_data *out);
+	static const char* gga_from_tokens(const NMEA_tokens &tk, GGA_data *out);
+	static const char* gsa_from_tokens(const NMEA_tokens &tk, GSA_data *out);
+	static const char* vtg_from_tokens(const NMEA_tokens &tk, VTG_data *out);
 
+	static const char* tokenize(const char *sentence, size_t len, NMEA_type type, NMEA_tokens *tk);
+};
@@ -0,0 +1,169 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "map_match.hpp"
+
+namespace avi{
+
+static const double PI = 3.14159265358979;
+
+void Map_matcher::set_polyline(const std::vector<utils::Coord> &points)
+{
+	segments_.clear();
+	this->reset();
+
+	if(points.size() < 2){
+		return;
+	}
+
+	ref_ = points.front();
+	metric_ = utils::LocalMetric(ref_.lat);
+
+	double along = 0.0;
+
+	for(size_t i = 1; i < points.size(); ++i){
+		int64_t x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+		metric_.offset_cm(ref_, points[i - 1], &x0, &y0);
+		metric_.offset_cm(ref_, points[i], &x1, &y1);
+
+		segment seg;
+		seg.x = static_cast<double>(x0);
+		seg.y = static_cast<double>(y0);
+		seg.dx = static_cast<double>(x1 - x0);
+		seg.dy = static_cast<double>(y1 - y0);
+		seg.len = std::sqrt(seg.dx * seg.dx + seg.dy * seg.dy);
+
+		// Совпадающие точки не образуют отрезка
+		if(seg.len < 1.0){
+			continue;
+		}
+
+		seg.start_cm = static_cast<uint32_t>(along);
+		seg.course = std::fmod(std::atan2(seg.dx, seg.dy) * 180.0 / PI + 360.0, 360.0);
+		along += seg.len;
+
+		segments_.push_back(seg);
+	}
+}
+
+void Map_matcher::reset()
+{
+	tracking_ = false;
+	current_ = 0;
+	misses_ = 0;
+}
+
+uint32_t Map_matcher::length_cm() const
+{
+	return segments_.empty() ? 0 : segments_.back().start_cm + static_cast<uint32_t>(segments_.back().len);
+}
+
+bool Map_matcher::project(size_t i, double x, double y, double course, double *dist2, double *t) const
+{
+	const segment &seg = segments_[i];
+
+	if(course >= 0.0){
+		double diff = std::fabs(course - seg.course);
+		if(diff > 180.0){
+			diff = 360.0 - diff;
+		}
+
+		if(diff > params_.max_course_diff){
+			return false;
+		}
+	}
+
+	double k = ((x - seg.x) * seg.dx + (y - seg.y) * seg.dy) / (seg.len * seg.len);
+	k = std::max(0.0, std::min(1.0, k));
+
+	const double px = seg.x + seg.dx * k - x;
+	const double py = seg.y + seg.dy * k - y;
+
+	*dist2 = px * px + py * py;
+	*t = k;
+
+	return true;
+}
+
+Map_matcher::result Map_matcher::match(const utils::Coord &point, double course)
+{
+	result res;
+
+	if(segments_.empty()){
+		return res;
+	}
+
+	int64_t ix = 0, iy = 0;
+	metric_.offset_cm(ref_, point, &ix, &iy);
+	const double x = static_cast<double>(ix);
+	const double y = static_cast<double>(iy);
+
+	// После захвата - только окно вокруг текущего отрезка
+	size_t first = 0;
+	size_t last = segments_.size() - 1;
+
+	if(tracking_){
+		first = (current_ > params_.window_back) ? current_ - params_.window_back : 0;
+		last = std::min(last, current_ + params_.window_ahead);
+	}
+
+	double best_dist2 = std::numeric_limits<double>::max();
+	double best_t = 0.0;
+	size_t best = segments_.size();
+
+	for(size_t i = first; i <= last; ++i){
+		double dist2 = 0.0, t = 0.0;
+
+		if(this->project(i, x, y, course, &dist2, &t) && (dist2 < best_dist2)){
+			best_dist2 = dist2;
+			best_t = t;
+			best = i;
+		}
+	}
+
+	const double max_offset_cm = params_.max_offset_m * 100.0;
+
+	if((best == segments_.size()) || (best_dist2 > max_offset_cm * max_offset_cm)){
+		if(++misses_ >= params_.lost_fixes){
+			tracking_ = false;
+		}
+
+		return res;
+	}
+
+	const segment &seg = segments_[best];
+
+	tracking_ = true;
+	current_ = best;
+	misses_ = 0;
+
+	res.matched = true;
+	res.coord = metric_.shift(ref_, static_cast<int64_t>(seg.x + seg.dx * best_t), static_cast<int64_t>(seg.y + seg.dy * best_t));
+	res.along_cm = seg.start_cm + static_cast<uint32_t>(seg.len * best_t);
+	res.offset_cm = static_cast<uint32_t>(std::sqrt(best_dist2));
+	res.course = seg.course;
+
+	return res;
+}
+
+bool Map_matcher::point_at(uint32_t along_cm, utils::Coord *point, double *course) const
+{
+	if(segments_.empty()){
+		return false;
+	}
+
+	// Отрезок, содержащий точку (двоичный поиск по началам отрезков)
+	auto it = std::upper_bound(segments_.begin(), segments_.end(), along_cm,
+		[](uint32_t value, const segment &seg){ return value < seg.start_cm; });
+
+	const segment &seg = (it == segments_.begin()) ? segments_.front() : *(it - 1);
+	const double t = std::min(1.0, (along_cm - seg.start_cm) / seg.len);
+
+	*point = metric_.shift(ref_, static_cast<int64_t>(seg.x + seg.dx * t), static_cast<int64_t>(seg.y + seg.dy * t));
+	*course = seg.course;
+
+	return true;
+}
+
+} // namespace avi
@@ -0,0 +1,103 @@
+/*==============================================================================
+Описание: 	Модуль привязки GPS решений к линии маршрута (map-matching).
+
+			Линия маршрута (из таблицы геометрии НСИ либо по центрам зон
+			фреймов в порядке их следования) переводится в локальную плоскость
+			в сантиметрах. Решение проецируется на ближайший отрезок с
+			подходящим направлением. После захвата линии поиск ведется только
+			в окне отрезков вокруг текущего - постоянное время на решение.
+			Полный просмотр линии выполняется лишь при потере привязки.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "utils/geo.hpp"
+
+namespace avi{
+
+class Map_matcher
+{
+public:
+	struct params
+	{
+		double max_offset_m = 30.0;		// Наибольшее удаление решения от линии маршрута
+		double max_course_diff = 90.0;	// Наибольшее отклонение курса от направления отрезка
+		size_t window_back = 4;			// Окно поиска: отрезков до текущего
+		size_t window_ahead = 16;		// и после него
+		int lost_fixes = 3;				// Решений вне линии подряд до потери привязки
+	};
+
+	// Результат привязки
+	struct result
+	{
+		bool matched = false;
+		utils::Coord coord;			// Проекция решения на линию маршрута
+		uint32_t along_cm = 0;		// Расстояние вдоль маршрута от его начала
+		uint32_t offset_cm = 0;		// Удаление решения от линии
+		double course = 0.0;		// Направление отрезка (градусы)
+	};
+
+	void set_params(const params &p) { params_ = p; this->reset(); }
+	const params& get_params() const { return params_; }
+
+	// Линия маршрута (точки в порядке движения). Привязка сбрасывается
+	void set_polyline(const std::vector<utils::Coord> &points);
+
+	// Сброс привязки - следующее решение ищется по всей линии
+	void reset();
+
+	bool empty() const { return segments_.empty(); }
+	uint32_t length_cm() const;
+
+	/**
+	  * @описание   Привязка решения к линии маршрута
+	  * @параметры
+	  *     Входные:
+	  *         point - решение
+	  *         course - курс решения (< 0 - не учитывается)
+	 */
+	result match(const utils::Coord &point, double course = -1.0);
+
+	/**
+	  * @описание   Точка линии маршрута на заданном расстоянии от начала
+	  * @параметры
+	  *     Входные:
+	  *         along_cm - расстояние вдоль маршрута (ограничивается длиной линии)
+	  *     Выходные:
+	  *         point - точка
+	  *         course - направление отрезка (градусы)
+	  * @возвращает false, если линия не задана
+	 */
+	bool point_at(uint32_t along_cm, utils::Coord *point, double *course) const;
+
+private:
+	struct segment
+	{
+		double x = 0.0, y = 0.0;	// Начало (см): восток, север от ref_
+		double dx = 0.0, dy = 0.0;	// Вектор отрезка (см)
+		double len = 0.0;			// Длина (см)
+		uint32_t start_cm = 0;		// Расстояние от начала маршрута до начала отрезка
+		double course = 0.0;		// Направление (градусы)
+	};
+
+	params params_;
+	utils::Coord ref_;				// Начало локальной системы координат
+	utils::LocalMetric metric_;
+	std::vector<segment> segments_;
+
+	bool tracking_ = false;			// Привязка захвачена - поиск в окне
+	size_t current_ = 0;			// Текущий отрезок
+	int misses_ = 0;				// Решений вне линии подряд
+
+	// Проекция точки на отрезок, false - не подходит по курсу
+	bool project(size_t i, double x, double y, double course, double *dist2, double *t) const;
+};
+
+} // namespace avi
@@ -0,0 +1,246 @@
+#include <sys/stat.h>
+#include <cstdio>
+#include <functional>
+#include <unordered_set>
+
+#define LOG_MODULE_NAME		"[ MCH ]"
+#include "logger.hpp"
+
+#include "utils/fs.hpp"
+#include "utils/crypto.hpp"
+#include "utils/mp3.hpp"
+#include "announ.hpp"
+#include "media_cache.hpp"
+
+namespace avi{
+
+using mode = MediaPlayer::mode;
+
+// Прерываемость воспроизведения цепочки определяется родителем, поэтому
+// склеивать можно только части с одинаковым признаком прерываемости
+static bool is_uninterrupted(uint8_t play_mode)
+{
+	return (static_cast<mode>(play_mode) == mode::UNINTERRUPTED) ||
+		(static_cast<mode>(play_mode) == mode::UNINTERRUPTED_PARENT);
+}
+
+static bool is_parent(uint8_t play_mode)
+{
+	return (static_cast<mode>(play_mode) == mode::INTERRUPTED_PARENT) ||
+		(static_cast<mode>(play_mode) == mode::UNINTERRUPTED_PARENT);
+}
+
+static std::string chain_key(const std::string &filename, int id_next)
+{
+	return filename + "#" + std::to_string(id_next);
+}
+
+void MediaChainCache::init(const std::string &media_dir, const std::string &cache_dir)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	media_dir_ = media_dir;
+	cache_dir_ = cache_dir;
+	chains_.clear();
+}
+
+void MediaChainCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	job_.cancel();
+	chains_.clear();
+}
+
+bool MediaChainCache::make_stamp(const std::string &filename, part_stamp *stamp) const
+{
+	struct stat st;
+
+	if(filename.empty()){
+		return false;
+	}
+
+	if(stat((media_dir_ + "/" + filename).c_str(), &st) != 0){
+		return false;
+	}
+
+	stamp->filename = filename;
+	stamp->size = st.st_size;
+	stamp->mtime = st.st_mtime;
+	return true;
+}
+
+void MediaChainCache::collect_chains(std::vector<chain> &out) const
+{
+	for(const auto &head : NSIDatabase::get_parent_media_infos()){
+		chain ch;
+		part_stamp stamp;
+		std::unordered_set<int> visited;
+
+		// Фразы синтеза речи не склеиваются
+		if( !head.text.empty() || !make_stamp(head.filename, &stamp) ){
+			continue;
+		}
+		ch.parts.push_back(stamp);
+
+		const bool uninterrupted = is_uninterrupted(head.play_mode);
+		info curr = &head;
+
+		// Идем по потомкам пока они запускались бы сразу после окончания предыдущей части
+		while(is_parent(curr->play_mode) && (curr->id_next > -1) && (ch.parts.size() < max_chain_len)){
+			info child = NSIDatabase::get_media_info_of_child(curr->id_next);
+
+			if( !child || child->pause || !child->text.empty() || (static_cast<mode>(child->play_mode) == mode::QUEUED) ||
+				(is_uninterrupted(child->play_mode) != uninterrupted) || !visited.insert(curr->id_next).second ){
+				break;
+			}
+
+			if( !make_stamp(child->filename, &stamp) ){
+				break;
+			}
+
+			ch.parts.push_back(stamp);
+			ch.tail_id = curr->id_next;
+			curr = child;
+		}
+
+		if(ch.parts.size() < 2){
+			continue;
+		}
+
+		// Имя склеенного файла зависит от состава и версий частей - при обновлении
+		// медиа-контента цепочка будет склеена заново
+		std::string signature;
+		for(const auto &part : ch.parts){
+			signature += part.filename + ":" + std::to_string(part.size) + ":" + std::to_string(part.mtime) + ";";
+		}
+
+		ch.key = chain_key(head.filename, head.id_next);
+		ch.path = cache_dir_ + "/" + utils::md5sum(signature.c_str(), signature.size()) + ".mp3";
+		out.push_back(std::move(ch));
+	}
+}
+
+void MediaChainCache::build_async()
+{
+	std::vector<chain> chains;
+	std::string media_dir, cache_dir;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if(cache_dir_.empty()){
+			return;
+		}
+
+		media_dir = media_dir_;
+		cache_dir = cache_dir_;
+	}
+
+	// Состав цепочек определяем сразу (фреймы НСИ могут быть перезагружены
+	// во время фоновой склейки), тяжелую работу с файлами выносим в поток
+	this->collect_chains(chains);
+
+	if(chains.empty()){
+		log_msg(MSG_DEBUG, "No media chains to join\n");
+		return;
+	}
+
+	job_.start(std::bind(&MediaChainCache::build, this, std::move(chains), media_dir, cache_dir, std::placeholders::_1));
+}
+
+void MediaChainCache::build(const std::vector<chain> &chains, const std::string &media_dir, const std::string &cache_dir,
+	uint32_t generation)
+{
+	std::unordered_set<std::string> used_files;
+	size_t joined = 0;
+
+	for(const auto &ch : chains){
+
+		// Кеш был сброшен - результаты сборки больше не актуальны
+		if( !job_.is_current(generation) ){
+			log_msg(MSG_DEBUG, "Media chains build cancelled\n");
+			return;
+		}
+
+		used_files.insert(utils::get_file_name(ch.path));
+
+		try{
+			if( !utils::file_exists(ch.path) ){
+				std::vector<std::string> paths;
+				for(const auto &part : ch.parts){
+					paths.push_back(media_dir + "/" + part.filename);
+				}
+
+				utils::mp3_concat(paths, ch.path);
+				++joined;
+			}
+		}
+		catch(const std::exception &e){
+			log_warn("Could not join media chain '%s': %s\n", ch.parts.front().filename, e.what());
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(job_.is_current(generation)){
+			chains_[ch.key] = ch;
+		}
+	}
+
+	// Удаляем склеенные файлы цепочек, которых больше нет в текущем маршруте
+	try{
+		if( !job_.collect_garbage(cache_dir, used_files, generation) ){
+			log_msg(MSG_DEBUG, "Media chains build cancelled\n");
+			return;
+		}
+	}
+	catch(const std::exception &e){
+		log_warn("Could not clean media chains cache: %s\n", e.what());
+	}
+
+	log_msg(MSG_DEBUG | MSG_TO_FILE, "Media chains ready: %zu (joined now: %zu)\n", used_files.size(), joined);
+}
+
+bool MediaChainCache::find(info media, std::string *path, info *tail) const
+{
+	if( !media || !is_parent(media->play_mode) ){
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = chains_.find(chain_key(media->filename, media->id_next));
+	if(it == chains_.end()){
+		return false;
+	}
+
+	const chain &ch = it->second;
+
+	// Проверяем, что части цепочки не изменились после склейки
+	part_stamp stamp;
+	for(const auto &part : ch.parts){
+		if( !make_stamp(part.filename, &stamp) || !(stamp == part) ){
+			log_warn("Media chain '%s' is outdated\n", ch.parts.front().filename);
+			return false;
+		}
+	}
+
+	if( !utils::file_exists(ch.path) ){
+		return false;
+	}
+
+	info tail_media = NSIDatabase::get_media_info_of_child(ch.tail_id);
+	if( !tail_media ){
+		return false;
+	}
+
+	if(path){
+		*path = ch.path;
+	}
+
+	if(tail){
+		*tail = tail_media;
+	}
+
+	return true;
+}
+
+} // namespace avi
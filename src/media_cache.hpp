@@ -0,0 +1,95 @@
+/*==============================================================================
+Описание: 	Модуль кеша предварительно склеенных медиа-цепочек.
+
+			Фреймы с режимами INTERRUPTED_PARENT / UNINTERRUPTED_PARENT после
+			окончания воспроизведения ставят в очередь дочерний фрейм id_next.
+			Запуск потомка через колбек остановки приводит к слышимой паузе,
+			поэтому известные цепочки родитель -> потомки заранее склеиваются
+			по границам MP3 фреймов в один файл, который и воспроизводится.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+#include "app_db.hpp"
+#include "utils/cache_job.hpp"
+
+namespace avi{
+
+class MediaChainCache
+{
+	using info = const NSIDatabase::kFrames_table::MediaInfo*;
+
+public:
+	// Максимальное количество частей в одной цепочке
+	static const size_t max_chain_len = 8;
+
+	void init(const std::string &media_dir, const std::string &cache_dir);
+
+	// Сбросить известные цепочки (вызывается перед перезагрузкой фреймов НСИ -
+	// незавершенная фоновая сборка свои результаты уже не сохранит)
+	void clear();
+
+	// Запустить фоновую склейку цепочек для текущих фреймов маршрута
+	// (незавершенная предыдущая склейка отменяется)
+	void build_async();
+
+	// Остановка фоновой склейки с ожиданием ее завершения
+	void stop() { job_.stop(); }
+
+	/**
+	  * @описание   Поиск склеенного файла для цепочки, начинающейся с media
+	  * @параметры
+	  *     Входные:
+	  *         media - медиа-данные родительского фрейма
+	  *     Выходные:
+	  *         path - путь к склеенному файлу
+	  *         tail - медиа-данные последнего потомка, вошедшего в цепочку
+	  * @возвращает true если склеенный файл найден и части не изменялись
+	 */
+	bool find(info media, std::string *path, info *tail) const;
+
+private:
+	// Отпечаток части цепочки (для контроля изменения файлов)
+	struct part_stamp{
+		std::string filename;
+		uint64_t size = 0;
+		time_t mtime = 0;
+
+		bool operator==(const part_stamp &other) const {
+			return (filename == other.filename) && (size == other.size) && (mtime == other.mtime);
+		}
+	};
+
+	struct chain{
+		std::string key;				// Ключ цепочки (файл и потомок родителя)
+		std::vector<part_stamp> parts;	// Части в порядке воспроизведения
+		int tail_id = -1;				// Идентификатор последнего потомка в цепочке
+		std::string path;				// Путь к склеенному файлу
+	};
+
+	mutable std::mutex mutex_;
+	std::string media_dir_;
+	std::string cache_dir_;
+
+	// Имя файла родительского фрейма -> склеенная цепочка
+	std::unordered_map<std::string, chain> chains_;
+
+	// Фоновая склейка. Поколение увеличивается при каждом сбросе
+	utils::CacheJob job_;
+
+	bool make_stamp(const std::string &filename, part_stamp *stamp) const;
+	void collect_chains(std::vector<chain> &out) const;
+	void build(const std::vector<chain> &chains, const std::string &media_dir, const std::string &cache_dir, uint32_t generation);
+};
+
+} // namespace avi
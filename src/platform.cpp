@@ -13,6 +13,7 @@ extern "C"{
 }
 
 #include "utils/utility.hpp"
+#include "utils/mp3.hpp"
 #endif
 
 #include <cstring>
@@ -24,11 +25,20 @@ extern "C"{
 #include <condition_variable>
 #include <chrono>
 #include <atomic>
+#include <algorithm>
+#include <cmath>
 
 #include "logger.hpp"
 #include "utils/fs.hpp"
+#include "drivers/nmea_port.hpp"
+#include "nmea_parser.hpp"
+#include "gps_faults.hpp"
 #include "platform.hpp"
 
+#ifdef _PCM_AUDIO
+#include "drivers/pcm_audio.hpp"
+#endif
+
 
 namespace platform
 {
@@ -37,76 +47,165 @@ namespace platform
 
 static std::mutex lcd_mutex;
 
+#ifdef _PCM_AUDIO
+// Воспроизведение через PCM поток с декодированием MP3 внутри процесса 
+// (вместо SIMCOM audio_play_start() / AudioSimulator)
+static std::unique_ptr<hw::PCM_Audio> pcm_audio;
+static std::function<void(void)> pcm_audio_stop_cb;
+
+static void pcm_audio_init()
+{
+#ifndef _HOST_BUILD
+	std::unique_ptr<hw::PCM_sink> sink{new hw::ALSA_sink};
+#else
+	std::unique_ptr<hw::PCM_sink> sink{new hw::Null_sink};
+#endif
+
+	pcm_audio.reset(new hw::PCM_Audio(std::move(sink)));
+
+	pcm_audio->finished_callback = [](){
+		std::string err = pcm_audio->last_error();
+		if( !err.empty() ){
+			log_err("PCM audio: %s\n", err);
+		}
+
+		if(pcm_audio_stop_cb){
+			pcm_audio_stop_cb();
+		}
+	};
+}
+
+void audio_play(const std::string &mp3_path, uint32_t duration_ms)
+{
+	pcm_audio->play(mp3_path);
+}
+
+void audio_play_overlay(const std::string &mp3_path)
+{
+	pcm_audio->play_overlay(mp3_path);
+}
+
+bool audio_enqueue(const std::string &mp3_path)
+{
+	pcm_audio->enqueue(mp3_path);
+	return true;
+}
+
+bool audio_is_playing()
+{
+	return pcm_audio->is_playing();
+}
+
+void audio_setup_stop_callback(std::function<void(void)> func)
+{
+	pcm_audio_stop_cb = func;
+}
+
+void audio_stop()
+{
+	pcm_audio->stop();
+}
+#else
+void audio_play_overlay(const std::string &mp3_path)
+{
+	log_warn("Audio overlay is not supported by current audio backend. Ignoring '%s'\n", mp3_path);
+}
+
+// Очередь воспроизведения SIMCOM audio_play_start() / AudioSimulator не поддерживают -
+// следующий файл запускается из колбека окончания воспроизведения
+bool audio_enqueue(const std::string &mp3_path)
+{
+	return false;
+}
+#endif
+
 // Custom Format parser:
 //
 // [ 13.07.22 12:12:39 ] vld: 1, lat: 55.750317, long: 37.770050, crs: 147.60, spd: 17.96
 //
 // lat, long in dec degrees, speed in kmh
+// Track is read from the memory mapped file line by line (constant memory
+// regardless of the file size)
 class GPS_Track_Loader
 {
 public:
 
 	void load(const std::string &file_path)
 	{
-		std::ifstream in_file(file_path);
-
-		if( !in_file.is_open() ){
-			log_warn("%s couldn't open '%s': %s\n", excp_method(""), file_path, strerror(errno));
-			return;
+		try{
+			file_.open(file_path);
+		}
+		catch(const std::exception &e){
+			log_warn("%s %s\n", excp_method(""), e.what());
 		}
 
-		std::string line;
+		pos_ = 0;
+	}
 
-		while(std::getline(in_file, line)){
+	GPS_data get()
+	{
+		// At most one pass over the file - a file without valid lines gives no data
+		for(size_t scanned = 0; scanned <= file_.size(); ){
 
-			// Ignore time stamp
-			auto pos = line.find_last_of(']');
+			if(pos_ >= file_.size()){
+				if( !file_.size() ){
+					break;
+				}
 
-			if(pos == std::string::npos){
-				pos = -2;
+				log_warn("%s track finished. Starting from the beginning\n", excp_method(""));
+				pos_ = 0;
 			}
 
-			// printf("line: '%s'\n", line.substr(pos + 2).c_str());
-			try{
-				GPS_data data{line.substr(pos + 2)};
-			
-				cache_.push_back(std::move(data));
+			const char *line = nullptr;
+			size_t len = 0;
+			const size_t next = file_.line(pos_, &line, &len);
+			scanned += next - pos_;
+			pos_ = next;
 
-				// printf("added: %s, cache_size: %zu \n", data.to_string().c_str(), cache_.size());
+			if( !len ){
+				continue;
+			}
+
+			// Ignore time stamp
+			const char *begin = line;
+			for(const char *p = line + len; p != line; --p){
+				if(p[-1] == ']'){
+					begin = (p + 1 < line + len) ? p + 1 : line + len;
+					break;
+				}
+			}
+
+			try{
+				return GPS_data{std::string(begin, line + len)};
 			}
 			catch(const std::exception &e){
 				log_excp("%s\n", e.what());
 			}
 		}
-	}
 
-	GPS_data get()
-	{
-		GPS_data res;
-
-		if(cache_.empty()){
-			return res;
-		}
-
-		if(curr_idx_ >= cache_.size()){
-			log_warn("%s track finished. Starting from the beginning\n", excp_method(""));
-			curr_idx_ = 0;
-		}
-
-		res = cache_.at(curr_idx_);
-		// printf("GPS_data::get(%zu) : %s\n", curr_idx_, res.to_string().c_str());
-		++curr_idx_;
-		return res;
+		return GPS_data();
 	}
 
 private:
-	std::vector<GPS_data> cache_;
-	size_t curr_idx_ = 0;
+	utils::Mapped_file file_;
+	size_t pos_ = 0;
 };
 
 static std::unique_ptr<GPS_Generator> gps_nmea_gen = nullptr;
 static std::unique_ptr<GPS_Track_Loader> gps_track_gen = nullptr;
 
+// Интерполяция маршрута генератора (set_GPS_generator_rate)
+static double gps_gen_rate_hz = 0.0;
+static double gps_gen_time_scale = 1.0;
+static bool gps_gen_started = false;
+static std::chrono::steady_clock::time_point gps_gen_last;
+
+void set_GPS_generator_rate(double rate_hz, double time_scale)
+{
+	gps_gen_rate_hz = rate_hz;
+	gps_gen_time_scale = (time_scale > 0.0) ? time_scale : 1.0;
+}
+
 static void init_gps_generator(const std::string &file_path)
 {
 	if(gps_nmea_gen){
@@ -156,7 +255,19 @@ static GPS_data get_gps_generator_data()
 	if(gps_nmea_gen){
 		int curr_index = 0;
 
-		/*RMC_data*/ res = gps_nmea_gen->get_route_point(&curr_index);
+		if(gps_gen_rate_hz > 0.0){
+			// Время маршрута - по фактически прошедшему времени (период опроса может
+			// увеличиваться адаптацией частоты)
+			const auto now = monotonic_now();
+			const double dt = gps_gen_started ? std::chrono::duration<double>(now - gps_gen_last).count() : 0.0;
+			gps_gen_started = true;
+			gps_gen_last = now;
+
+			res = gps_nmea_gen->get_interpolated_point(dt * gps_gen_time_scale, &curr_index);
+		}
+		else{
+			/*RMC_data*/ res = gps_nmea_gen->get_route_point(&curr_index);
+		}
 
 		if((curr_index >= gps_nmea_gen->route_size()) || (curr_index < 0)){
 			log_info("RMC GPS generator route finished. Reversing.\n");
@@ -173,16 +284,346 @@ static GPS_data get_gps_generator_data()
 	return res;
 }
 
+// Получение координат опросом (генератор, AT+CGPSINFO или симулятор)
+static GPS_data poll_GPS_data();
+
+// Поток GPS данных: координаты публикуются подписчикам по мере поступления.
+// Источник - NMEA порт приемника (каждое RMC предложение), либо, если порт
+// не задан, периодический опрос poll_GPS_data()
+static std::mutex gps_subs_mutex;
+static std::vector<std::pair<int, gps_callback>> gps_subs;
+static int gps_subs_next_id = 0;
+
+static std::mutex gps_last_mutex;
+static GPS_data gps_last;
+
+static std::unique_ptr<hw::NMEA_port> gps_nmea_port;
+static NMEA_Parser gps_nmea_parser;
+
+static std::thread gps_poll_thread;
+static std::mutex gps_poll_mutex;
+static std::condition_variable gps_poll_cv;
+static bool gps_poll_exit = false;
+static bool gps_poll_period_changed = false;
+
+// Запрошенный период поступления данных (0 - собственная частота источника)
+static std::atomic<int> gps_period_ms{0};
+static std::chrono::steady_clock::time_point gps_last_publish;
+
+static std::atomic<uint64_t> gps_reads{0};
+static std::atomic<uint64_t> gps_published{0};
+static std::atomic<uint64_t> gps_skipped{0};
+
+// Неисправности GPS данных (тестирование устойчивости)
+static std::mutex gps_faults_mutex;
+static std::unique_ptr<GPS_fault_injector> gps_faults;
+
+// Индикация наличия валидных GPS данных светодиодом
+static void gps_indicate(bool valid)
+{
+	static bool was_valid = false;
+	// счетчик невалдиных данных (для защиты от дребезга моргания светодиодом)
+	static uint8_t valid_cnt = 3;
+
+	if(valid){
+		if( !was_valid ){
+			// Включаем светодиод - индикацию наличия валидных GPS данных
+			platform::set_LED(true);
+			was_valid = true;
+		}
+
+		valid_cnt = 3;
+	}
+	else{
+		if(valid_cnt && !(--valid_cnt)){
+			// Отключаем светодиод
+			platform::set_LED(false);
+		}
+
+		was_valid = false;
+	}
+}
+
+static void publish_GPS(const GPS_data &src)
+{
+	GPS_data data = src;
+
+	{
+		std::lock_guard<std::mutex> lock(gps_faults_mutex);
+		if(gps_faults && !gps_faults->apply(&data, monotonic_now())){
+			return;
+		}
+	}
+
+	++gps_published;
+
+	{
+		std::lock_guard<std::mutex> lock(gps_last_mutex);
+		gps_last = data;
+	}
+
+	gps_indicate(data.valid);
+
+	// Колбеки вызываются без блокировки - подписчик может отписаться из колбека
+	std::vector<std::pair<int, gps_callback>> subs;
+	{
+		std::lock_guard<std::mutex> lock(gps_subs_mutex);
+		subs = gps_subs;
+	}
+
+	for(const auto &sub : subs){
+		try{
+			sub.second(data);
+		}
+		catch(const std::exception &e){
+			log_excp("%s\n", e.what());
+		}
+	}
+}
+
+static void on_nmea_sentence(const char *sentence, size_t len)
+{
+	// Разбираются все предложения эпохи (GGA, GSA ...), публикуется решение
+	// по RMC - координаты, скорость и курс ($GPRMC, $GNRMC ...)
+	++gps_reads;
+	NMEA_type type = gps_nmea_parser.parse(sentence, len);
+
+	if(type == NMEA_type::Invalid){
+		// Искаженное предложение (ошибка контрольной суммы) пропускаем -
+		// отсутствие данных отслеживают подписчики
+		log_msg(MSG_TRACE, "NMEA sentence skipped (%s): %s\n", gps_nmea_parser.error(), sentence);
+		return;
+	}
+
+	if(type != NMEA_type::RMC){
+		return;
+	}
+
+	// Приемник выдает решения с постоянной частотой - при увеличенном периоде
+	// лишние пропускаем (допуск на неравномерность поступления - 50 мс)
+	const auto now = std::chrono::steady_clock::now();
+	const int period = gps_period_ms;
+
+	if((period > 0) && (now - gps_last_publish < std::chrono::milliseconds(period - 50))){
+		++gps_skipped;
+		return;
+	}
+
+	gps_last_publish = now;
+
+	// Предложение без решения (статус V, пустые поля) - координаты невалидны
+	publish_GPS(GPS_data(gps_nmea_parser.rmc()));
+}
+
+static void gps_source_start(int gps_poll_period_ms, const std::string &nmea_port)
+{
+	// Генераторы координат работают только в режиме опроса
+	if( !nmea_port.empty() && !gps_nmea_gen && !gps_track_gen ){
+		try{
+			std::unique_ptr<hw::NMEA_port> port{new hw::NMEA_port(nmea_port)};
+			port->start(on_nmea_sentence);
+			gps_nmea_port = std::move(port);
+
+			log_info("GPS data source: NMEA port '%s'\n", nmea_port);
+			return;
+		}
+		catch(const std::exception &e){
+			log_err("Could not open GPS NMEA port '%s': %s. Falling back to polling\n", nmea_port, e.what());
+		}
+	}
+
+	// Частота интерполирующего генератора заменяет период опроса
+	if(gps_nmea_gen && (gps_gen_rate_hz > 0.0)){
+		gps_poll_period_ms = std::max(1, static_cast<int>(std::lround(1000.0 / gps_gen_rate_hz)));
+		log_info("RMC GPS generator: %.1lf Hz, time scale %.2lf\n", gps_gen_rate_hz, gps_gen_time_scale);
+	}
+
+	if(gps_poll_period_ms <= 0){
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(gps_poll_mutex);
+		gps_poll_exit = false;
+	}
+
+	gps_poll_thread = std::thread([gps_poll_period_ms](){
+		auto next = std::chrono::steady_clock::now();
+
+		for(;;){
+			++gps_reads;
+			publish_GPS(poll_GPS_data());
+
+			const auto polled = next;
+			std::unique_lock<std::mutex> lock(gps_poll_mutex);
+
+			// Период может измениться во время ожидания - срок пересчитывается
+			for(;;){
+				gps_poll_period_changed = false;
+				next = polled + std::chrono::milliseconds(std::max(gps_poll_period_ms, gps_period_ms.load()));
+
+				if( !gps_poll_cv.wait_until(lock, next, [](){ return gps_poll_exit || gps_poll_period_changed; }) ){
+					break;
+				}
+
+				if(gps_poll_exit){
+					return;
+				}
+			}
+		}
+	});
+
+	log_info("GPS data source: polling every %d ms\n", gps_poll_period_ms);
+}
+
+static void gps_source_stop()
+{
+	if(gps_nmea_port){
+		gps_nmea_port->stop();
+
+		std::string err = gps_nmea_port->last_error();
+		if( !err.empty() ){
+			log_warn("GPS NMEA port: %s\n", err);
+		}
+
+		gps_nmea_port.reset();
+	}
+
+	if(gps_poll_thread.joinable()){
+		{
+			std::lock_guard<std::mutex> lock(gps_poll_mutex);
+			gps_poll_exit = true;
+		}
+
+		gps_poll_cv.notify_all();
+		gps_poll_thread.join();
+	}
+}
+
+void set_GPS_period(int period_ms)
+{
+	if(gps_period_ms.exchange(std::max(period_ms, 0)) == period_ms){
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(gps_poll_mutex);
+		gps_poll_period_changed = true;
+	}
+
+	gps_poll_cv.notify_all();
+}
+
+GPS_stats get_GPS_stats()
+{
+	GPS_stats res;
+	res.reads = gps_reads;
+	res.published = gps_published;
+	res.skipped = gps_skipped;
+
+	std::lock_guard<std::mutex> lock(gps_faults_mutex);
+	if(gps_faults){
+		const GPS_fault_injector::stats &st = gps_faults->get_stats();
+		res.dropped = st.dropped;
+		res.distorted = st.jumped + st.frozen + st.noised;
+	}
+
+	return res;
+}
+
+void set_GPS_faults(const std::string &profile)
+{
+	std::unique_ptr<GPS_fault_injector> faults;
+
+	if( !profile.empty() ){
+		faults.reset(new GPS_fault_injector(GPS_fault_profile::parse(profile)));
+		log_warn("GPS faults are injected: %s\n", faults->profile().to_string());
+	}
+
+	std::lock_guard<std::mutex> lock(gps_faults_mutex);
+	gps_faults = std::move(faults);
+}
+
+void inject_GPS_data(const GPS_data &data)
+{
+	++gps_reads;
+	publish_GPS(data);
+}
+
+static std::atomic<bool> virtual_time_enabled{false};
+static std::atomic<int64_t> virtual_time_ns{0};
+
+// Симулятор аудио отсчитывает длительность воспроизведения по виртуальным часам
+static void audio_virtual_time_changed(bool enabled);
+
+std::chrono::steady_clock::time_point monotonic_now()
+{
+	using namespace std::chrono;
+
+	if(virtual_time_enabled){
+		return steady_clock::time_point(duration_cast<steady_clock::duration>(nanoseconds(virtual_time_ns.load())));
+	}
+
+	return steady_clock::now();
+}
+
+void set_virtual_time(std::chrono::steady_clock::time_point tp)
+{
+	using namespace std::chrono;
+
+	virtual_time_ns = duration_cast<nanoseconds>(tp.time_since_epoch()).count();
+	virtual_time_enabled = true;
+	audio_virtual_time_changed(true);
+}
+
+void reset_virtual_time()
+{
+	audio_virtual_time_changed(false);
+	virtual_time_enabled = false;
+}
+
+bool virtual_time()
+{
+	return virtual_time_enabled;
+}
+
+int subscribe_GPS(gps_callback cb)
+{
+	std::lock_guard<std::mutex> lock(gps_subs_mutex);
+	gps_subs.emplace_back(gps_subs_next_id, cb);
+	return gps_subs_next_id++;
+}
+
+void unsubscribe_GPS(int id)
+{
+	std::lock_guard<std::mutex> lock(gps_subs_mutex);
+
+	gps_subs.erase(std::remove_if(gps_subs.begin(), gps_subs.end(), 
+		[id](const std::pair<int, gps_callback> &sub){ return sub.first == id; }), gps_subs.end());
+}
+
+GPS_data get_GPS_data()
+{
+	// При работе от потока NMEA возвращаем последние полученные данные
+	if(gps_nmea_port){
+		std::lock_guard<std::mutex> lock(gps_last_mutex);
+		return gps_last;
+	}
+
+	return poll_GPS_data();
+}
+
 // ------------- TARGET PART -------------
 #ifndef _HOST_BUILD
 
-void init(int gps_poll_period_ms, const std::string &gps_generator_file)
+void init(int gps_poll_period_ms, const std::string &gps_generator_file, const std::string &gps_nmea_port)
 {
 	Hardware::enable_AT();
 	Hardware::AT->init();
 
 	if(gps_generator_file.empty()){
-		bool increased_rate = gps_poll_period_ms < 1000;
+		// Поток NMEA всегда используем с частотой 10 Гц
+		bool increased_rate = (gps_poll_period_ms < 1000) || !gps_nmea_port.empty();
 		Hardware::AT->enable_GPS(increased_rate);
 		log_info("GPS is enabled with '%s' rate mode\n", increased_rate ? "100ms" : "1sec");
 	}
@@ -193,11 +634,17 @@ void init(int gps_poll_period_ms, const std::string &gps_generator_file)
 	Hardware::enable_audio();
 	Hardware::audio->set_audio_gain_level(3);
 
+#ifdef _PCM_AUDIO
+	pcm_audio_init();
+#endif
+
 	Hardware::enable_leds();
 	Hardware::enable_buttons();
 
 	Hardware::enable_lcd();
 	Hardware::lcd_init();
+
+	gps_source_start(gps_poll_period_ms, gps_nmea_port);
 }
 
 bool ready()
@@ -232,12 +679,8 @@ std::string get_IMEI()
 	return Hardware::AT->get_IMEI();
 }
 
-GPS_data get_GPS_data()
+static GPS_data poll_GPS_data()
 {
-	static bool was_valid = false;
-	// счетчик невалдиных данных (для защиты от дребезга моргания светодиодом)
-	static uint8_t valid_cnt = 3;	
-
 	try{
 
 		if(gps_nmea_gen || gps_track_gen){
@@ -247,27 +690,7 @@ GPS_data get_GPS_data()
 		hw::GPSinfo data = Hardware::AT->get_GPSinfo();
 
 		if(data.is_valid()){
-
-			if( !was_valid ){
-				// Включаем светодиод - индикацию наличия валидных GPS данных
-				platform::set_LED(true);
-				was_valid = true;
-			}
-
-			valid_cnt = 3;
-
-			std::pair<double, double> lat_lon = data.get_decimal_coordinates();
-			return GPS_data(data.get_utc_time(), lat_lon, data.get_speed(), data.get_course(), true);
-		}
-		else{
-			--valid_cnt;
-
-			if( !valid_cnt ){
-				// Отключаем светодиод
-				platform::set_LED(false);
-			}
-
-			was_valid = false;
+			return GPS_data(data.get_utc_time(), data.get_coord(), data.get_speed(), data.get_course(), true);
 		}
 	}
 	catch(const std::exception &e){
@@ -283,7 +706,8 @@ void set_LED(bool enable)
 	Hardware::leds[1].set_value(enable);
 }
 
-void audio_play(const std::string &mp3_path)
+#ifndef _PCM_AUDIO
+void audio_play(const std::string &mp3_path, uint32_t duration_ms)
 {
 	Hardware::audio->play(mp3_path);
 }
@@ -297,6 +721,7 @@ void audio_setup_stop_callback(std::function<void(void)> func)
 {
 	Hardware::audio->finished_callback = func;
 }
+#endif
 
 void audio_set_gain_level(int level)
 {
@@ -318,15 +743,25 @@ int audio_get_gain_level()
 	return res;
 }
 
+#ifndef _PCM_AUDIO
 void audio_stop()
 {
 	Hardware::audio->stop();
 }
+#endif
+
+static void audio_virtual_time_changed(bool enabled){}
 
 void deinit()
 {
+	gps_source_stop();
+
 	Hardware::AT->deinit();
 	platform::set_LED(false);
+
+#ifdef _PCM_AUDIO
+	pcm_audio.reset();
+#endif
 }
 
 // Buttons
@@ -476,15 +911,17 @@ public:
 				is_playing_.store(true);
 				stopped_.store(false);
 
-				// Duration = 20 * 250ms = 5 sec 
-				for(int i = 0; i < 40; ++i){
+				// Длительность "воспроизведения" равна реальной длительности файла
+				const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(duration_ms_);
+
+				while(std::chrono::steady_clock::now() < deadline){
 
 					if(stopped_.load() == true){
 						break;
 					}
 
-					// printf("LA %d\n", i);
-					std::this_thread::sleep_for(std::chrono::milliseconds(250));
+					std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(
+						std::chrono::milliseconds(50), deadline - std::chrono::steady_clock::now()));
 				}
 
 				is_playing_.store(false);
@@ -508,22 +945,77 @@ public:
 		return is_playing_.load();
 	}
 
-	void play(const std::string &file_path)
+	void play(const std::string &file_path, uint32_t duration_ms = 0)
 	{
 		if(this->is_playing()){
 			log_warn("AudioSimulator::play ignoring - already playing\n");
 			return;
 		}
 
+		// Длительность неизвестна - определяем по заголовкам фреймов
+		if( !duration_ms ){
+			try{
+				duration_ms = utils::mp3_file_info(file_path).duration_ms;
+			}
+			catch(const std::exception &e){
+				log_warn("AudioSimulator: %s\n", e.what());
+				duration_ms = default_duration_ms;
+			}
+		}
+
+		log_msg(MSG_TRACE, "AudioSimulator::play(%s, %u ms)\n", file_path, duration_ms);
+
+		// В виртуальном времени (воспроизведение трека) окончание отмечается
+		// при его изменении - в потоке, задающем время
+		if(virtual_time_enabled){
+			std::lock_guard<std::mutex> lock(mutex_);
+			virtual_deadline_ = monotonic_now() + std::chrono::milliseconds(duration_ms);
+			stopped_.store(false);
+			is_playing_.store(true);
+			return;
+		}
+
 		{
 			std::lock_guard<std::mutex> lock(mutex_);
 			wake_up_flag_ = true;
+			duration_ms_ = duration_ms;
 		}
 		
-		log_msg(MSG_TRACE, "AudioSimulator::play(%s)\n", file_path);
 		cv_play_.notify_one();
 	}
 
+	// Изменение виртуального времени: окончание "воспроизведения" по виртуальным часам
+	// или остановке. При отключении виртуального времени воспроизведение прекращается без колбека
+	void virtual_time_changed(bool enabled)
+	{
+		for(;;){
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if( !is_playing_.load() || !virtual_deadline_.time_since_epoch().count() ){
+					return;
+				}
+
+				if( !enabled ){
+					virtual_deadline_ = std::chrono::steady_clock::time_point();
+					is_playing_.store(false);
+					return;
+				}
+
+				if( !stopped_.load() && (monotonic_now() < virtual_deadline_) ){
+					return;
+				}
+
+				virtual_deadline_ = std::chrono::steady_clock::time_point();
+				is_playing_.store(false);
+			}
+
+			// Колбек может запустить следующий файл
+			if(stop_cb_){
+				stop_cb_();
+			}
+		}
+	}
+
 	void set_gain_level(int lvl) 
 	{ 
 		gain_level_ = lvl;
@@ -541,8 +1033,11 @@ private:
 	std::mutex mutex_;
 	std::condition_variable cv_play_;
 	bool wake_up_flag_ = false;
+	static const uint32_t default_duration_ms = 10000;
+	uint32_t duration_ms_ = default_duration_ms;
 	std::atomic<bool> is_playing_{false};
 	std::atomic<bool> stopped_{false};
+	std::chrono::steady_clock::time_point virtual_deadline_;	// Окончание в виртуальном времени (0 - воспроизведение в реальном)
 	stop_callback stop_cb_ = nullptr;
 	int gain_level_ = 0;
 };
@@ -859,18 +1354,24 @@ private:
 static AudioSimulator audio_sim;
 static InterfaceSimulator iface_sim;
 
-void init(int gps_poll_period_ms, const std::string &gps_generator_file)
+void init(int gps_poll_period_ms, const std::string &gps_generator_file, const std::string &gps_nmea_port)
 {
 	if( !gps_generator_file.empty() ){
 		init_gps_generator(gps_generator_file);
 	}
 
+#ifdef _PCM_AUDIO
+	pcm_audio_init();
+#endif
+
 	try{
 		iface_sim.init();
 	}
 	catch(const std::exception &e){
 		log_excp("%s\n", e.what());
 	}
+
+	gps_source_start(gps_poll_period_ms, gps_nmea_port);
 }
 
 bool ready() { return true; }
@@ -880,13 +1381,13 @@ std::string get_IMEI()
 	return "mahachkala";
 }
 
-GPS_data get_GPS_data()
+static GPS_data poll_GPS_data()
 {
 	if(gps_nmea_gen || gps_track_gen){
 		return get_gps_generator_data();
 	}
 	
-	return GPS_data("", {0.123456, 9.876543}, 0.1, 0.0, false);
+	return GPS_data("", {123456, 9876543}, 0.1, 0.0, false);
 }
 
 void set_LED(bool enable)
@@ -894,9 +1395,10 @@ void set_LED(bool enable)
 	log_msg(MSG_VERBOSE, _YELLOW "LED %s" _RESET "\n", enable ? "On" : "Off"); 
 }
 
-void audio_play(const std::string &mp3)
+#ifndef _PCM_AUDIO
+void audio_play(const std::string &mp3, uint32_t duration_ms)
 {
-	audio_sim.play(mp3);
+	audio_sim.play(mp3, duration_ms);
 }
 
 bool audio_is_playing()
@@ -908,6 +1410,7 @@ void audio_setup_stop_callback(std::function<void(void)> func)
 {
 	audio_sim.set_stop_callback(func);
 }
+#endif
 
 void audio_set_gain_level(int value)
 {
@@ -919,10 +1422,17 @@ int audio_get_gain_level()
 	return audio_sim.get_gain_level();
 }
 
+#ifndef _PCM_AUDIO
 void audio_stop()
 {
 	audio_sim.stop();
 }
+#endif
+
+static void audio_virtual_time_changed(bool enabled)
+{
+	audio_sim.virtual_time_changed(enabled);
+}
 
 // Buttons
 void set_button_cb(button_t id, button_callback short_press, button_callback long_press)
@@ -1011,7 +1521,12 @@ void lcd_print_custom_char(uint8_t location)
 
 void deinit()
 {
+	gps_source_stop();
 	platform::set_LED(false);
+
+#ifdef _PCM_AUDIO
+	pcm_audio.reset();
+#endif
 }
 
 #endif // #ifndef _HOST_BUILD
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <chrono>
 #include "gps_gen.hpp"			// RMC_data
+#include "utils/geo.hpp"		// utils::Coord
 #include "drivers/lcd1602.hpp"	// LCD1602::Alignment
 #include "drivers/gpio.hpp"		// hw::Button::callback
 
@@ -15,22 +18,23 @@ struct GPS_data
 {
 	GPS_data() = default;
 	GPS_data(const std::string &dtime, 
-				 const std::pair<double, double> &dec_lat_lon, 
+				 const utils::Coord &crd, 
 				 double spd,
 				 double crs,
 				 bool vld = false):
-		date_time(dtime), lat_lon(dec_lat_lon), speed_kmh( knots_to_kmh(spd) ), course(crs), valid(vld) {}
+		date_time(dtime), coord(crd), speed_kmh( knots_to_kmh(spd) ), course(crs), valid(vld) {}
 
-	GPS_data(const RMC_data &rmc): lat_lon({rmc.latitude, rmc.longitude}), speed_kmh( knots_to_kmh(rmc.speed) ),
-		course(rmc.course), valid(rmc.valid) { date_time = rmc.date + "_" + rmc.utc_time; }
+	GPS_data(const RMC_data &rmc): coord(rmc.coord), speed_kmh( knots_to_kmh(rmc.speed) ),
+		course(rmc.course), valid(rmc.valid) { date_time = std::string(rmc.date) + "_" + rmc.utc_time; }
 
 	GPS_data(const std::string &str){ this->from_string(str); }
 
 	std::string to_string() const
 	{
 		char buf[128] = {0};
-		snprintf(buf, sizeof(buf), "vld: %d, lat: %.6lf, long: %.6lf, crs: %.2lf, spd: %.2lf", 
-			static_cast<int>(this->valid), this->lat_lon.first, this->lat_lon.second, this->course, this->speed_kmh);
+		snprintf(buf, sizeof(buf), "vld: %d, lat: %s, long: %s, crs: %.2lf, spd: %.2lf", 
+			static_cast<int>(this->valid), utils::microdegrees_to_string(this->coord.lat).c_str(), 
+			utils::microdegrees_to_string(this->coord.lon).c_str(), this->course, this->speed_kmh);
 
 		std::string res{buf};
 
@@ -40,11 +44,17 @@ struct GPS_data
 	void from_string(const std::string &str)
 	{
 		int tmp = 0;
+		int pos_lat = 0;
+		int pos_lon = 0;
 
-		int res = sscanf(str.c_str(), "vld: %d, lat: %lf, long: %lf, crs: %lf, spd: %lf", 
-			&tmp, &this->lat_lon.first, &this->lat_lon.second, &this->course, &this->speed_kmh);
+		// Координаты записаны с точностью до микроградуса - разбираются без преобразования в double
+		int res = sscanf(str.c_str(), "vld: %d, lat: %n%*[^,], long: %n%*[^,], crs: %lf, spd: %lf", 
+			&tmp, &pos_lat, &pos_lon, &this->course, &this->speed_kmh);
 
-		if(res <= 0){
+		if( (res <= 0) || !pos_lat || !pos_lon ||
+			!utils::parse_microdegrees(str.c_str() + pos_lat, str.size() - pos_lat, &this->coord.lat) ||
+			!utils::parse_microdegrees(str.c_str() + pos_lon, str.size() - pos_lon, &this->coord.lon) )
+		{
 			throw std::runtime_error(excp_method("failed to parse " + str));
 		}
 
@@ -52,22 +62,72 @@ struct GPS_data
 	}
 
 	std::string date_time;
-	std::pair<double, double> lat_lon{0.0, 0.0};	// in decimal format
+	utils::Coord coord;		// координаты в микроградусах
 	double speed_kmh = 0.0;	// in kilometers per hour
 	double course = 0.0;	// in degrees (0 - to the North, 90 - East, 180 - South, 270 - West)
 	bool valid = false;
 };
 
-void init(int gps_poll_period_ms, const std::string &gps_generator_file = "");
+using gps_callback = std::function<void(const GPS_data &data)>;
+
+// gps_nmea_port - порт потока NMEA приемника. Если не задан (или задан генератор
+// координат) - координаты получаются опросом с периодом gps_poll_period_ms
+void init(int gps_poll_period_ms, const std::string &gps_generator_file = "", const std::string &gps_nmea_port = "");
+
+// Режим генератора координат .rmc (задается до init): решения интерполируются между
+// точками маршрута и выдаются с частотой rate_hz (заменяет gps_poll_period_ms),
+// время маршрута идет в time_scale раз быстрее реального. rate_hz <= 0 - точки
+// маршрута выдаются без интерполяции с периодом опроса
+void set_GPS_generator_rate(double rate_hz, double time_scale = 1.0);
 bool ready();
 void deinit();
 
 std::string get_IMEI();
 GPS_data get_GPS_data();
 
+// Подписка на получение GPS данных по мере их поступления (колбек вызывается
+// из потока источника данных). Возвращает идентификатор подписки
+int subscribe_GPS(gps_callback cb);
+void unsubscribe_GPS(int id);
+
+// Период поступления GPS данных подписчикам (адаптивная частота).
+// 0 - собственная частота источника (gps_poll_period_ms или каждое решение NMEA потока).
+// При опросе увеличивает период опроса, при работе от NMEA потока - прореживает решения
+void set_GPS_period(int period_ms);
+
+// Счетчики активности источника GPS данных (с момента запуска)
+struct GPS_stats
+{
+	uint64_t reads = 0;			// Опросов источника (AT+CGPSINFO, генератор) или принятых NMEA предложений
+	uint64_t published = 0;		// Решений, переданных подписчикам
+	uint64_t skipped = 0;		// Решений, пропущенных из-за увеличенного периода
+	uint64_t dropped = 0;		// Решений, отброшенных профилем неисправностей
+	uint64_t distorted = 0;		// Решений, искаженных профилем неисправностей
+};
+
+GPS_stats get_GPS_stats();
+
+// Профиль неисправностей GPS данных ("name[,key=value...]", см. GPS_fault_profile),
+// вносимых между источником данных и подписчиками. Пустая строка - отключение.
+// Исключения: std::invalid_argument
+void set_GPS_faults(const std::string &profile);
+
+// Передать решение подписчикам так же, как от источника GPS данных
+// (воспроизведение записанного трека)
+void inject_GPS_data(const GPS_data &data);
+
+// Монотонное время обработки GPS данных. При воспроизведении трека
+// задается виртуальное время (set_virtual_time), иначе - steady_clock
+std::chrono::steady_clock::time_point monotonic_now();
+void set_virtual_time(std::chrono::steady_clock::time_point tp);
+void reset_virtual_time();
+bool virtual_time();		// Задано виртуальное время
+
 void set_LED(bool enable);
 
-void audio_play(const std::string &mp3);
+void audio_play(const std::string &mp3, uint32_t duration_ms = 0);	// duration_ms - длительность файла, если известна
+void audio_play_overlay(const std::string &mp3);	// Наложение сигнала поверх текущего воспроизведения
+bool audio_enqueue(const std::string &mp3);			// Воспроизведение без паузы после текущего файла, false - не поддерживается
 bool audio_is_playing();
 void audio_setup_stop_callback(std::function<void(void)> func);
 void audio_set_gain_level(int value);
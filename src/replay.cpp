@@ -0,0 +1,449 @@
+#include <ctime>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <stdexcept>
+
+#define LOG_MODULE_NAME		"[ RPL ]"
+#include "logger.hpp"
+
+#include "utils/fs.hpp"
+#include "nmea_parser.hpp"
+#include "track_log.hpp"
+#include "announ.hpp"
+#include "replay.hpp"
+
+namespace avi{
+
+void Replay_engine::load(const std::string &path)
+{
+	points_.clear();
+
+	const std::string extension = utils::file_extension(path);
+
+	if((extension == ".nmea") || (extension == ".rmc")){
+		this->load_nmea(path);
+	}
+	else if(extension == ".track"){
+		this->load_text_track(path);
+	}
+	else if(extension == ".trk"){
+		this->load_binary_track(path);
+	}
+	else{
+		throw std::runtime_error(excp_method("unsupported track format '" + extension + "'"));
+	}
+
+	// Время отсчитывается от первого решения
+	if( !points_.empty() ){
+		const double start = points_.front().t_sec;
+		for(auto &pt : points_){
+			pt.t_sec -= start;
+		}
+	}
+
+	log_info("Track '%s' loaded: %zu points, %.1lf sec\n", path, points_.size(), this->duration_sec());
+}
+
+void Replay_engine::load_nmea(const std::string &path)
+{
+	std::ifstream in(path);
+	if( !in.is_open() ){
+		throw std::runtime_error(excp_method("could not open '" + path + "': " + strerror(errno)));
+	}
+
+	NMEA_Parser parser;
+	std::string line;
+
+	while(std::getline(in, line)){
+		if( !line.empty() && (line.back() == '\r') ){
+			line.pop_back();
+		}
+
+		if(parser.parse(line.c_str(), line.size()) != NMEA_type::RMC){
+			continue;
+		}
+
+		const RMC_data &rmc = parser.rmc();
+		struct tm tm_info;
+		memset(&tm_info, 0, sizeof(tm_info));
+		double sec = 0.0;
+
+		// Время hhmmss.sss, дата ddmmyy. Решение без времени пропускаем
+		if((sscanf(rmc.utc_time, "%2d%2d%lf", &tm_info.tm_hour, &tm_info.tm_min, &sec) != 3) ||
+			(sscanf(rmc.date, "%2d%2d%2d", &tm_info.tm_mday, &tm_info.tm_mon, &tm_info.tm_year) != 3))
+		{
+			continue;
+		}
+
+		tm_info.tm_mon -= 1;
+		tm_info.tm_year += 100;
+
+		point pt;
+		pt.t_sec = static_cast<double>(timegm(&tm_info)) + sec;
+		pt.data = platform::GPS_data(rmc);
+		points_.push_back(pt);
+	}
+}
+
+void Replay_engine::load_text_track(const std::string &path)
+{
+	std::ifstream in(path);
+	if( !in.is_open() ){
+		throw std::runtime_error(excp_method("could not open '" + path + "': " + strerror(errno)));
+	}
+
+	std::string line;
+
+	while(std::getline(in, line)){
+		struct tm tm_info;
+		memset(&tm_info, 0, sizeof(tm_info));
+		auto pos = line.find_last_of(']');
+
+		if((pos == std::string::npos) || (sscanf(line.c_str(), "[ %d.%d.%d %d:%d:%d", &tm_info.tm_mday, &tm_info.tm_mon,
+			&tm_info.tm_year, &tm_info.tm_hour, &tm_info.tm_min, &tm_info.tm_sec) != 6))
+		{
+			continue;
+		}
+
+		tm_info.tm_mon -= 1;
+		tm_info.tm_year += 100;
+
+		try{
+			point pt;
+			pt.t_sec = static_cast<double>(timegm(&tm_info));
+			pt.data = platform::GPS_data(line.substr(pos + 2));
+			points_.push_back(pt);
+		}
+		catch(const std::exception &e){
+			log_warn("%s\n", e.what());
+		}
+	}
+
+	// Метки времени лога с точностью до секунды - равномерно распределяем
+	// решения внутри одной секунды
+	for(size_t i = 0; i < points_.size(); ){
+		size_t j = i;
+		while((j < points_.size()) && (points_[j].t_sec == points_[i].t_sec)){
+			++j;
+		}
+
+		for(size_t k = i; k < j; ++k){
+			points_[k].t_sec += static_cast<double>(k - i) / (j - i);
+		}
+
+		i = j;
+	}
+}
+
+void Replay_engine::load_binary_track(const std::string &path)
+{
+	const size_t bad_blocks = Track_log::read(path, [this](const Track_log::record &rec){
+		point pt;
+		pt.t_sec = rec.unix_ms / 1000.0;
+		pt.data.coord = rec.coord;
+		pt.data.speed_kmh = rec.speed_ckmh / 100.0;
+		pt.data.course = rec.course_cdeg / 100.0;
+		pt.data.valid = rec.valid;
+		points_.push_back(pt);
+	});
+
+	if(bad_blocks){
+		log_warn("Track '%s': %zu damaged blocks skipped\n", path, bad_blocks);
+	}
+}
+
+std::vector<Replay_engine::event> Replay_engine::run(Announcement_task &task, double speed)
+{
+	using namespace std::chrono;
+
+	std::vector<event> events;
+
+	if(points_.empty()){
+		return events;
+	}
+
+	// Виртуальное время начинается с текущего, чтобы состояние задачи,
+	// инициализированной в реальном времени, оставалось согласованным
+	const steady_clock::time_point start = steady_clock::now();
+	const auto virtual_time = [start](double t_sec){
+		return start + duration_cast<steady_clock::duration>(duration<double>(t_sec));
+	};
+
+	const point *curr = nullptr;
+
+	task.set_frame_callback([&events, &curr](int frame_id, const NSIDatabase::kFrames_table::MediaInfo *minfo){
+		event ev;
+		ev.t_sec = curr->t_sec;
+		ev.coord = curr->data.coord;
+		ev.frame_id = frame_id;
+
+		if(minfo){
+			ev.filename = minfo->filename;
+			ev.text = minfo->text;
+		}
+
+		events.push_back(ev);
+	});
+
+	// Проигрыватель и дисплей разбирают события по виртуальным часам в этом
+	// потоке (с периодами своих задач), симулятор аудио отсчитывает по ним
+	// длительность файлов - очередь и прерывания воспроизведения те же, что
+	// в реальном времени
+	task.player_task_.stop();
+	task.lcd_task_.stop();
+	task.player_task_.wait();
+	task.lcd_task_.wait();
+
+	platform::set_virtual_time(start);
+
+	const auto period_sec = [](const Background_task &t){
+		return (t.get_period().count() > 0) ? duration<double>(t.get_period()).count() : 1.0;
+	};
+
+	const double task_period = period_sec(task);
+	const double player_period = period_sec(task.player_task_);
+	const double lcd_period = period_sec(task.lcd_task_);
+	double next_tick = task_period;
+	double next_player = player_period;
+	double next_lcd = lcd_period;
+
+	// Такты задач до момента t_sec в порядке времени
+	const auto advance = [&](double t_sec){
+		for(;;){
+			const double next = std::min(next_tick, std::min(next_player, next_lcd));
+			if(next > t_sec){
+				break;
+			}
+
+			platform::set_virtual_time(virtual_time(next));
+			task.mplayer_.start_pending();
+
+			if(next_player == next){
+				task.player_task_.drain();
+				next_player += player_period;
+			}
+
+			if(next_lcd == next){
+				task.lcd_task_.drain();
+				next_lcd += lcd_period;
+			}
+
+			// Основная функция задачи (контроль отсутствия данных)
+			if(next_tick == next){
+				task.main_func();
+				next_tick += task_period;
+			}
+		}
+
+		platform::set_virtual_time(virtual_time(t_sec));
+	};
+
+	const auto finish = [&task](){
+		task.set_frame_callback(nullptr);
+		platform::reset_virtual_time();
+		task.player_task_.start();
+		task.lcd_task_.start();
+	};
+
+	const steady_clock::time_point real_start = steady_clock::now();
+
+	try{
+		for(const auto &pt : points_){
+			advance(pt.t_sec);
+
+			if(speed > 0.0){
+				std::this_thread::sleep_until(real_start + duration_cast<steady_clock::duration>(duration<double>(pt.t_sec / speed)));
+			}
+
+			curr = &pt;
+			platform::inject_GPS_data(pt.data);
+		}
+	}
+	catch(...){
+		finish();
+		throw;
+	}
+
+	finish();
+
+	return events;
+}
+
+void Replay_engine::print_report(const std::vector<event> &events, FILE *out)
+{
+	size_t entered = 0;
+
+	for(const auto &ev : events){
+		const int sec = static_cast<int>(ev.t_sec);
+
+		if(ev.frame_id < 0){
+			fprintf(out, "%02d:%02d:%02d.%d  exit\n", sec / 3600, sec / 60 % 60, sec % 60, static_cast<int>(ev.t_sec * 10) % 10);
+			continue;
+		}
+
+		++entered;
+		fprintf(out, "%02d:%02d:%02d.%d  frame %5d  lat %s  lon %s  %s\n", sec / 3600, sec / 60 % 60, sec % 60,
+			static_cast<int>(ev.t_sec * 10) % 10, ev.frame_id, utils::microdegrees_to_string(ev.coord.lat).c_str(),
+			utils::microdegrees_to_string(ev.coord.lon).c_str(),
+			!ev.text.empty() ? ("\"" + ev.text + "\"").c_str() : (!ev.filename.empty() ? ev.filename.c_str() : "-"));
+	}
+
+	fprintf(out, "Frames fired: %zu\n", entered);
+}
+
+Replay_engine::comparison Replay_engine::compare(const std::vector<event> &reference, const std::vector<event> &events, double window_sec)
+{
+	comparison res;
+	std::vector<bool> used(events.size(), false);
+	double latency_sum = 0.0;
+
+	for(const auto &ref : reference){
+		if(ref.frame_id < 0){
+			continue;
+		}
+
+		++res.reference;
+
+		// Ближайший по времени несопоставленный вход в тот же фрейм
+		size_t best = events.size();
+		for(size_t i = 0; i < events.size(); ++i){
+			if(used[i] || (events[i].frame_id != ref.frame_id) || (std::fabs(events[i].t_sec - ref.t_sec) > window_sec)){
+				continue;
+			}
+
+			if((best == events.size()) || (std::fabs(events[i].t_sec - ref.t_sec) < std::fabs(events[best].t_sec - ref.t_sec))){
+				best = i;
+			}
+		}
+
+		if(best == events.size()){
+			++res.missed;
+			continue;
+		}
+
+		used[best] = true;
+
+		const double latency = events[best].t_sec - ref.t_sec;
+		latency_sum += latency;
+		res.latency_min_sec = res.matched ? std::min(res.latency_min_sec, latency) : latency;
+		res.latency_max_sec = res.matched ? std::max(res.latency_max_sec, latency) : latency;
+		++res.matched;
+	}
+
+	for(size_t i = 0; i < events.size(); ++i){
+		if((events[i].frame_id >= 0) && !used[i]){
+			++res.false_entries;
+		}
+	}
+
+	if(res.matched){
+		res.latency_avg_sec = latency_sum / res.matched;
+	}
+
+	return res;
+}
+
+void Replay_engine::print_comparison(const comparison &cmp, FILE *out)
+{
+	fprintf(out, "Reference entries: %zu, matched: %zu, missed: %zu, false: %zu\n", cmp.reference, cmp.matched,
+		cmp.missed, cmp.false_entries);
+	fprintf(out, "Latency: avg %.2lf sec, min %.2lf sec, max %.2lf sec\n", cmp.latency_avg_sec, cmp.latency_min_sec,
+		cmp.latency_max_sec);
+}
+
+} // namespace avi
+
+
+#ifdef _REPLAY_TEST
+
+#include <iostream>
+
+#include "app.hpp"
+
+using namespace std;
+using namespace avi;
+
+// Проверка НСИ по записанному треку: replay.test nsi.db route_id track [speed] [fault_profile].
+// С профилем неисправностей трек воспроизводится дважды - без неисправностей (эталон)
+// и с ними, выводится сравнение срабатываний
+int main(int argc, char* argv[])
+{
+	if(argc < 4){
+		cout << "Usage: " << argv[0] << " nsi.db route_id track.{nmea,rmc,track,trk} [speed, 0 - as fast as possible] "
+			"[GPS fault profile: clean, urban, tunnel, frozen, lowspeed, harsh [,key=value...]]" << endl;
+		return 1;
+	}
+
+	const double speed = (argc > 4) ? atof(argv[4]) : 0.0;
+	const string faults = (argc > 5) ? argv[5] : "";
+
+	logger.init(MSG_INFO, "replay.test.log", 0, KB_to_B(512));
+
+	try{
+		NSIDatabase::set_path(argv[1]);
+		if( !NSIDatabase::open() ){
+			throw runtime_error("could not open NSI database '" + string(argv[1]) + "'");
+		}
+
+		NSIDatabase::read();
+		NSIDatabase::select_route(atoi(argv[2]));
+		NSIDatabase::reload_route_frames();
+
+		Replay_engine engine;
+		engine.load(argv[3]);
+
+		// Журнал трека воспроизведения пишется рядом с исходным треком
+		unique_ptr<AVI> app{new AVI};
+		app->dirs.gps_track_path = string(argv[3]) + ".replay.trk";
+
+		// Каждый прогон - с новой задачей (состояние фильтра и текущего фрейма)
+		const auto replay = [&](const string &profile){
+			platform::set_GPS_faults(profile);
+
+			Announcement_task task(app.get(), "Replay");
+			task.set_period(chrono::milliseconds(1000));
+			task.init(&app->dirs.media_dir);
+
+			const auto started = chrono::steady_clock::now();
+			vector<Replay_engine::event> events = engine.run(task, speed);
+			const double elapsed = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+			task.stop();
+			task.wait();
+
+			const platform::GPS_stats stats = platform::get_GPS_stats();
+			platform::set_GPS_faults("");
+
+			Replay_engine::print_report(events);
+			printf("Replayed %zu points (%.1lf sec of track) in %.2lf sec", engine.size(), engine.duration_sec(), elapsed);
+			if( !profile.empty() ){
+				printf(", GPS faults '%s': %llu fixes dropped, %llu distorted", profile.c_str(),
+					static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.distorted));
+			}
+			printf("\n");
+
+			return events;
+		};
+
+		const vector<Replay_engine::event> reference = replay("");
+
+		if( !faults.empty() ){
+			printf("\n");
+			const vector<Replay_engine::event> events = replay(faults);
+
+			printf("\n");
+			Replay_engine::print_comparison(Replay_engine::compare(reference, events));
+		}
+	}
+	catch(const exception &e){
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,108 @@
+/*==============================================================================
+Описание: 	Модуль воспроизведения записанного GPS трека в виртуальном времени.
+
+			Решения трека передаются подписчикам источника GPS данных
+			(platform::inject_GPS_data) с исходными метками времени, задача
+			оповещения работает в виртуальном времени (platform::set_virtual_time),
+			ее основная функция, проигрыватель и дисплей вызываются с периодами
+			своих задач по виртуальным часам. Симулятор аудио отсчитывает по ним
+			длительность файлов, паузы перед медиа - тоже по виртуальным часам
+			(аудио-бэкенд PCM воспроизводит в реальном времени). Воспроизведение
+			выполняется в N раз быстрее реального времени либо без пауз -
+			проверка НСИ по треку занимает секунды.
+
+			Поддерживаемые форматы трека:
+				.nmea, .rmc	- предложения NMEA (время - из RMC)
+				.track		- текстовый лог координат ("[ dd.mm.yy hh:mm:ss ] vld: ...")
+				.trk		- двоичный журнал трека (Track_log)
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "platform.hpp"
+
+namespace avi{
+
+class Announcement_task;
+
+class Replay_engine
+{
+public:
+	struct point
+	{
+		double t_sec = 0.0;			// Время от начала трека
+		platform::GPS_data data;
+	};
+
+	// Срабатывание фрейма
+	struct event
+	{
+		double t_sec = 0.0;			// Время от начала трека
+		int frame_id = -1;			// -1 - выход из зоны
+		std::string filename;		// Воспроизводимый файл (пусто - нет медиа)
+		std::string text;			// Фраза синтеза речи
+		utils::Coord coord;			// Координаты решения
+	};
+
+	/**
+	  * @описание   Загрузка трека (формат определяется расширением файла)
+	  * @исключения std::runtime_error
+	 */
+	void load(const std::string &path);
+
+	size_t size() const { return points_.size(); }
+	double duration_sec() const { return points_.empty() ? 0.0 : points_.back().t_sec; }
+	const std::vector<point>& points() const { return points_; }
+
+	/**
+	  * @описание   Воспроизведение трека
+	  * @параметры
+	  *     Входные:
+	  *         task - инициализированная задача оповещения
+	  *         speed - ускорение относительно реального времени (0 - без пауз)
+	  * @возвращает срабатывания фреймов
+	 */
+	std::vector<event> run(Announcement_task &task, double speed = 0.0);
+
+	static void print_report(const std::vector<event> &events, FILE *out = stdout);
+
+	// Сравнение срабатываний с эталонными (тот же трек без неисправностей GPS данных)
+	struct comparison
+	{
+		size_t reference = 0;			// Входов в зоны эталона
+		size_t matched = 0;				// Входов, совпавших с эталоном
+		size_t missed = 0;				// Пропущенных входов
+		size_t false_entries = 0;		// Ложных входов
+		double latency_avg_sec = 0.0;	// Запаздывание совпавших входов относительно эталона
+		double latency_min_sec = 0.0;
+		double latency_max_sec = 0.0;
+	};
+
+	/**
+	  * @описание   Сопоставление входов в зоны по идентификатору фрейма
+	  * @параметры
+	  *     Входные:
+	  *         reference - эталонные срабатывания
+	  *         events - проверяемые срабатывания
+	  *         window_sec - наибольшее расхождение времени совпадающих входов
+	 */
+	static comparison compare(const std::vector<event> &reference, const std::vector<event> &events, double window_sec = 15.0);
+	static void print_comparison(const comparison &cmp, FILE *out = stdout);
+
+private:
+	std::vector<point> points_;
+
+	void load_nmea(const std::string &path);
+	void load_text_track(const std::string &path);
+	void load_binary_track(const std::string &path);
+};
+
+} // namespace avi
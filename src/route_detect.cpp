@@ -0,0 +1,267 @@
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+
+#define LOG_MODULE_NAME		"[ RDT ]"
+#include "logger.hpp"
+
+#include "route_detect.hpp"
+
+namespace avi{
+
+void Route_detector::load(std::vector<std::pair<int, main_frames>> &&routes)
+{
+	routes_.clear();
+	zones_.clear();
+	grid_.clear();
+
+	for(auto &elem : routes){
+		route_state route;
+		route.route_id = elem.first;
+		route.frames = std::move(elem.second);
+
+		const uint32_t route_idx = static_cast<uint32_t>(routes_.size());
+
+		for(size_t i = 0; i < route.frames.size(); ++i){
+			if( !route.frames[i].zone ){
+				continue;
+			}
+
+			utils::Coord min, max;
+			route.frames[i].zone->bounds(&min, &max);
+			grid_.add(static_cast<uint32_t>(zones_.size()), min, max, route.frames[i].zone->course_bitmap());
+			zones_.emplace_back(route_idx, static_cast<uint32_t>(i));
+		}
+
+		routes_.push_back(std::move(route));
+	}
+
+	hit_pos_.assign(routes_.size(), -1);
+	this->reset();
+}
+
+void Route_detector::reset()
+{
+	for(auto &route : routes_){
+		route.last_pos = -1;
+		route.score = 0.0;
+		route.score_time = 0.0;
+	}
+}
+
+double Route_detector::get_score(int route_id) const
+{
+	for(const auto &route : routes_){
+		if(route.route_id == route_id){
+			return route.score;
+		}
+	}
+
+	return 0.0;
+}
+
+void Route_detector::add_score(route_state &route, double value, double time_sec)
+{
+	// Забывание: счет уменьшается вдвое за forget_sec
+	if(params_.forget_sec > 0.0){
+		route.score *= std::pow(0.5, std::max(0.0, time_sec - route.score_time) / params_.forget_sec);
+	}
+
+	route.score = std::max(0.0, route.score + value);
+	route.score_time = time_sec;
+}
+
+int Route_detector::process(const platform::GPS_data &data, double time_sec)
+{
+	if(zones_.empty() || !data.valid || (data.speed_kmh < params_.min_speed_kmh)){
+		return -1;
+	}
+
+	// Только зоны ячейки, в которую попадает решение, с сектором текущего курса
+	found_.clear();
+	grid_.query(data.coord, data.coord, &found_, (data.course >= 0.0) ? NSIDatabase::kFrames_table::Zone::course_to_bitmask(data.course) : 0);
+
+	if(found_.empty()){
+		return -1;
+	}
+
+	// Порядок предпочтения зон маршрута, содержащих решение: текущая,
+	// следующая по порядку, любая другая
+	const auto rank = [this](const route_state &route, int pos){
+		if(pos == route.last_pos){
+			return 0;
+		}
+
+		return ((route.last_pos >= 0) && (pos > route.last_pos) && (pos - route.last_pos <= params_.max_skip)) ? 1 : 2;
+	};
+
+	bool hit = false;
+	for(uint32_t idx : found_){
+		const auto &ref = zones_[idx];
+		const route_state &route = routes_[ref.first];
+
+		if( !route.frames[ref.second].zone->contains(data.coord, data.course) ){
+			continue;
+		}
+
+		const int pos = static_cast<int>(ref.second);
+		int &best = hit_pos_[ref.first];
+
+		if((best < 0) || (rank(route, pos) < rank(route, best)) || ((rank(route, pos) == rank(route, best)) && (pos < best))){
+			best = pos;
+		}
+
+		hit = true;
+	}
+
+	if( !hit ){
+		return -1;
+	}
+
+	for(size_t i = 0; i < routes_.size(); ++i){
+		const int pos = hit_pos_[i];
+		if(pos < 0){
+			continue;
+		}
+
+		hit_pos_[i] = -1;
+		route_state &route = routes_[i];
+
+		if(pos == route.last_pos){
+			// Решение все еще в пройденной зоне
+			continue;
+		}
+
+		switch(rank(route, pos)){
+			case 1:
+				// Следующая зона по порядку маршрута
+				this->add_score(route, 2.0, time_sec);
+				break;
+
+			default:
+				// Первая зона маршрута либо зона не по порядку (другое
+				// направление, другой маршрут по тем же улицам)
+				this->add_score(route, (route.last_pos < 0) ? 1.0 : -2.0, time_sec);
+				break;
+		}
+
+		route.last_pos = pos;
+	}
+
+	// Лидер и второй по счету маршрут на момент решения
+	const route_state *leader = nullptr;
+	double best = 0.0, second = 0.0;
+
+	for(const auto &route : routes_){
+		const double score = (params_.forget_sec > 0.0) ?
+			route.score * std::pow(0.5, std::max(0.0, time_sec - route.score_time) / params_.forget_sec) : route.score;
+
+		if(score > best){
+			second = best;
+			best = score;
+			leader = &route;
+		}
+		else if(score > second){
+			second = score;
+		}
+	}
+
+	if(leader && (best >= params_.min_score) && (best - second >= params_.margin)){
+		return leader->route_id;
+	}
+
+	return -1;
+}
+
+void RouteDetect_task::init(mode m, detect_callback cb)
+{
+	mode_ = m;
+	detect_cb_ = cb;
+	loaded_ = false;
+	proposed_ = -1;
+
+	{
+		std::lock_guard<std::mutex> lock(data_mutex_);
+		has_data_ = false;
+	}
+
+	processing_ = true;
+
+	// В потоке источника GPS данных - только копия последнего решения
+	if(gps_sub_id_ < 0){
+		gps_sub_id_ = platform::subscribe_GPS([this](const platform::GPS_data &data){
+			if(processing_){
+				std::lock_guard<std::mutex> lock(data_mutex_);
+				data_ = data;
+				has_data_ = true;
+			}
+		});
+	}
+}
+
+void RouteDetect_task::unsubscribe()
+{
+	processing_ = false;
+
+	if(gps_sub_id_ > -1){
+		platform::unsubscribe_GPS(gps_sub_id_);
+		gps_sub_id_ = -1;
+	}
+}
+
+Background_task::signal RouteDetect_task::main_func(void)
+{
+	using namespace std::chrono;
+
+	if(this->get_current_state() == Background_task::signal::STOP){
+		return Background_task::signal::STOP;
+	}
+
+	// Фреймы всех маршрутов загружаются в потоке задачи, а не вызывающего
+	if( !loaded_ ){
+		detector_.load(NSIDatabase::read_all_route_frames());
+		loaded_ = true;
+
+		if(detector_.empty()){
+			log_warn("No route zones in NSI, route detection is disabled\n");
+			this->unsubscribe();
+			return Background_task::signal::STOP;
+		}
+
+		log_info("Route detection started (routes: %zu, mode: %d)\n", detector_.routes_num(), static_cast<int>(mode_));
+	}
+
+	platform::GPS_data data;
+	{
+		std::lock_guard<std::mutex> lock(data_mutex_);
+		if( !has_data_ ){
+			return Background_task::signal::SLEEP;
+		}
+
+		data = data_;
+		has_data_ = false;
+	}
+
+	const double now_sec = duration<double>(platform::monotonic_now().time_since_epoch()).count();
+	const int route_id = detector_.process(data, now_sec);
+
+	if((route_id < 0) || (route_id == proposed_)){
+		return Background_task::signal::SLEEP;
+	}
+
+	log_info("Route %d detected by trajectory (score: %.1lf)\n", route_id, detector_.get_score(route_id));
+	proposed_ = route_id;
+
+	if(detect_cb_){
+		detect_cb_(route_id, mode_);
+	}
+
+	if(mode_ == SELECT){
+		this->unsubscribe();
+		return Background_task::signal::STOP;
+	}
+
+	return Background_task::signal::SLEEP;
+}
+
+} // namespace avi
@@ -0,0 +1,140 @@
+/*==============================================================================
+Описание: 	Модуль определения маршрута по траектории движения.
+
+			Основные фреймы всех маршрутов НСИ держатся в памяти с общим
+			пространственным индексом зон. Каждое решение (не чаще раза в
+			секунду) проверяется только по зонам своей ячейки индекса, после
+			чего счет маршрута обновляется по порядку пройденных зон:
+			следующая по порядку зона маршрута добавляет очки, зона не по
+			порядку - отнимает. Маршрут определен, когда его счет достиг
+			порога и отрывается от второго по счету маршрута.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <utility>
+#include <functional>
+
+#include "bg_task.hpp"
+#include "platform.hpp"
+#include "zone_index.hpp"
+#include "app_db.hpp"
+
+namespace avi{
+
+class Route_detector
+{
+public:
+	using main_frames = NSIDatabase::kFrames_table::main_frames;
+
+	struct params
+	{
+		double min_score = 6.0;		// Счет, с которого маршрут может быть определен
+		double margin = 4.0;		// Наименьший отрыв от второго по счету маршрута
+		int max_skip = 8;			// Наибольшее число пропущенных зон между соседними по порядку
+		double forget_sec = 600.0;	// Время уменьшения счета вдвое (забывание старой траектории)
+		double min_speed_kmh = 5.0;	// Решения на стоянке не учитываются (курс не установился)
+	};
+
+	void set_params(const params &p) { params_ = p; this->reset(); }
+
+	// Фреймы маршрутов (идентификатор маршрута -> основные фреймы по порядку следования)
+	void load(std::vector<std::pair<int, main_frames>> &&routes);
+
+	bool empty() const { return zones_.empty(); }
+	size_t routes_num() const { return routes_.size(); }
+
+	// Сброс счета всех маршрутов
+	void reset();
+
+	/**
+	  * @описание   Учет очередного решения
+	  * @параметры
+	  *     Входные:
+	  *         data - решение
+	  *         time_sec - монотонное время решения (сек)
+	  * @возвращает идентификатор определенного маршрута, -1 - маршрут не определен
+	 */
+	int process(const platform::GPS_data &data, double time_sec);
+
+	// Текущий счет маршрута (0 - маршрут не найден)
+	double get_score(int route_id) const;
+
+private:
+	struct route_state
+	{
+		int route_id = -1;
+		main_frames frames;
+		int last_pos = -1;			// Порядковый номер последней пройденной зоны
+		double score = 0.0;
+		double score_time = 0.0;	// Время последнего изменения счета
+	};
+
+	params params_;
+	std::vector<route_state> routes_;
+	std::vector<std::pair<uint32_t, uint32_t>> zones_;	// Индекс в grid_ -> (маршрут, фрейм)
+	ZoneGrid grid_;
+
+	// Буферы одного решения (без выделения памяти на каждое решение)
+	std::vector<uint32_t> found_;
+	std::vector<int> hit_pos_;		// Маршрут -> наименьший порядковый номер зоны, содержащей решение
+
+	void add_score(route_state &route, double value, double time_sec);
+};
+
+// Фоновая задача определения маршрута, пока маршрут не выбран.
+// Решения принимаются из потока источника GPS данных, обрабатывается
+// только последнее - не чаще периода задачи
+class RouteDetect_task final: public Background_task
+{
+public:
+	enum mode
+	{
+		OFF = 0,
+		PROPOSE,	// Предложить маршрут (первым в меню выбора)
+		SELECT		// Выбрать маршрут автоматически
+	};
+
+	// Маршрут определен. Вызывается из потока задачи, после вызова задача
+	// завершается (в режиме PROPOSE - продолжает для другого маршрута)
+	using detect_callback = std::function<void(int route_id, mode m)>;
+
+	RouteDetect_task(const std::string &task_name = "RouteDetect_task"): Background_task(task_name) {}
+
+	void init(mode m, detect_callback cb);
+
+	void stop() override {
+		this->unsubscribe();
+		Background_task::stop();
+	}
+
+	void cancel() override {
+		this->unsubscribe();
+		Background_task::cancel();
+	}
+
+private:
+	mode mode_ = OFF;
+	detect_callback detect_cb_;
+	Route_detector detector_;
+	bool loaded_ = false;
+	int proposed_ = -1;		// Последний предложенный маршрут
+
+	std::mutex data_mutex_;
+	std::atomic<bool> processing_{false};
+	int gps_sub_id_ = -1;
+	bool has_data_ = false;
+	platform::GPS_data data_;
+
+	Background_task::signal main_func(void) override;
+	void unsubscribe();
+};
+
+} // namespace avi
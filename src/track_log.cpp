@@ -0,0 +1,360 @@
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define LOG_MODULE_NAME		"[ TRK ]"
+#include "logger.hpp"
+
+#include "utils/crypto.hpp"
+#include "track_log.hpp"
+
+namespace avi{
+
+static const char file_magic[] = "AVITRK1\n";
+static const size_t file_magic_len = sizeof(file_magic) - 1;
+static const uint32_t block_magic = 0x4B4C4254;	// "TBLK"
+static const size_t block_header_size = Track_log::header_size;
+// Наибольший размер записи: флаги + 2 varint по 10 байт + 3 по 5 байт
+static const size_t max_record_size = 1 + 10 + 10 + 5 + 5 + 5;
+
+static size_t put_varint(uint8_t *out, uint64_t value)
+{
+	size_t len = 0;
+
+	while(value >= 0x80){
+		out[len++] = static_cast<uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+
+	out[len++] = static_cast<uint8_t>(value);
+	return len;
+}
+
+static bool get_varint(const uint8_t *in, size_t len, size_t *pos, uint64_t *value)
+{
+	uint64_t res = 0;
+
+	for(unsigned shift = 0; (*pos < len) && (shift < 64); shift += 7){
+		const uint8_t byte = in[(*pos)++];
+		res |= static_cast<uint64_t>(byte & 0x7F) << shift;
+
+		if( !(byte & 0x80) ){
+			*value = res;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint64_t zigzag(int64_t value)
+{
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value)
+{
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void put_u16(uint8_t *out, uint16_t value)
+{
+	out[0] = value & 0xFF;
+	out[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *out, uint32_t value)
+{
+	put_u16(out, value & 0xFFFF);
+	put_u16(out + 2, value >> 16);
+}
+
+static uint16_t get_u16(const uint8_t *in)
+{
+	return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t *in)
+{
+	return get_u16(in) | (static_cast<uint32_t>(get_u16(in + 2)) << 16);
+}
+
+Track_log::~Track_log()
+{
+	try{
+		this->close();
+	}
+	catch(const std::exception &e){
+		log_excp("%s\n", e.what());
+	}
+}
+
+void Track_log::open(const std::string &path, uint64_t max_size, int flush_period_s)
+{
+	this->close();
+
+	path_ = path;
+	max_size_ = max_size;
+	flush_period_s_ = (flush_period_s > 0) ? flush_period_s : 1;
+
+	this->open_file();
+}
+
+void Track_log::open_file()
+{
+	fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+	if(fd_ < 0){
+		throw std::runtime_error(excp_method("could not open '" + path_ + "': " + strerror(errno)));
+	}
+
+	struct stat st;
+	file_size_ = (fstat(fd_, &st) == 0) ? static_cast<uint64_t>(st.st_size) : 0;
+
+	// Новый файл начинается с заголовка
+	if( !file_size_ ){
+		if(::write(fd_, file_magic, file_magic_len) != static_cast<ssize_t>(file_magic_len)){
+			const std::string err = strerror(errno);
+			::close(fd_);
+			fd_ = -1;
+			throw std::runtime_error(excp_method("could not write '" + path_ + "' header: " + err));
+		}
+
+		file_size_ = file_magic_len;
+	}
+}
+
+void Track_log::close()
+{
+	if(fd_ < 0){
+		return;
+	}
+
+	this->flush();
+
+	::close(fd_);
+	fd_ = -1;
+}
+
+void Track_log::rotate()
+{
+	::close(fd_);
+	fd_ = -1;
+
+	const std::string old_path = path_ + ".1";
+	if(rename(path_.c_str(), old_path.c_str())){
+		log_warn("Could not rename '%s': %s\n", path_, strerror(errno));
+		// Не удалось сохранить копию - начинаем журнал заново
+		unlink(path_.c_str());
+	}
+
+	this->open_file();
+}
+
+void Track_log::append(const platform::GPS_data &data, uint64_t unix_ms)
+{
+	if(fd_ < 0){
+		return;
+	}
+
+	if(block_len_ + max_record_size > block_size){
+		this->flush();
+	}
+
+	record rec;
+	rec.unix_ms = unix_ms;
+	rec.coord = data.coord;
+	rec.speed_ckmh = (data.speed_kmh > 0.0) ? static_cast<uint32_t>(std::lround(data.speed_kmh * 100.0)) : 0;
+	rec.course_cdeg = (data.course > 0.0) ? static_cast<uint32_t>(std::lround(data.course * 100.0)) : 0;
+	rec.valid = data.valid;
+
+	// Первая запись блока - абсолютные значения (блок читается независимо от предыдущих)
+	const bool first = (block_count_ == 0);
+	uint8_t *out = block_ + block_header_size;
+	size_t &len = block_len_;
+
+	out[len++] = rec.valid ? 0x01 : 0x00;
+	len += put_varint(out + len, first ? rec.unix_ms : rec.unix_ms - prev_.unix_ms);
+	len += put_varint(out + len, zigzag(first ? rec.coord.lat : static_cast<int64_t>(rec.coord.lat) - prev_.coord.lat));
+	len += put_varint(out + len, zigzag(first ? rec.coord.lon : static_cast<int64_t>(rec.coord.lon) - prev_.coord.lon));
+	len += put_varint(out + len, rec.speed_ckmh);
+	len += put_varint(out + len, rec.course_cdeg);
+
+	if(first){
+		block_started_ms_ = unix_ms;
+	}
+
+	++block_count_;
+	prev_ = rec;
+
+	if(unix_ms - block_started_ms_ >= static_cast<uint64_t>(flush_period_s_) * 1000){
+		this->flush();
+	}
+}
+
+void Track_log::flush()
+{
+	if((fd_ < 0) || !block_count_){
+		return;
+	}
+
+	put_u32(block_, block_magic);
+	put_u16(block_ + 4, static_cast<uint16_t>(block_len_));
+	put_u16(block_ + 6, block_count_);
+	put_u32(block_ + 8, utils::crc32_wiki_inv(0, block_ + block_header_size, block_len_));
+
+	const size_t size = block_header_size + block_len_;
+	block_len_ = 0;
+	block_count_ = 0;
+
+	if(::write(fd_, block_, size) != static_cast<ssize_t>(size)){
+		log_err("Could not write track block to '%s': %s\n", path_, strerror(errno));
+		return;
+	}
+
+	fsync(fd_);
+	file_size_ += size;
+
+	if(max_size_ && (file_size_ >= max_size_)){
+		this->rotate();
+	}
+}
+
+size_t Track_log::read(const std::string &path, const std::function<void(const record &rec)> &cb)
+{
+	std::ifstream in(path, std::ios::binary);
+	if( !in.is_open() ){
+		throw std::runtime_error(excp_method("could not open '" + path + "': " + strerror(errno)));
+	}
+
+	std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+	const uint8_t *buf = reinterpret_cast<const uint8_t*>(data.data());
+
+	if((data.size() < file_magic_len) || memcmp(buf, file_magic, file_magic_len)){
+		throw std::runtime_error(excp_method("'" + path + "' is not a track log"));
+	}
+
+	size_t bad_blocks = 0;
+	size_t pos = file_magic_len;
+
+	while(pos + block_header_size <= data.size()){
+		const uint16_t len = get_u16(buf + pos + 4);
+		const uint16_t count = get_u16(buf + pos + 6);
+
+		if((get_u32(buf + pos) != block_magic) || (len > block_size) || (pos + block_header_size + len > data.size()) ||
+			(get_u32(buf + pos + 8) != utils::crc32_wiki_inv(0, buf + pos + block_header_size, len)))
+		{
+			// Поврежденный блок - ищем заголовок следующего
+			++bad_blocks;
+			for(++pos; (pos + block_header_size <= data.size()) && (get_u32(buf + pos) != block_magic); ++pos){}
+			continue;
+		}
+
+		const uint8_t *payload = buf + pos + block_header_size;
+		size_t p = 0;
+		record rec;
+
+		for(uint16_t i = 0; i < count; ++i){
+			uint64_t t = 0, lat = 0, lon = 0, spd = 0, crs = 0;
+			const uint8_t flags = (p < len) ? payload[p++] : 0;
+
+			if( !get_varint(payload, len, &p, &t) || !get_varint(payload, len, &p, &lat) || !get_varint(payload, len, &p, &lon) ||
+				!get_varint(payload, len, &p, &spd) || !get_varint(payload, len, &p, &crs) )
+			{
+				++bad_blocks;
+				break;
+			}
+
+			if(i == 0){
+				rec.unix_ms = t;
+				rec.coord.lat = static_cast<int32_t>(unzigzag(lat));
+				rec.coord.lon = static_cast<int32_t>(unzigzag(lon));
+			}
+			else{
+				rec.unix_ms += t;
+				rec.coord.lat += static_cast<int32_t>(unzigzag(lat));
+				rec.coord.lon += static_cast<int32_t>(unzigzag(lon));
+			}
+
+			rec.speed_ckmh = static_cast<uint32_t>(spd);
+			rec.course_cdeg = static_cast<uint32_t>(crs);
+			rec.valid = flags & 0x01;
+
+			cb(rec);
+		}
+
+		pos += block_header_size + len;
+	}
+
+	return bad_blocks;
+}
+
+} // namespace avi
+
+
+#ifdef _TRACK_CONV
+
+#include <ctime>
+#include <cstdio>
+#include <iostream>
+
+using namespace std;
+
+// Преобразование двоичного журнала в текстовый формат .track
+// (GPS_Track_Loader, утилиты анализа треков)
+int main(int argc, char* argv[])
+{
+	if(argc < 2){
+		cout << "Usage: " << argv[0] << " file.trk [out.track]" << endl;
+		return 1;
+	}
+
+	FILE *out = (argc > 2) ? fopen(argv[2], "w") : stdout;
+	if( !out ){
+		cerr << "could not open '" << argv[2] << "': " << strerror(errno) << endl;
+		return 1;
+	}
+
+	size_t records = 0;
+	size_t bad_blocks = 0;
+
+	try{
+		bad_blocks = avi::Track_log::read(argv[1], [out, &records](const avi::Track_log::record &rec){
+			platform::GPS_data data;
+			data.coord = rec.coord;
+			data.speed_kmh = rec.speed_ckmh / 100.0;
+			data.course = rec.course_cdeg / 100.0;
+			data.valid = rec.valid;
+
+			// Метка времени в формате лога: "[ 14.07.22 12:00:07 ] "
+			const time_t sec = static_cast<time_t>(rec.unix_ms / 1000);
+			struct tm tm_info;
+			localtime_r(&sec, &tm_info);
+
+			char stamp[32];
+			strftime(stamp, sizeof(stamp), "[ %d.%m.%y %H:%M:%S ]", &tm_info);
+
+			fprintf(out, "%s %s\n", stamp, data.to_string().c_str());
+			++records;
+		});
+	}
+	catch(const exception &e){
+		cerr << e.what() << endl;
+		return 1;
+	}
+
+	if(out != stdout){
+		fclose(out);
+	}
+
+	cerr << records << " records converted, " << bad_blocks << " damaged blocks skipped" << endl;
+
+	return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*==============================================================================
+Описание: 	Модуль двоичного журнала GPS трека.
+
+			Решения приемника накапливаются в блоке в памяти и записываются
+			на носитель целым блоком (по заполнении или по истечении периода)
+			с последующим fsync - вместо строки текста на каждое решение.
+
+			Формат файла:
+				"AVITRK1\n"								- заголовок файла
+				блок:
+					uint32_t magic ("TBLK")
+					uint16_t payload_len				- размер записей блока
+					uint16_t count						- количество записей
+					uint32_t crc32						- CRC32 записей блока
+					записи
+
+			Запись: флаги (1 байт: бит 0 - валидность) и varint поля -
+			время (мс), широта и долгота (микроградусы), скорость (0.01 км/ч),
+			курс (0.01°). Первая запись блока содержит абсолютные значения
+			времени и координат, последующие - разность с предыдущей (zigzag).
+			Блоки независимы: поврежденный блок (CRC) пропускается, чтение
+			продолжается со следующего.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+#include "platform.hpp"
+
+namespace avi{
+
+class Track_log
+{
+public:
+	// Максимальный размер блока записей и размер заголовка блока (байт)
+	static const size_t block_size = 4096;
+	static const size_t header_size = 12;
+
+	Track_log() = default;
+	Track_log(const Track_log&) = delete;
+	Track_log& operator=(const Track_log&) = delete;
+	~Track_log();
+
+	/**
+	  * @описание   Открытие журнала (дозапись в конец существующего)
+	  * @параметры
+	  *     Входные:
+	  *         path - путь к файлу журнала
+	  *         max_size - размер, по достижении которого журнал переименовывается
+	  *                    в path + ".1" (предыдущая копия удаляется)
+	  *         flush_period_s - наибольшее время хранения записей в памяти
+	  * @исключения std::runtime_error
+	 */
+	void open(const std::string &path, uint64_t max_size, int flush_period_s = 30);
+	void close();
+
+	bool is_open() const { return fd_ >= 0; }
+
+	// Добавление решения (unix_ms - время записи, мс с начала эпохи)
+	void append(const platform::GPS_data &data, uint64_t unix_ms);
+
+	// Запись накопленного блока на носитель
+	void flush();
+
+	// Запись журнала
+	struct record
+	{
+		uint64_t unix_ms = 0;
+		utils::Coord coord;
+		uint32_t speed_ckmh = 0;	// 0.01 км/ч
+		uint32_t course_cdeg = 0;	// 0.01°
+		bool valid = false;
+	};
+
+	/**
+	  * @описание   Чтение журнала
+	  * @параметры
+	  *     Входные:
+	  *         path - путь к файлу журнала
+	  *         cb - обработчик записи
+	  * @возвращает количество пропущенных (поврежденных) блоков
+	  * @исключения std::runtime_error - файл не открывается или не является журналом
+	 */
+	static size_t read(const std::string &path, const std::function<void(const record &rec)> &cb);
+
+private:
+	std::string path_;
+	uint64_t max_size_ = 0;
+	int flush_period_s_ = 30;
+	int fd_ = -1;
+	uint64_t file_size_ = 0;
+
+	uint8_t block_[header_size + block_size];	// Заголовок и записи текущего блока
+	size_t block_len_ = 0;
+	uint16_t block_count_ = 0;
+	uint64_t block_started_ms_ = 0;
+	record prev_;
+
+	void open_file();
+	void rotate();
+};
+
+} // namespace avi
@@ -0,0 +1,170 @@
+#include <cstdio>
+#include <functional>
+#include <unordered_set>
+
+#define LOG_MODULE_NAME		"[ TTS ]"
+#include "logger.hpp"
+
+#include "utils/utility.hpp"
+#include "utils/fs.hpp"
+#include "utils/crypto.hpp"
+#include "utils/mp3.hpp"
+#include "tts_cache.hpp"
+
+namespace avi{
+
+static void replace_all(std::string &str, const std::string &from, const std::string &to)
+{
+	for(size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size())){
+		str.replace(pos, from.size(), to);
+	}
+}
+
+void TTSCache::init(const std::string &cache_dir, const std::string &command)
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	cache_dir_ = cache_dir;
+	command_ = command;
+	phrases_.clear();
+}
+
+void TTSCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	job_.cancel();
+	phrases_.clear();
+}
+
+void TTSCache::prepare_async(std::vector<std::string> texts)
+{
+	std::string cache_dir, command;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		if(cache_dir_.empty() || texts.empty()){
+			return;
+		}
+
+		if(command_.empty()){
+			log_warn("TTS command is not set. %zu phrases will not be played\n", texts.size());
+			return;
+		}
+
+		cache_dir = cache_dir_;
+		command = command_;
+	}
+
+	job_.start(std::bind(&TTSCache::prepare, this, std::move(texts), cache_dir, command, std::placeholders::_1));
+}
+
+void TTSCache::synthesize(const std::string &command, const std::string &text, const std::string &out_path,
+	uint32_t generation) const
+{
+	// Временные файлы различаем по поколению (остатки отмененного синтеза
+	// не мешают следующему)
+	const std::string tmp_path = out_path + "." + std::to_string(generation) + ".tmp";
+	const std::string text_path = tmp_path + ".txt";
+
+	// Текст передается через файл - исключаем проблемы с экранированием кавычек в оболочке
+	utils::write_text_file(text_path, text);
+
+	std::string cmd = command;
+	replace_all(cmd, "{text_file}", text_path);
+	replace_all(cmd, "{out}", tmp_path);
+
+	bool ok = utils::exec(cmd, true);
+	remove(text_path.c_str());
+
+	if( !ok || !utils::file_exists(tmp_path) ){
+		remove(tmp_path.c_str());
+		throw std::runtime_error(excp_method("'" + cmd + "' failed"));
+	}
+
+	// Атомарная подмена - проигрыватель никогда не увидит недописанный файл
+	if(rename(tmp_path.c_str(), out_path.c_str())){
+		remove(tmp_path.c_str());
+		throw std::runtime_error(excp_method("rename to '" + out_path + "' failed: " + strerror(errno)));
+	}
+}
+
+void TTSCache::prepare(const std::vector<std::string> &texts, const std::string &cache_dir, const std::string &command,
+	uint32_t generation)
+{
+	std::unordered_set<std::string> used_files;
+	size_t synthesized = 0;
+
+	for(const auto &text : texts){
+
+		// Кеш был сброшен - результаты больше не актуальны
+		if( !job_.is_current(generation) ){
+			log_msg(MSG_DEBUG, "TTS phrases preparation cancelled\n");
+			return;
+		}
+
+		// Имя файла определяется хешем текста - одинаковые фразы разных маршрутов
+		// и повторные выборы маршрута используют уже синтезированные файлы
+		phrase ph;
+		ph.path = cache_dir + "/" + utils::md5sum(text.c_str(), text.size()) + ".mp3";
+
+		used_files.insert(utils::get_file_name(ph.path));
+
+		try{
+			if( !utils::file_exists(ph.path) ){
+				this->synthesize(command, text, ph.path, generation);
+				++synthesized;
+			}
+
+			ph.duration_ms = utils::mp3_file_info(ph.path).duration_ms;
+		}
+		catch(const std::exception &e){
+			log_warn("Could not synthesize phrase '%s': %s\n", text, e.what());
+			remove(ph.path.c_str());
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(job_.is_current(generation)){
+			phrases_[text] = std::move(ph);
+		}
+	}
+
+	// Удаляем файлы фраз, которых больше нет в текущем маршруте
+	try{
+		if( !job_.collect_garbage(cache_dir, used_files, generation) ){
+			log_msg(MSG_DEBUG, "TTS phrases preparation cancelled\n");
+			return;
+		}
+	}
+	catch(const std::exception &e){
+		log_warn("Could not clean TTS cache: %s\n", e.what());
+	}
+
+	log_msg(MSG_DEBUG | MSG_TO_FILE, "TTS phrases ready: %zu (synthesized now: %zu)\n", used_files.size(), synthesized);
+}
+
+bool TTSCache::find(const std::string &text, std::string *path, uint32_t *duration_ms) const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	auto it = phrases_.find(text);
+	if(it == phrases_.end()){
+		return false;
+	}
+
+	if( !utils::file_exists(it->second.path) ){
+		return false;
+	}
+
+	if(path){
+		*path = it->second.path;
+	}
+
+	if(duration_ms){
+		*duration_ms = it->second.duration_ms;
+	}
+
+	return true;
+}
+
+} // namespace avi
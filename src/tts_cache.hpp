@@ -0,0 +1,87 @@
+/*==============================================================================
+Описание: 	Модуль кеша синтезированных фраз (TTS).
+
+			Динамические фразы (номер маршрута, названия остановок) задаются
+			текстом в столбце text таблицы kFrames. При выборе маршрута фразы
+			синтезируются в фоне в MP3 файлы, имена которых определяются хешем
+			текста, и далее воспроизводятся проигрывателем так же, как
+			предварительно записанные файлы.
+
+			Синтез выполняется внешней командой (настройка tts_command):
+			встроенный TTS SIMCOM (TTSControl.h) воспроизводит речь сразу на
+			аудио-выход и не позволяет получить результат в виде файла.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <unordered_map>
+
+#include "utils/cache_job.hpp"
+
+namespace avi{
+
+class TTSCache
+{
+public:
+	/**
+	  * @описание   Инициализация кеша
+	  * @параметры
+	  *     Входные:
+	  *         cache_dir - директория синтезированных файлов
+	  *         command - команда синтеза. Шаблоны {text_file} и {out} заменяются
+	  *                   путями к файлу с текстом (UTF-8) и к результирующему MP3.
+	  *                   Пустая команда отключает синтез
+	 */
+	void init(const std::string &cache_dir, const std::string &command);
+
+	// Сбросить известные фразы (вызывается перед перезагрузкой фреймов НСИ)
+	void clear();
+
+	// Запустить фоновый синтез фраз, которых еще нет в кеше
+	// (незавершенный предыдущий синтез отменяется)
+	void prepare_async(std::vector<std::string> texts);
+
+	// Остановка фонового синтеза с ожиданием его завершения
+	void stop() { job_.stop(); }
+
+	/**
+	  * @описание   Поиск синтезированного файла фразы
+	  * @параметры
+	  *     Входные:
+	  *         text - текст фразы
+	  *     Выходные:
+	  *         path - путь к MP3 файлу
+	  *         duration_ms - длительность воспроизведения
+	  * @возвращает true если фраза уже синтезирована
+	 */
+	bool find(const std::string &text, std::string *path, uint32_t *duration_ms = nullptr) const;
+
+private:
+	struct phrase{
+		std::string path;
+		uint32_t duration_ms = 0;
+	};
+
+	mutable std::mutex mutex_;
+	std::string cache_dir_;
+	std::string command_;
+
+	// Текст -> синтезированный файл
+	std::unordered_map<std::string, phrase> phrases_;
+
+	// Фоновый синтез. Поколение увеличивается при каждом сбросе
+	utils::CacheJob job_;
+
+	void synthesize(const std::string &command, const std::string &text, const std::string &out_path, uint32_t generation) const;
+	void prepare(const std::vector<std::string> &texts, const std::string &cache_dir, const std::string &command,
+		uint32_t generation);
+};
+
+} // namespace avi
@@ -0,0 +1,59 @@
+#include <cstdio>
+
+#include "fs.hpp"
+#include "cache_job.hpp"
+
+namespace utils{
+
+void CacheJob::cancel()
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	++generation_;
+}
+
+void CacheJob::stop()
+{
+	std::lock_guard<std::mutex> lock(start_mutex_);
+
+	this->cancel();
+	if(thread_.joinable()){
+		thread_.join();
+	}
+}
+
+void CacheJob::start(job j)
+{
+	std::lock_guard<std::mutex> lock(start_mutex_);
+
+	this->cancel();
+	if(thread_.joinable()){
+		thread_.join();
+	}
+
+	thread_ = std::thread(std::move(j), generation_.load());
+}
+
+bool CacheJob::collect_garbage(const std::string &dir, const std::unordered_set<std::string> &used, uint32_t generation)
+{
+	const std::vector<std::string> fnames = get_file_names_in_dir(dir);
+
+	// Отмена (clear() кеша перед перезагрузкой фреймов) ждет окончания удаления
+	std::lock_guard<std::mutex> lock(mutex_);
+
+	if( !this->is_current(generation) ){
+		return false;
+	}
+
+	for(const auto &fname : fnames){
+		// Временные файлы дописываются и переименовываются заданием
+		if(used.count(fname) || (fname.find(".tmp") != std::string::npos)){
+			continue;
+		}
+
+		remove((dir + "/" + fname).c_str());
+	}
+
+	return true;
+}
+
+} // namespace utils
@@ -0,0 +1,82 @@
+/*==============================================================================
+Описание: 	Модуль фонового заполнения директории кеша.
+
+			Задание выполняется в одном рабочем потоке, которым владеет
+			объект: новое задание отменяет предыдущее и дожидается его
+			завершения, поэтому два задания никогда не работают с одной
+			директорией одновременно. Отмена увеличивает поколение - задание
+			проверяет его между шагами и не сохраняет устаревшие результаты.
+
+			Удаление файлов, не нужных текущему заданию, выполняется только
+			если поколение задания все еще актуально. Временные файлы (*.tmp)
+			не удаляются никогда.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <unordered_set>
+
+namespace utils{
+
+class CacheJob
+{
+public:
+	// Задание. Параметр - поколение, в котором задание запущено
+	using job = std::function<void(uint32_t generation)>;
+
+	CacheJob() = default;
+	CacheJob(const CacheJob&) = delete;
+	CacheJob& operator=(const CacheJob&) = delete;
+
+	~CacheJob() { this->stop(); }
+
+	// Отмена текущего задания. Не ждет завершения потока
+	void cancel();
+
+	// Отмена текущего задания с ожиданием завершения потока
+	void stop();
+
+	/**
+	  * @описание   Запуск задания в рабочем потоке. Предыдущее задание
+	  *             отменяется, его поток дожидается (не дольше одного шага)
+	  * @параметры
+	  *     Входные:
+	  *         j - задание
+	 */
+	void start(job j);
+
+	bool is_current(uint32_t generation) const { return generation == generation_.load(); }
+
+	/**
+	  * @описание   Удаление файлов директории, не входящих в used.
+	  *             Выполняется только для актуального поколения
+	  * @параметры
+	  *     Входные:
+	  *         dir - директория кеша
+	  *         used - имена файлов, нужных заданию
+	  *         generation - поколение задания
+	  * @возвращает false - поколение устарело, файлы не удалялись
+	  * @исключения std::runtime_error - директория не читается
+	 */
+	bool collect_garbage(const std::string &dir, const std::unordered_set<std::string> &used, uint32_t generation);
+
+private:
+	// Поток задания запускается и присоединяется под start_mutex_,
+	// удаление файлов и отмена исключают друг друга по mutex_
+	std::mutex start_mutex_;
+	std::mutex mutex_;
+	std::thread thread_;
+	std::atomic<uint32_t> generation_{0};
+};
+
+} // namespace utils
@@ -0,0 +1,282 @@
+/*==============================================================================
+Описание: 	Модуль географических координат в целочисленном представлении.
+
+			Координаты хранятся в микроградусах (int32_t, 1e-6° ~ 11 см), что
+			совпадает с точностью вывода GPS приемника. Разбор из NMEA и
+			десятичной записи, сравнение и расчет расстояний выполняются в
+			целых числах - результат детерминирован и не зависит от FPU.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+namespace utils{
+
+// Количество микроградусов в градусе
+constexpr int32_t MICRODEG = 1000000;
+
+// Координата точки (микроградусы)
+struct Coord
+{
+	Coord() = default;
+	constexpr Coord(int32_t lat_ude, int32_t lon_ude): lat(lat_ude), lon(lon_ude) {}
+
+	static Coord from_degrees(double lat_deg, double lon_deg)
+	{
+		return Coord(static_cast<int32_t>(std::lround(lat_deg * MICRODEG)), static_cast<int32_t>(std::lround(lon_deg * MICRODEG)));
+	}
+
+	double lat_degrees() const { return static_cast<double>(lat) / MICRODEG; }
+	double lon_degrees() const { return static_cast<double>(lon) / MICRODEG; }
+
+	bool operator==(const Coord &rhs) const { return (lat == rhs.lat) && (lon == rhs.lon); }
+	bool operator!=(const Coord &rhs) const { return !(*this == rhs); }
+
+	int32_t lat = 0;	// Широта (> 0 - северная)
+	int32_t lon = 0;	// Долгота (> 0 - восточная)
+};
+
+/**
+  * @описание   Разбор десятичной записи градусов ("55.751350", "-37.5") в микроградусы.
+  *             Знаки дробной части после 6-го отбрасываются с округлением
+  * @параметры
+  *     Входные:
+  *         str - строка (не обязательно завершенная нулем)
+  *         len - максимальная длина разбираемой части
+  *     Выходные:
+  *         out - микроградусы
+  * @возвращает количество разобранных символов (0 - ошибка формата)
+ */
+inline size_t parse_microdegrees(const char *str, size_t len, int32_t *out)
+{
+	size_t i = 0;
+	bool negative = false;
+
+	if(len && ((str[0] == '-') || (str[0] == '+'))){
+		negative = (str[0] == '-');
+		++i;
+	}
+
+	int64_t int_part = 0;
+	int64_t frac_part = 0;
+	int frac_digits = 0;
+	bool round_up = false;
+	size_t digits = 0;
+
+	for(; (i < len) && (str[i] >= '0') && (str[i] <= '9'); ++i, ++digits){
+		int_part = int_part * 10 + (str[i] - '0');
+
+		if(int_part > 360){
+			return 0;
+		}
+	}
+
+	if((i < len) && (str[i] == '.')){
+		for(++i; (i < len) && (str[i] >= '0') && (str[i] <= '9'); ++i, ++digits){
+			if(frac_digits < 6){
+				frac_part = frac_part * 10 + (str[i] - '0');
+				++frac_digits;
+			}
+			else if(frac_digits == 6){
+				round_up = (str[i] >= '5');
+				++frac_digits;
+			}
+		}
+	}
+
+	if( !digits ){
+		return 0;
+	}
+
+	for(; frac_digits < 6; ++frac_digits){
+		frac_part *= 10;
+	}
+
+	int64_t res = int_part * MICRODEG + frac_part + (round_up ? 1 : 0);
+	*out = static_cast<int32_t>(negative ? -res : res);
+
+	return i;
+}
+
+/**
+  * @описание   Разбор NMEA координаты ([d]ddmm.mmmm) с полушарием (N/S/E/W) в микроградусы
+  * @параметры
+  *     Входные:
+  *         value - координата (не обязательно завершенная нулем)
+  *         len - длина координаты
+  *         quadrant - полушарие
+  *     Выходные:
+  *         out - микроградусы
+  * @возвращает false при ошибке формата
+ */
+inline bool nmea_to_microdegrees(const char *value, size_t len, char quadrant, int32_t *out)
+{
+	size_t int_len = 0;
+	while((int_len < len) && (value[int_len] >= '0') && (value[int_len] <= '9')){
+		++int_len;
+	}
+
+	// Две последние цифры целой части - минуты
+	if((int_len < 3) || (int_len > 5)){
+		return false;
+	}
+
+	int32_t degrees = 0;
+	for(size_t i = 0; i < int_len - 2; ++i){
+		degrees = degrees * 10 + (value[i] - '0');
+	}
+
+	// Минуты разбираются как "градусы" - результат в микроминутах
+	int32_t micro_minutes = 0;
+	const size_t min_len = len - int_len + 2;
+
+	if((parse_microdegrees(value + int_len - 2, min_len, &micro_minutes) != min_len) || (micro_minutes >= 60 * MICRODEG)){
+		return false;
+	}
+
+	int32_t res = degrees * MICRODEG + (micro_minutes + 30) / 60;
+
+	switch(quadrant){
+		case 'N': case 'E':
+			break;
+		case 'S': case 'W':
+			res = -res;
+			break;
+		default:
+			return false;
+	}
+
+	*out = res;
+
+	return true;
+}
+
+// Десятичная запись микроградусов (6 знаков после запятой)
+inline std::string microdegrees_to_string(int32_t ude)
+{
+	char buf[16];
+	const uint32_t abs_ude = (ude < 0) ? static_cast<uint32_t>(-static_cast<int64_t>(ude)) : static_cast<uint32_t>(ude);
+
+	snprintf(buf, sizeof(buf), "%s%u.%06u", (ude < 0) ? "-" : "", abs_ude / MICRODEG, abs_ude % MICRODEG);
+
+	return buf;
+}
+
+/**
+  * @описание   Точка дуги большого круга между a и b
+  * @параметры
+  *     Входные:
+  *         a, b - концы дуги
+  *         f - доля пути от a (0 - a, 1 - b)
+ */
+inline Coord great_circle_point(const Coord &a, const Coord &b, double f)
+{
+	if(a == b){
+		return a;
+	}
+
+	const double PI = 3.14159265358979;
+	const double to_rad = PI / 180.0 / MICRODEG;
+
+	const double lat1 = a.lat * to_rad, lon1 = a.lon * to_rad;
+	const double lat2 = b.lat * to_rad, lon2 = b.lon * to_rad;
+
+	// Единичные векторы точек
+	const double x1 = std::cos(lat1) * std::cos(lon1), y1 = std::cos(lat1) * std::sin(lon1), z1 = std::sin(lat1);
+	const double x2 = std::cos(lat2) * std::cos(lon2), y2 = std::cos(lat2) * std::sin(lon2), z2 = std::sin(lat2);
+
+	const double dot = std::max(-1.0, std::min(1.0, x1 * x2 + y1 * y2 + z1 * z2));
+	const double omega = std::acos(dot);
+
+	// Близкие точки - линейная интерполяция (погрешность меньше микроградуса)
+	if(omega < 1e-9){
+		return Coord(static_cast<int32_t>(std::lround(a.lat + (static_cast<double>(b.lat) - a.lat) * f)),
+			static_cast<int32_t>(std::lround(a.lon + (static_cast<double>(b.lon) - a.lon) * f)));
+	}
+
+	const double k1 = std::sin((1.0 - f) * omega) / std::sin(omega);
+	const double k2 = std::sin(f * omega) / std::sin(omega);
+
+	const double x = k1 * x1 + k2 * x2, y = k1 * y1 + k2 * y2, z = k1 * z1 + k2 * z2;
+
+	return Coord(static_cast<int32_t>(std::lround(std::atan2(z, std::sqrt(x * x + y * y)) / to_rad)),
+		static_cast<int32_t>(std::lround(std::atan2(y, x) / to_rad)));
+}
+
+// Локальная метрика вблизи опорной широты (равнопромежуточная проекция).
+// Масштабы рассчитываются один раз, расстояния - в целых сантиметрах без
+// тригонометрии. Погрешность не превышает долей процента на расстояниях
+// до десятков километров, чего достаточно для зон НСИ
+class LocalMetric
+{
+public:
+	LocalMetric() = default;
+
+	explicit LocalMetric(int32_t ref_lat)
+	{
+		const double PI = 3.14159265358979;
+		lon_scale_q16_ = static_cast<int64_t>(std::llround(lat_scale_q16_ * std::cos(static_cast<double>(ref_lat) / MICRODEG * PI / 180.0)));
+	}
+
+	// Квадрат расстояния между точками (см^2)
+	uint64_t distance2_cm(const Coord &a, const Coord &b) const
+	{
+		const int64_t dlat = static_cast<int64_t>(b.lat) - a.lat;
+		const int64_t dlon = static_cast<int64_t>(b.lon) - a.lon;
+
+		// Удаленные точки не сравниваются (исключаем переполнение)
+		if((dlat > max_delta) || (dlat < -max_delta) || (dlon > max_delta) || (dlon < -max_delta)){
+			return std::numeric_limits<uint64_t>::max();
+		}
+
+		const int64_t dy = (dlat * lat_scale_q16_) >> 16;
+		const int64_t dx = (dlon * lon_scale_q16_) >> 16;
+
+		return static_cast<uint64_t>(dx * dx + dy * dy);
+	}
+
+	uint32_t distance_cm(const Coord &a, const Coord &b) const
+	{
+		const uint64_t d2 = distance2_cm(a, b);
+		if(d2 == std::numeric_limits<uint64_t>::max()){
+			return std::numeric_limits<uint32_t>::max();
+		}
+
+		return static_cast<uint32_t>(std::sqrt(static_cast<double>(d2)));
+	}
+
+	// Смещение точки b относительно a (см): на восток и на север
+	void offset_cm(const Coord &a, const Coord &b, int64_t *east, int64_t *north) const
+	{
+		*east = ((static_cast<int64_t>(b.lon) - a.lon) * lon_scale_q16_) >> 16;
+		*north = ((static_cast<int64_t>(b.lat) - a.lat) * lat_scale_q16_) >> 16;
+	}
+
+	// Точка, смещенная относительно a (см)
+	Coord shift(const Coord &a, int64_t east, int64_t north) const
+	{
+		return Coord(static_cast<int32_t>(a.lat + north * 65536 / lat_scale_q16_),
+			static_cast<int32_t>(a.lon + east * 65536 / lon_scale_q16_));
+	}
+
+private:
+	// Сантиметров в микроградусе широты (Q16): 2 * PI * 6372795 м / 360 / 1e6
+	static const int64_t lat_scale_q16 = 728932;
+	static const int64_t max_delta = 10 * MICRODEG;
+
+	int64_t lat_scale_q16_ = lat_scale_q16;
+	int64_t lon_scale_q16_ = lat_scale_q16;
+};
+
+} // namespace utils
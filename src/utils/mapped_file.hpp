@@ -0,0 +1,126 @@
+/*==============================================================================
+Описание: 	Модуль отображения файла в память (только чтение).
+
+			Файл не читается целиком: страницы подгружаются системой по мере
+			обращения и вытесняются при нехватке памяти, поэтому открытие
+			файла любого размера занимает постоянное время, а объем занятой
+			процессом памяти не зависит от размера файла.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace utils{
+
+class Mapped_file
+{
+public:
+	Mapped_file() = default;
+	Mapped_file(const Mapped_file&) = delete;
+	Mapped_file& operator=(const Mapped_file&) = delete;
+	~Mapped_file() { this->close(); }
+
+	// Исключения: std::runtime_error
+	void open(const std::string &path)
+	{
+		this->close();
+
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0){
+			throw std::runtime_error("could not open '" + path + "' - " + strerror(errno));
+		}
+
+		struct stat st;
+		if(fstat(fd, &st)){
+			const std::string err = strerror(errno);
+			::close(fd);
+			throw std::runtime_error("could not stat '" + path + "' - " + err);
+		}
+
+		// Пустой файл не отображается (mmap нулевой длины недопустим)
+		if(st.st_size > 0){
+			void *addr = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if(addr == MAP_FAILED){
+				const std::string err = strerror(errno);
+				::close(fd);
+				throw std::runtime_error("could not map '" + path + "' - " + err);
+			}
+
+			// Файлы симуляции читаются последовательно - разрешаем упреждающее чтение
+			madvise(addr, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+
+			data_ = static_cast<const char*>(addr);
+			size_ = static_cast<size_t>(st.st_size);
+		}
+
+		// Отображение остается действительным после закрытия дескриптора
+		::close(fd);
+	}
+
+	void close()
+	{
+		if(data_){
+			munmap(const_cast<char*>(data_), size_);
+		}
+
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+
+	/**
+	  * @описание   Строка файла, начинающаяся с позиции pos
+	  * @параметры
+	  *     Входные:
+	  *         pos - позиция начала строки
+	  *     Выходные:
+	  *         line - начало строки (не завершена нулем)
+	  *         len - длина строки без "\r\n"
+	  * @возвращает позицию начала следующей строки (size() - строк больше нет)
+	 */
+	size_t line(size_t pos, const char **line, size_t *len) const
+	{
+		if(pos >= size_){
+			*line = nullptr;
+			*len = 0;
+			return size_;
+		}
+
+		const char *begin = data_ + pos;
+		const char *end = static_cast<const char*>(memchr(begin, '\n', size_ - pos));
+		const size_t next = end ? static_cast<size_t>(end - data_) + 1 : size_;
+
+		if( !end ){
+			end = data_ + size_;
+		}
+
+		if((end > begin) && (end[-1] == '\r')){
+			--end;
+		}
+
+		*line = begin;
+		*len = static_cast<size_t>(end - begin);
+
+		return next;
+	}
+
+private:
+	const char *data_ = nullptr;
+	size_t size_ = 0;
+};
+
+} // namespace utils
@@ -0,0 +1,292 @@
+#include <cstring>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+#include "utility.hpp"
+#include "fs.hpp"
+#include "mp3.hpp"
+
+namespace utils{
+
+// Таблицы битрейтов (кбит/с) по индексу из заголовка
+static const uint16_t bitrates_v1[3][16] = {
+	{0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0},	// Layer I
+	{0, 32, 48, 56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 384, 0},	// Layer II
+	{0, 32, 40, 48,  56,  64,  80,  96, 112, 128, 160, 192, 224, 256, 320, 0},	// Layer III
+};
+
+static const uint16_t bitrates_v2[3][16] = {
+	{0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},	// Layer I
+	{0,  8, 16, 24, 32, 40, 48,  56,  64,  80,  96, 112, 128, 144, 160, 0},	// Layer II
+	{0,  8, 16, 24, 32, 40, 48,  56,  64,  80,  96, 112, 128, 144, 160, 0},	// Layer III
+};
+
+static const uint32_t sample_rates[3][3] = {
+	{44100, 48000, 32000},	// MPEG1
+	{22050, 24000, 16000},	// MPEG2
+	{11025, 12000, 8000},	// MPEG2.5
+};
+
+bool parse_mp3_frame_header(const uint8_t *p, MP3_frame_header *out)
+{
+	// 11 бит синхронизации
+	if((p[0] != 0xFF) || ((p[1] & 0xE0) != 0xE0)){
+		return false;
+	}
+
+	const uint8_t version_bits = (p[1] >> 3) & 0x03;
+	const uint8_t layer_bits = (p[1] >> 1) & 0x03;
+	const uint8_t bitrate_idx = (p[2] >> 4) & 0x0F;
+	const uint8_t sr_idx = (p[2] >> 2) & 0x03;
+	const uint8_t padding = (p[2] >> 1) & 0x01;
+	const uint8_t channel_mode = (p[3] >> 6) & 0x03;
+
+	// Зарезервированные и неподдерживаемые (free format) значения
+	if((version_bits == 0x01) || (layer_bits == 0x00) || (bitrate_idx == 0x00) ||
+		(bitrate_idx == 0x0F) || (sr_idx == 0x03)){
+		return false;
+	}
+
+	MP3_frame_header hdr;
+	hdr.version = (version_bits == 0x03) ? 1 : ((version_bits == 0x02) ? 2 : 25);
+	hdr.layer = 4 - layer_bits;
+	hdr.channels = (channel_mode == 0x03) ? 1 : 2;
+	hdr.crc = !(p[1] & 0x01);
+
+	const int v_idx = (hdr.version == 1) ? 0 : ((hdr.version == 2) ? 1 : 2);
+	hdr.bitrate = (hdr.version == 1) ? bitrates_v1[hdr.layer - 1][bitrate_idx] : bitrates_v2[hdr.layer - 1][bitrate_idx];
+	hdr.sample_rate = sample_rates[v_idx][sr_idx];
+
+	const uint32_t bps = static_cast<uint32_t>(hdr.bitrate) * 1000;
+
+	switch(hdr.layer){
+		case 1:
+			hdr.samples = 384;
+			hdr.length = (12 * bps / hdr.sample_rate + padding) * 4;
+			break;
+
+		case 2:
+			hdr.samples = 1152;
+			hdr.length = 144 * bps / hdr.sample_rate + padding;
+			break;
+
+		default:
+			hdr.samples = (hdr.version == 1) ? 1152 : 576;
+			hdr.length = ((hdr.version == 1) ? 144 : 72) * bps / hdr.sample_rate + padding;
+			break;
+	}
+
+	if(hdr.length < 4){
+		return false;
+	}
+
+	if(out){
+		*out = hdr;
+	}
+
+	return true;
+}
+
+// Размер тега ID3v2 в начале файла (0 если тега нет)
+static size_t id3v2_size(const uint8_t *buf, size_t len)
+{
+	if((len < 10) || memcmp(buf, "ID3", 3)){
+		return 0;
+	}
+
+	// Размер хранится в формате syncsafe (по 7 бит в байте)
+	size_t size = ((buf[6] & 0x7F) << 21) | ((buf[7] & 0x7F) << 14) | ((buf[8] & 0x7F) << 7) | (buf[9] & 0x7F);
+	size += 10;
+
+	// Признак наличия футера
+	if(buf[5] & 0x10){
+		size += 10;
+	}
+
+	return (size > len) ? len : size;
+}
+
+// Проверка является ли фрейм VBR заголовком (Xing/Info/VBRI), не содержащим звука
+static bool is_vbr_header_frame(const uint8_t *frame, const MP3_frame_header &hdr)
+{
+	size_t side_info = 0;
+
+	if(hdr.layer == 3){
+		if(hdr.version == 1){
+			side_info = (hdr.channels == 1) ? 17 : 32;
+		}
+		else{
+			side_info = (hdr.channels == 1) ? 9 : 17;
+		}
+	}
+
+	const size_t offset = 4 + (hdr.crc ? 2 : 0) + side_info;
+
+	if(offset + 4 <= hdr.length){
+		if( !memcmp(frame + offset, "Xing", 4) || !memcmp(frame + offset, "Info", 4) ){
+			return true;
+		}
+	}
+
+	// VBRI заголовок всегда расположен через 32 байта после заголовка
+	if(36 + 4 <= hdr.length){
+		if( !memcmp(frame + 36, "VBRI", 4) ){
+			return true;
+		}
+	}
+
+	return false;
+}
+
+MP3_audio_range mp3_audio_range(const uint8_t *buf, size_t len)
+{
+	MP3_audio_range res;
+
+	size_t pos = id3v2_size(buf, len);
+	size_t end = len;
+
+	// Тег ID3v1 в конце файла
+	if((end - pos >= 128) && !memcmp(buf + end - 128, "TAG", 3)){
+		end -= 128;
+	}
+
+	MP3_frame_header hdr;
+
+	// Поиск первого фрейма: корректный заголовок, за которым следует
+	// еще один корректный заголовок (либо конец данных)
+	while(pos + 4 <= end){
+		if(parse_mp3_frame_header(buf + pos, &hdr)){
+			const size_t next = pos + hdr.length;
+
+			if(next == end){
+				break;
+			}
+
+			if((next + 4 <= end) && parse_mp3_frame_header(buf + next, nullptr)){
+				break;
+			}
+		}
+
+		++pos;
+	}
+
+	if(pos + 4 > end){
+		return res;
+	}
+
+	// Пропускаем VBR заголовок - при склейке он описывал бы неверную длительность
+	if(is_vbr_header_frame(buf + pos, hdr)){
+		pos += hdr.length;
+	}
+
+	res.begin = pos;
+	res.end = pos;
+
+	while(pos + 4 <= end){
+		if( !parse_mp3_frame_header(buf + pos, &hdr) || (pos + hdr.length > end) ){
+			break;
+		}
+
+		if( !res.frames ){
+			res.first = hdr;
+		}
+
+		pos += hdr.length;
+		res.end = pos;
+		res.samples += hdr.samples;
+		++res.frames;
+	}
+
+	return res;
+}
+
+MP3_info mp3_buffer_info(const uint8_t *buf, size_t len)
+{
+	MP3_audio_range range = mp3_audio_range(buf, len);
+
+	if( !range.frames ){
+		throw std::runtime_error(excp_func("no audio frames found"));
+	}
+
+	MP3_info info;
+	info.sample_rate = range.first.sample_rate;
+	info.channels = range.first.channels;
+	info.duration_ms = static_cast<uint32_t>(range.samples * 1000 / info.sample_rate);
+
+	if(info.duration_ms){
+		// байт * 8 / мс = кбит/с
+		info.bitrate = static_cast<uint32_t>((range.end - range.begin) * 8 / info.duration_ms);
+	}
+
+	return info;
+}
+
+MP3_info mp3_file_info(const std::string &path)
+{
+	uint64_t len = 0;
+	std::unique_ptr<uint8_t[]> buf = read_bin_file(path, &len);
+
+	try{
+		return mp3_buffer_info(buf.get(), len);
+	}
+	catch(const std::exception &e){
+		throw std::runtime_error(excp_func("'" + path + "': " + e.what()));
+	}
+}
+
+void mp3_concat(const std::vector<std::string> &parts, const std::string &out_path)
+{
+	const std::string tmp_path = out_path + ".tmp";
+	std::unique_ptr<FILE, int(*)(FILE*)> out{fopen(tmp_path.c_str(), "wb"), fclose};
+
+	if( !out ){
+		throw std::runtime_error(excp_func("could not open '" + tmp_path + "': " + strerror(errno)));
+	}
+
+	MP3_frame_header format;
+
+	try{
+		for(size_t i = 0; i < parts.size(); ++i){
+			uint64_t len = 0;
+			std::unique_ptr<uint8_t[]> buf = read_bin_file(parts[i], &len);
+
+			MP3_audio_range range = mp3_audio_range(buf.get(), len);
+
+			if( !range.frames ){
+				throw std::runtime_error(excp_func("no audio frames found in '" + parts[i] + "'"));
+			}
+
+			if(i == 0){
+				format = range.first;
+			}
+			else if((range.first.sample_rate != format.sample_rate) || (range.first.channels != format.channels) ||
+				(range.first.layer != format.layer)){
+				throw std::runtime_error(excp_func("'" + parts[i] + "' format differs from '" + parts[0] + "'"));
+			}
+
+			const size_t size = range.end - range.begin;
+
+			if(fwrite(buf.get() + range.begin, 1, size, out.get()) != size){
+				throw std::runtime_error(excp_func("write to '" + tmp_path + "' failed: " + strerror(errno)));
+			}
+		}
+	}
+	catch(...){
+		out.reset();
+		remove(tmp_path.c_str());
+		throw;
+	}
+
+	if(fclose(out.release())){
+		throw std::runtime_error(excp_func("close '" + tmp_path + "' failed: " + strerror(errno)));
+	}
+
+	// Атомарная подмена - проигрыватель никогда не увидит недописанный файл
+	if(rename(tmp_path.c_str(), out_path.c_str())){
+		remove(tmp_path.c_str());
+		throw std::runtime_error(excp_func("rename to '" + out_path + "' failed: " + strerror(errno)));
+	}
+}
+
+} // namespace utils
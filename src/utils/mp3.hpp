@@ -0,0 +1,99 @@
+/*==============================================================================
+Описание: 	Модуль разбора заголовков MPEG аудио-фреймов (MP3) и склейки
+			MP3 файлов по границам фреймов.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace utils{
+
+// Заголовок MPEG аудио-фрейма
+struct MP3_frame_header
+{
+	uint8_t version = 0;		// 1 - MPEG1, 2 - MPEG2, 25 - MPEG2.5
+	uint8_t layer = 0;			// 1, 2, 3
+	uint8_t channels = 0;		// 1 - моно, 2 - стерео
+	bool crc = false;			// Признак наличия CRC после заголовка
+	uint16_t bitrate = 0;		// кбит/с
+	uint32_t sample_rate = 0;	// Гц
+	uint32_t length = 0;		// Длина фрейма в байтах (с заголовком)
+	uint32_t samples = 0;		// Количество отсчетов (на канал) во фрейме
+};
+
+/**
+  * @описание   Разбор 4-х байтового заголовка MPEG аудио-фрейма
+  * @параметры
+  *     Входные:
+  *         p - указатель на начало заголовка (доступно не менее 4 байт)
+  *     Выходные:
+  *         out - разобранный заголовок
+  * @возвращает true если заголовок корректный
+ */
+bool parse_mp3_frame_header(const uint8_t *p, MP3_frame_header *out);
+
+// Диапазон аудио-данных в MP3 файле (без ID3 тегов и VBR заголовка)
+struct MP3_audio_range
+{
+	size_t begin = 0;			// Смещение первого аудио-фрейма
+	size_t end = 0;				// Смещение за последним полным фреймом
+	uint32_t frames = 0;		// Количество полных фреймов
+	uint64_t samples = 0;		// Суммарное количество отсчетов (на канал)
+	MP3_frame_header first;		// Заголовок первого аудио-фрейма
+};
+
+/**
+  * @описание   Определение диапазона аудио-фреймов в буфере MP3 файла
+  * @параметры
+  *     Входные:
+  *         buf - содержимое MP3 файла
+  *         len - размер буфера
+  * @возвращает диапазон аудио-данных (frames == 0 если фреймы не найдены)
+ */
+MP3_audio_range mp3_audio_range(const uint8_t *buf, size_t len);
+
+// Параметры MP3 файла
+struct MP3_info
+{
+	uint32_t duration_ms = 0;	// Длительность воспроизведения
+	uint32_t bitrate = 0;		// Средний битрейт (кбит/с)
+	uint32_t sample_rate = 0;	// Гц
+	uint8_t channels = 0;
+};
+
+/**
+  * @описание   Определение параметров MP3 файла по заголовкам всех его фреймов
+  *             (длительность корректна и для файлов с переменным битрейтом)
+  * @параметры
+  *     Входные:
+  *         buf - содержимое MP3 файла
+  *         len - размер буфера
+  * @возвращает параметры файла
+  * @исключения std::runtime_error если данные не содержат аудио-фреймов
+ */
+MP3_info mp3_buffer_info(const uint8_t *buf, size_t len);
+
+// То же для файла на диске
+MP3_info mp3_file_info(const std::string &path);
+
+/**
+  * @описание   Склейка MP3 файлов в один по границам фреймов. Из каждой части
+  *             удаляются ID3 теги и VBR заголовки (Xing/Info/VBRI).
+  * @параметры
+  *     Входные:
+  *         parts - пути к склеиваемым файлам (в порядке воспроизведения)
+  *         out_path - путь к результирующему файлу
+  * @исключения std::runtime_error если части несовместимы (разная частота
+  *             дискретизации или число каналов) или не содержат аудио-фреймов
+ */
+void mp3_concat(const std::vector<std::string> &parts, const std::string &out_path);
+
+} // namespace utils
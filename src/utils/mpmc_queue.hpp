@@ -0,0 +1,137 @@
+/*==============================================================================
+Описание: 	Модуль ограниченной очереди без блокировок (много писателей,
+			много читателей) по схеме Д. Вьюкова.
+
+			Каждая ячейка кольцевого буфера хранит порядковый номер, по
+			которому писатель и читатель определяют, свободна ли ячейка для
+			их позиции. Позиция захватывается одной операцией CAS, данные
+			копируются без блокировок. Переполненная очередь не ждет -
+			try_push() возвращает false.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <utility>
+
+namespace utils{
+
+template<typename T>
+class MPMC_queue
+{
+public:
+	// Емкость округляется вверх до степени двойки
+	explicit MPMC_queue(size_t capacity)
+	{
+		size_t size = 2;
+		while(size < capacity){
+			size <<= 1;
+		}
+
+		buffer_.reset(new cell[size]);
+		mask_ = size - 1;
+
+		for(size_t i = 0; i < size; ++i){
+			buffer_[i].seq.store(i, std::memory_order_relaxed);
+		}
+
+		enqueue_pos_.store(0, std::memory_order_relaxed);
+		dequeue_pos_.store(0, std::memory_order_relaxed);
+	}
+
+	MPMC_queue(const MPMC_queue&) = delete;
+	MPMC_queue& operator=(const MPMC_queue&) = delete;
+
+	size_t capacity() const { return mask_ + 1; }
+
+	// false - очередь заполнена
+	bool try_push(const T &data)
+	{
+		cell *c = nullptr;
+		size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+		for(;;){
+			c = &buffer_[pos & mask_];
+			const size_t seq = c->seq.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+
+			if(diff == 0){
+				// Ячейка свободна для этой позиции - захватываем позицию
+				if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+					break;
+				}
+			}
+			else if(diff < 0){
+				// Ячейку еще не освободил читатель предыдущего круга
+				return false;
+			}
+			else{
+				pos = enqueue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		c->data = data;
+		c->seq.store(pos + 1, std::memory_order_release);
+
+		return true;
+	}
+
+	// false - очередь пуста
+	bool try_pop(T *data)
+	{
+		cell *c = nullptr;
+		size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+
+		for(;;){
+			c = &buffer_[pos & mask_];
+			const size_t seq = c->seq.load(std::memory_order_acquire);
+			const intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+
+			if(diff == 0){
+				if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+					break;
+				}
+			}
+			else if(diff < 0){
+				// Писатель еще не заполнил ячейку
+				return false;
+			}
+			else{
+				pos = dequeue_pos_.load(std::memory_order_relaxed);
+			}
+		}
+
+		*data = std::move(c->data);
+		c->seq.store(pos + mask_ + 1, std::memory_order_release);
+
+		return true;
+	}
+
+private:
+	static const size_t cache_line = 64;
+
+	struct cell
+	{
+		std::atomic<size_t> seq;
+		T data;
+	};
+
+	// Позиции писателей и читателей - в разных строках кеша
+	char pad0_[cache_line];
+	std::unique_ptr<cell[]> buffer_;
+	size_t mask_ = 0;
+	char pad1_[cache_line];
+	std::atomic<size_t> enqueue_pos_;
+	char pad2_[cache_line];
+	std::atomic<size_t> dequeue_pos_;
+	char pad3_[cache_line];
+};
+
+} // namespace utils
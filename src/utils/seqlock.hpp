@@ -0,0 +1,154 @@
+/*==============================================================================
+Описание: 	Модуль публикации данных одним писателем без блокировок.
+
+			Seqlock: писатель увеличивает счетчик версии до и после записи,
+			читатель копирует данные и повторяет чтение, если версия
+			изменилась или нечетна (запись в процессе). Читатели не
+			блокируют писателя и друг друга, не выделяют память.
+			Данные хранятся словами в атомарных переменных - копирование
+			во время записи не является гонкой данных.
+
+			SeqRing: кольцевой буфер последних N записей на основе Seqlock.
+
+			Тип данных должен допускать побайтовое копирование (без строк,
+			указателей на владеемые данные и т.п.). Писатель должен быть один.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+namespace utils{
+
+template<typename T>
+class Seqlock
+{
+public:
+	Seqlock() { this->store(T()); }
+
+	// Запись (только из одного потока)
+	void store(const T &value)
+	{
+		uint64_t words[words_num] = {};
+		memcpy(words, &value, sizeof(T));
+
+		const uint32_t seq = seq_.load(std::memory_order_relaxed);
+		seq_.store(seq + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for(size_t i = 0; i < words_num; ++i){
+			data_[i].store(words[i], std::memory_order_relaxed);
+		}
+
+		seq_.store(seq + 2, std::memory_order_release);
+	}
+
+	// Чтение (из любого потока). Повторяется, пока не попадет между записями
+	T load() const
+	{
+		T res;
+		while( !this->try_load(&res) ){}
+
+		return res;
+	}
+
+	// Однократная попытка чтения: false - чтение пересеклось с записью
+	bool try_load(T *out) const
+	{
+		uint64_t words[words_num];
+
+		const uint32_t seq = seq_.load(std::memory_order_acquire);
+		if(seq & 1){
+			return false;
+		}
+
+		for(size_t i = 0; i < words_num; ++i){
+			words[i] = data_[i].load(std::memory_order_relaxed);
+		}
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(seq_.load(std::memory_order_relaxed) != seq){
+			return false;
+		}
+
+		memcpy(out, words, sizeof(T));
+		return true;
+	}
+
+	// Версия данных (количество записей * 2)
+	uint32_t version() const { return seq_.load(std::memory_order_acquire); }
+
+private:
+	static const size_t words_num = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+	std::atomic<uint32_t> seq_{0};
+	std::atomic<uint64_t> data_[words_num];
+};
+
+
+template<typename T, size_t N>
+class SeqRing
+{
+public:
+	// Запись (только из одного потока). Самая старая запись вытесняется
+	void push(const T &value)
+	{
+		const uint64_t n = count_.load(std::memory_order_relaxed);
+		slots_[n % N].store(slot{n, value});
+		count_.store(n + 1, std::memory_order_release);
+	}
+
+	/**
+	  * @описание   Копия последних записей (от новых к старым)
+	  * @параметры
+	  *     Входные:
+	  *         max - размер выходного буфера
+	  *     Выходные:
+	  *         out - записи, out[0] - последняя
+	  * @возвращает количество скопированных записей
+	 */
+	size_t last(T *out, size_t max) const
+	{
+		const uint64_t n = count_.load(std::memory_order_acquire);
+		size_t res = 0;
+
+		for(; (res < max) && (res < N) && (res < n); ++res){
+			const uint64_t idx = n - 1 - res;
+			const slot s = slots_[idx % N].load();
+
+			// Писатель успел перезаписать ячейку более новой записью - дальше
+			// только перезаписанные, историю обрываем
+			if(s.idx != idx){
+				break;
+			}
+
+			out[res] = s.value;
+		}
+
+		return res;
+	}
+
+	// Общее количество записей с момента создания
+	uint64_t count() const { return count_.load(std::memory_order_acquire); }
+
+	static constexpr size_t capacity() { return N; }
+
+private:
+	struct slot
+	{
+		uint64_t idx;
+		T value;
+	};
+
+	std::atomic<uint64_t> count_{0};
+	Seqlock<slot> slots_[N];
+};
+
+} // namespace utils
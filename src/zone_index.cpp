@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <limits>
+
+#include "zone_index.hpp"
+
+namespace avi{
+
+void ZoneGrid::clear()
+{
+	boxes_.clear();
+	cells_.clear();
+}
+
+void ZoneGrid::add(uint32_t index, const utils::Coord &min, const utils::Coord &max, uint8_t sectors)
+{
+	const uint32_t box_idx = static_cast<uint32_t>(boxes_.size());
+	boxes_.push_back({min, max, index, sectors});
+
+	for(int32_t clat = cell_of(min.lat); clat <= cell_of(max.lat); ++clat){
+		for(int32_t clon = cell_of(min.lon); clon <= cell_of(max.lon); ++clon){
+			cell &c = cells_[key(clat, clon)];
+			c.sectors |= sectors;
+			c.boxes.push_back(box_idx);
+		}
+	}
+}
+
+uint32_t ZoneGrid::nearest_distance_cm(const utils::Coord &point, uint32_t max_cm, uint32_t *index) const
+{
+	const uint32_t NOT_FOUND = std::numeric_limits<uint32_t>::max();
+	uint32_t best = NOT_FOUND;
+
+	if(boxes_.empty()){
+		return best;
+	}
+
+	const utils::LocalMetric metric(point.lat);
+
+	// Наименьшая сторона ячейки в окрестности точки (см)
+	int64_t east = 0;
+	int64_t north = 0;
+	metric.offset_cm(point, utils::Coord(point.lat + cell_ude, point.lon + cell_ude), &east, &north);
+	const int64_t cell_cm = std::max<int64_t>(1, std::min(east, north));
+
+	const int32_t rings = static_cast<int32_t>(max_cm / cell_cm) + 1;
+	const int32_t clat = cell_of(point.lat);
+	const int32_t clon = cell_of(point.lon);
+
+	auto check_cell = [&](int32_t cell_lat, int32_t cell_lon){
+		auto it = cells_.find(key(cell_lat, cell_lon));
+		if(it == cells_.end()){
+			return;
+		}
+
+		for(uint32_t box_idx : it->second.boxes){
+			const box &b = boxes_[box_idx];
+
+			// Ближайшая к точке точка прямоугольника
+			const utils::Coord nearest(std::min(std::max(point.lat, b.min.lat), b.max.lat),
+				std::min(std::max(point.lon, b.min.lon), b.max.lon));
+
+			const uint32_t dist = metric.distance_cm(point, nearest);
+			if(dist < best){
+				best = dist;
+				if(index){
+					*index = b.index;
+				}
+			}
+		}
+	};
+
+	for(int32_t r = 0; r <= rings; ++r){
+		// Зоны в ячейках кольца r удалены от точки не менее чем на (r - 1) ячеек
+		if((r > 0) && (best != NOT_FOUND) && (best <= (r - 1) * cell_cm)){
+			break;
+		}
+
+		for(int32_t dlat = -r; dlat <= r; ++dlat){
+			if((dlat == -r) || (dlat == r)){
+				for(int32_t dlon = -r; dlon <= r; ++dlon){
+					check_cell(clat + dlat, clon + dlon);
+				}
+			}
+			else{
+				check_cell(clat + dlat, clon - r);
+				check_cell(clat + dlat, clon + r);
+			}
+		}
+	}
+
+	return (best <= max_cm) ? best : NOT_FOUND;
+}
+
+uint32_t ZoneGrid::hilbert_index(uint32_t x, uint32_t y)
+{
+	const uint32_t n = 1u << 16;
+	uint32_t d = 0;
+
+	x &= n - 1;
+	y &= n - 1;
+
+	for(uint32_t s = n / 2; s > 0; s /= 2){
+		const uint32_t rx = (x & s) ? 1 : 0;
+		const uint32_t ry = (y & s) ? 1 : 0;
+
+		d += s * s * ((3 * rx) ^ ry);
+
+		// Поворот четверти - кривая в ней начинается и заканчивается у соседних четвертей
+		if(ry == 0){
+			if(rx == 1){
+				x = n - 1 - x;
+				y = n - 1 - y;
+			}
+
+			std::swap(x, y);
+		}
+	}
+
+	return d;
+}
+
+std::vector<uint32_t> ZoneGrid::hilbert_order(const std::vector<utils::Coord> &points)
+{
+	std::vector<uint32_t> res(points.size());
+
+	for(size_t i = 0; i < res.size(); ++i){
+		res[i] = static_cast<uint32_t>(i);
+	}
+
+	if(points.size() < 2){
+		return res;
+	}
+
+	utils::Coord min = points.front(), max = points.front();
+	for(const auto &p : points){
+		min.lat = std::min(min.lat, p.lat);
+		min.lon = std::min(min.lon, p.lon);
+		max.lat = std::max(max.lat, p.lat);
+		max.lon = std::max(max.lon, p.lon);
+	}
+
+	const int64_t span_lat = std::max<int64_t>(1, static_cast<int64_t>(max.lat) - min.lat);
+	const int64_t span_lon = std::max<int64_t>(1, static_cast<int64_t>(max.lon) - min.lon);
+
+	std::vector<uint32_t> keys(points.size());
+	for(size_t i = 0; i < points.size(); ++i){
+		const uint32_t x = static_cast<uint32_t>((static_cast<int64_t>(points[i].lon) - min.lon) * 65535 / span_lon);
+		const uint32_t y = static_cast<uint32_t>((static_cast<int64_t>(points[i].lat) - min.lat) * 65535 / span_lat);
+		keys[i] = hilbert_index(x, y);
+	}
+
+	std::stable_sort(res.begin(), res.end(), [&keys](uint32_t a, uint32_t b){ return keys[a] < keys[b]; });
+
+	return res;
+}
+
+void ZoneGrid::query(const utils::Coord &min, const utils::Coord &max, std::vector<uint32_t> *out, uint8_t course_mask) const
+{
+	out->clear();
+
+	for(int32_t clat = cell_of(min.lat); clat <= cell_of(max.lat); ++clat){
+		for(int32_t clon = cell_of(min.lon); clon <= cell_of(max.lon); ++clon){
+			auto it = cells_.find(key(clat, clon));
+			if(it == cells_.end()){
+				continue;
+			}
+
+			// В ячейке нет зон этого направления
+			if(course_mask && !(it->second.sectors & course_mask)){
+				continue;
+			}
+
+			for(uint32_t box_idx : it->second.boxes){
+				const box &b = boxes_[box_idx];
+
+				if(course_mask && !(b.sectors & course_mask)){
+					continue;
+				}
+
+				if((b.max.lat >= min.lat) && (b.min.lat <= max.lat) && (b.max.lon >= min.lon) && (b.min.lon <= max.lon)){
+					out->push_back(b.index);
+				}
+			}
+		}
+	}
+
+	// Зона, занимающая несколько ячеек, попадает в результат по разу от каждой
+	std::sort(out->begin(), out->end());
+	out->erase(std::unique(out->begin(), out->end()), out->end());
+}
+
+} // namespace avi
+
+
+#ifdef _ZONE_INDEX_BENCH
+
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+
+using namespace std;
+using avi::ZoneGrid;
+using utils::Coord;
+
+// Фрейм с полезной нагрузкой порядка размера kFrames_table::Frame
+struct bench_frame
+{
+	int id = -1;
+	Coord min;
+	Coord max;
+	char payload[96];
+};
+
+struct bench_result
+{
+	double ns_per_fix = 0.0;
+	uint64_t hits = 0;
+};
+
+// Проход по трассе: поиск кандидатов в индексе и проверка их прямоугольников
+static bench_result drive(const vector<bench_frame> &frames, const vector<Coord> &track)
+{
+	ZoneGrid grid;
+	for(size_t i = 0; i < frames.size(); ++i){
+		grid.add(static_cast<uint32_t>(i), frames[i].min, frames[i].max);
+	}
+
+	vector<uint32_t> candidates;
+	bench_result res;
+	uint64_t checksum = 0;
+
+	const auto start = chrono::steady_clock::now();
+
+	for(const auto &p : track){
+		grid.query(p, p, &candidates);
+
+		for(uint32_t i : candidates){
+			const bench_frame &f = frames[i];
+			if((p.lat >= f.min.lat) && (p.lat <= f.max.lat) && (p.lon >= f.min.lon) && (p.lon <= f.max.lon)){
+				++res.hits;
+				checksum += static_cast<uint8_t>(f.payload[f.id % sizeof(f.payload)]);
+			}
+		}
+
+		uint32_t nearest = 0;
+		if(grid.nearest_distance_cm(p, 50000, &nearest) != UINT32_MAX){
+			checksum += static_cast<uint32_t>(frames[nearest].id);
+		}
+	}
+
+	const double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+	res.ns_per_fix = ns / track.size();
+
+	if(checksum == 1){
+		printf(" ");	// Результат используется - проход не выбрасывается оптимизатором
+	}
+
+	return res;
+}
+
+int main(int argc, char* argv[])
+{
+	const size_t frames_num = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 50000;
+	const int passes = (argc > 2) ? atoi(argv[2]) : 3;
+
+	mt19937 rng(12345);
+	uniform_real_distribution<double> turn(-0.35, 0.35);
+
+	// Синтетический маршрут: извилистая линия в квадрате ~40x40 км, зона через ~30 м
+	vector<Coord> centers;
+	double lat = 55750000.0, lon = 37600000.0, heading = 0.0;
+	const double step_ude = 270.0;		// ~30 м по широте
+
+	for(size_t i = 0; i < frames_num; ++i){
+		heading += turn(rng);
+		lat += step_ude * cos(heading);
+		lon += step_ude * 1.78 * sin(heading);
+
+		// Отражение от границ области
+		if((lat < 55550000.0) || (lat > 55950000.0)){ heading = 3.14159265358979 - heading; }
+		if((lon < 37250000.0) || (lon > 37950000.0)){ heading = -heading; }
+
+		centers.emplace_back(static_cast<int32_t>(lat), static_cast<int32_t>(lon));
+	}
+
+	// Идентификаторы НСИ не связаны с географией
+	vector<int> ids(frames_num);
+	for(size_t i = 0; i < frames_num; ++i){
+		ids[i] = static_cast<int>(i);
+	}
+	shuffle(ids.begin(), ids.end(), rng);
+
+	vector<bench_frame> by_id(frames_num);
+	for(size_t i = 0; i < frames_num; ++i){
+		bench_frame &f = by_id[ids[i]];
+		f.id = ids[i];
+		f.min = Coord(centers[i].lat - 200, centers[i].lon - 350);
+		f.max = Coord(centers[i].lat + 200, centers[i].lon + 350);
+		for(size_t k = 0; k < sizeof(f.payload); ++k){
+			f.payload[k] = static_cast<char>(k + i);
+		}
+	}
+
+	// Расположение вдоль кривой Гильберта по центрам зон
+	vector<Coord> stored_centers;
+	for(const auto &f : by_id){
+		stored_centers.emplace_back((f.min.lat + f.max.lat) / 2, (f.min.lon + f.max.lon) / 2);
+	}
+
+	vector<bench_frame> by_hilbert;
+	for(uint32_t i : ZoneGrid::hilbert_order(stored_centers)){
+		by_hilbert.push_back(by_id[i]);
+	}
+
+	// Трасса: решения каждые ~10 м вдоль маршрута
+	vector<Coord> track;
+	for(size_t i = 1; i < centers.size(); ++i){
+		for(int k = 0; k < 3; ++k){
+			track.emplace_back(centers[i - 1].lat + (centers[i].lat - centers[i - 1].lat) * k / 3,
+				centers[i - 1].lon + (centers[i].lon - centers[i - 1].lon) * k / 3);
+		}
+	}
+
+	printf("frames: %zu (%zu bytes each), fixes: %zu, passes: %d\n", frames_num, sizeof(bench_frame), track.size(), passes);
+
+	for(int pass = 0; pass < passes; ++pass){
+		const bench_result id_res = drive(by_id, track);
+		const bench_result hb_res = drive(by_hilbert, track);
+
+		printf("pass %d: id order %7.1lf ns/fix, hilbert order %7.1lf ns/fix (x%.2lf), hits %llu/%llu\n", pass + 1,
+			id_res.ns_per_fix, hb_res.ns_per_fix, id_res.ns_per_fix / hb_res.ns_per_fix,
+			static_cast<unsigned long long>(id_res.hits), static_cast<unsigned long long>(hb_res.hits));
+	}
+
+	return 0;
+}
+
+#endif
@@ -0,0 +1,124 @@
+/*==============================================================================
+Описание: 	Модуль пространственного индекса зон фреймов.
+
+			Ограничивающие прямоугольники зон раскладываются по ячейкам
+			равномерной сетки (в микроградусах). Поиск ближайшей зоны
+			просматривает только ячейки в окрестности точки кольцами,
+			начиная с ячейки самой точки.
+
+			У каждой зоны и каждой ячейки есть битовая карта секторов курса
+			(8 секторов по 45 градусов, как у зон фреймов): зоны другого
+			направления отбрасываются при поиске одной операцией AND, до
+			проверки геометрии.
+
+			Порядок точек вдоль кривой Гильберта позволяет расположить
+			близкие на местности зоны рядом в памяти.
+
+Автор: 		berezhanov.m@gmail.com
+Дата:		19.10.2026
+Версия: 	1.0
+==============================================================================*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+#include "utils/geo.hpp"
+
+namespace avi{
+
+class ZoneGrid
+{
+public:
+	// Размер ячейки: ~550 м по широте, ~300 м по долготе на широте Москвы
+	static const int32_t cell_ude = 5000;
+
+	void clear();
+
+	/**
+	  * @описание   Добавление зоны в индекс
+	  * @параметры
+	  *     Входные:
+	  *         index - индекс зоны (фрейма) у вызывающего
+	  *         min - юго-западный угол ограничивающего прямоугольника
+	  *         max - северо-восточный угол ограничивающего прямоугольника
+	  *         sectors - битовая карта секторов курса зоны (0xFF - любой курс)
+	 */
+	void add(uint32_t index, const utils::Coord &min, const utils::Coord &max, uint8_t sectors = 0xFF);
+
+	size_t size() const { return boxes_.size(); }
+	bool empty() const { return boxes_.empty(); }
+
+	/**
+	  * @описание   Расстояние от точки до ближайшего ограничивающего прямоугольника зоны
+	  * @параметры
+	  *     Входные:
+	  *         point - точка
+	  *         max_cm - радиус поиска (см)
+	  *     Выходные:
+	  *         index - индекс ближайшей зоны (если найдена)
+	  * @возвращает расстояние (см), 0 - точка внутри прямоугольника,
+	  *             UINT32_MAX - в радиусе поиска зон нет
+	 */
+	uint32_t nearest_distance_cm(const utils::Coord &point, uint32_t max_cm, uint32_t *index = nullptr) const;
+
+	/**
+	  * @описание   Зоны, ограничивающие прямоугольники которых пересекаются с заданным
+	  * @параметры
+	  *     Входные:
+	  *         min - юго-западный угол
+	  *         max - северо-восточный угол
+	  *         course_mask - бит сектора текущего курса: только зоны с этим
+	  *                       сектором в битовой карте (0 - курс не учитывается)
+	  *     Выходные:
+	  *         out - индексы зон по возрастанию (без повторов)
+	 */
+	void query(const utils::Coord &min, const utils::Coord &max, std::vector<uint32_t> *out, uint8_t course_mask = 0) const;
+
+	// Номер точки (x, y: 0 .. 65535) на кривой Гильберта 16-го порядка
+	static uint32_t hilbert_index(uint32_t x, uint32_t y);
+
+	/**
+	  * @описание   Порядок точек вдоль кривой Гильберта, построенной в
+	  *             ограничивающем прямоугольнике всех точек
+	  * @параметры
+	  *     Входные:
+	  *         points - точки (центры зон)
+	  * @возвращает индексы точек в порядке следования по кривой (при равенстве -
+	  *             в исходном порядке)
+	 */
+	static std::vector<uint32_t> hilbert_order(const std::vector<utils::Coord> &points);
+
+private:
+	struct box
+	{
+		utils::Coord min;
+		utils::Coord max;
+		uint32_t index;
+		uint8_t sectors;
+	};
+
+	struct cell
+	{
+		uint8_t sectors = 0;			// Объединение секторов зон ячейки
+		std::vector<uint32_t> boxes;	// Индексы в boxes_
+	};
+
+	std::vector<box> boxes_;
+	std::unordered_map<uint64_t, cell> cells_;
+
+	static int32_t cell_of(int32_t ude)
+	{
+		// Округление вниз и для отрицательных координат
+		return (ude >= 0) ? (ude / cell_ude) : -((-ude + cell_ude - 1) / cell_ude);
+	}
+
+	static uint64_t key(int32_t cell_lat, int32_t cell_lon)
+	{
+		return (static_cast<uint64_t>(static_cast<uint32_t>(cell_lat)) << 32) | static_cast<uint32_t>(cell_lon);
+	}
+};
+
+} // namespace avi